@@ -0,0 +1,532 @@
+// Per-pattern frame benchmark for the native build.
+//
+// Every case resets or prepares its pattern, then calls it once per frame
+// from a FrameScheduler running on the shim's virtual clock, so frames are
+// paced exactly as on the device but without waiting. Not every frame renders;
+// ns/frame is the mean over all frames and ns/render and ns/LED are over
+// the frames that changed pixels. Figures are the best of several
+// repetitions so that host noise does not show up as a regression. The
+// program cases run a whole Segment through Program::update() and so
+// include present(); program/dispatch renders only instances that return
+// straight away, which leaves the per-frame cost of pattern dispatch. The
+// layer cases play a flame with a spin over it: hidden, covering it, which
+// takes the flame out, and blended into it. The transition cases combine
+// two full frames on every pin, with progress sweeping 0 to 1 once a
+// second. The blend cases blend one full frame into a copy of another, on
+// every pin, at three quarters opacity. The output cases time the output
+// stage composing every pin of the frame, rotated as chase leaves its pins
+// or not. Last, the main show is played through once with segments started
+// cold and once with Program::prepareNext() run between frames, and the
+// longest frame that switched segment is compared with the longest of the
+// rest.
+
+#include "output.h"
+#include "patterns.h"
+#include "program.h"
+#include "scheduler.h"
+#include "show.h"
+#include <chrono>
+#include <functional>
+
+#define BENCH_FPS 60
+#define TIMED_FRAMES 200
+#define REPETITIONS 5
+
+// Grow step used by the phase cases, and the frames it takes to fill the
+// shortest pin
+#define GROW_DELAY_MS 20
+#define GROW_FILL_FRAMES (shortestPinLeds(0) * GROW_DELAY_MS * BENCH_FPS / 1000)
+
+static constexpr int shortestPinLeds(int pin)
+{
+    return pin == NUM_PINS - 1 ? pinLeds(pin) : min(pinLeds(pin), shortestPinLeds(pin + 1));
+}
+
+static CRGB ledBuffer[TOTAL_LEDS];
+static CRGB outputBuffer[TOTAL_LEDS];
+static CRGB incomingBuffer[TOTAL_LEDS];
+static CRGB transitionBuffer[TOTAL_LEDS];
+CRGB* leds = ledBuffer;
+static ColorCorrection correction;
+static bool allDirty[NUM_PINS];
+static bool noFlip[NUM_PINS];
+
+static int allPins[NUM_PINS];
+static CRGB palette[] = { CRGB::Red, CRGB::Blue, CRGB::Green, CRGB::Yellow };
+static const int paletteSize = 4;
+
+// One state block, big enough for any single pattern on all pins
+static StateArena arena;
+static void* state = nullptr;
+
+struct BenchCase {
+    const char* name;
+    std::function<void()> reset;
+    std::function<bool(const FrameTime&)> frame;
+    int warmupFrames;
+};
+
+static void runCase(const BenchCase& benchCase)
+{
+    double bestNsPerFrame = 0;
+    double bestNsPerRender = 0;
+    unsigned long showsPerRun = 0;
+    int rendersPerRun = 0;
+
+    for (int rep = 0; rep < REPETITIONS; rep++) {
+        hostSetMillis(0);
+        FrameScheduler scheduler(BENCH_FPS);
+        benchCase.reset();
+        for (int i = 0; i < benchCase.warmupFrames; i++) {
+            benchCase.frame(scheduler.beginFrame());
+        }
+
+        FastLED.resetCounters();
+        std::chrono::nanoseconds elapsed(0);
+        std::chrono::nanoseconds renderElapsed(0);
+        int renders = 0;
+        for (int i = 0; i < TIMED_FRAMES; i++) {
+            FrameTime time = scheduler.beginFrame();
+            auto begin = std::chrono::steady_clock::now();
+            bool changed = benchCase.frame(time);
+            auto frameElapsed = std::chrono::steady_clock::now() - begin;
+            elapsed += frameElapsed;
+            if (changed) {
+                renderElapsed += frameElapsed;
+                renders++;
+            }
+        }
+
+        double nsPerFrame = (double)elapsed.count() / TIMED_FRAMES;
+        double nsPerRender = renders ? (double)renderElapsed.count() / renders : 0;
+        if (rep == 0 || nsPerFrame < bestNsPerFrame) {
+            bestNsPerFrame = nsPerFrame;
+        }
+        if (rep == 0 || nsPerRender < bestNsPerRender) {
+            bestNsPerRender = nsPerRender;
+        }
+        showsPerRun = FastLED.getShowCount();
+        rendersPerRun = renders;
+    }
+
+    printf("%-24s %10.0f %10.2f %10.0f %8.2f %12.2f\n", benchCase.name, bestNsPerFrame,
+        (double)rendersPerRun / TIMED_FRAMES, bestNsPerRender, bestNsPerRender / TOTAL_LEDS,
+        (double)showsPerRun / TIMED_FRAMES);
+}
+
+// The 4-pattern "symphony" segment from main.cpp, one instance per pin pair
+static Program* buildSymphonyProgram()
+{
+    static int oceanPins[] = { 0, 1 };
+    static int rainbowPins[] = { 2, 3 };
+    static int sunsetPins[] = { 4, 5 };
+    static int neonPins[] = { 6, 7 };
+    PatternInstance* patterns[4];
+
+    BreathingParams oceanParams;
+    oceanParams.speed = 25;
+    oceanParams.palette = palette;
+    oceanParams.paletteSize = paletteSize;
+    patterns[0] = new PatternInstance(oceanPins, 2, oceanParams);
+
+    SpinParams rainbowParams;
+    rainbowParams.speed = 90;
+    rainbowParams.separation = 8;
+    rainbowParams.span = 12;
+    rainbowParams.palette = palette;
+    rainbowParams.paletteSize = paletteSize;
+    rainbowParams.loop = true;
+    rainbowParams.continuous = false;
+    rainbowParams.blend = true;
+    patterns[1] = new PatternInstance(rainbowPins, 2, rainbowParams);
+
+    GrowParams sunsetParams;
+    sunsetParams.speed = 45;
+    sunsetParams.n = 3;
+    sunsetParams.fadeDelay = 150;
+    sunsetParams.holdDelay = 3000;
+    sunsetParams.palette = palette;
+    sunsetParams.paletteSize = paletteSize;
+    sunsetParams.transitionSpeed = 30;
+    sunsetParams.offsetDelay = 2000;
+    patterns[2] = new PatternInstance(sunsetPins, 2, sunsetParams);
+
+    PopParams neonParams;
+    neonParams.speed = 80;
+    neonParams.holdDelay = 200;
+    neonParams.palette = palette;
+    neonParams.paletteSize = paletteSize;
+    neonParams.random = true;
+    neonParams.accelerationTime = 15;
+    patterns[3] = new PatternInstance(neonPins, 2, neonParams);
+
+    Program* program = new Program(1);
+    program->addSegment(0, new Segment(patterns, 4, 1000000));
+    return program;
+}
+
+// One instance per pin, taking the patterns in turn, each with parameters
+// that make it return straight away, so a frame costs only the dispatch.
+// No two share a pin, so every one is drawn straight into its pin as
+// replace and none is covered or layered.
+static Program* buildDispatchProgram()
+{
+    PatternInstance* patterns[NUM_PINS];
+    int count = 0;
+
+    for (int pin = 0; pin < NUM_PINS; pin++) {
+        int pins[] = { pin };
+
+        switch (pin % 6) {
+        case 0: {
+            BreathingParams breathingParams;
+            breathingParams.speed = 50;
+            breathingParams.palette = palette;
+            breathingParams.paletteSize = 0;
+            patterns[count++] = new PatternInstance(pins, 1, breathingParams);
+            break;
+        }
+        case 1: {
+            FlameParams flameParams;
+            flameParams.speed = 0;
+            flameParams.cooling = 55;
+            flameParams.sparking = 120;
+            patterns[count++] = new PatternInstance(pins, 1, flameParams);
+            break;
+        }
+        case 2: {
+            GrowParams growParams;
+            growParams.speed = 60;
+            growParams.n = 1;
+            growParams.fadeDelay = GROW_DELAY_MS;
+            growParams.holdDelay = 2000;
+            growParams.palette = palette;
+            growParams.paletteSize = 0;
+            growParams.transitionSpeed = 40;
+            growParams.offsetDelay = 0;
+            patterns[count++] = new PatternInstance(pins, 1, growParams);
+            break;
+        }
+        case 3: {
+            ChaseParams chaseParams;
+            chaseParams.speed = 75;
+            chaseParams.palette = palette;
+            chaseParams.paletteSize = 0;
+            chaseParams.transitionSpeed = 40;
+            chaseParams.holdDelay = 200;
+            chaseParams.offsetDelay = 0;
+            patterns[count++] = new PatternInstance(pins, 1, chaseParams);
+            break;
+        }
+        case 4: {
+            PopParams popParams;
+            popParams.speed = 80;
+            popParams.holdDelay = 0;
+            popParams.palette = palette;
+            popParams.paletteSize = 0;
+            popParams.random = false;
+            popParams.accelerationTime = 0;
+            patterns[count++] = new PatternInstance(pins, 1, popParams);
+            break;
+        }
+        default: {
+            SpinParams spinParams;
+            spinParams.speed = 75;
+            spinParams.separation = 20;
+            spinParams.span = 15;
+            spinParams.palette = palette;
+            spinParams.paletteSize = 0;
+            spinParams.loop = false;
+            spinParams.continuous = false;
+            spinParams.blend = false;
+            patterns[count++] = new PatternInstance(pins, 1, spinParams);
+            break;
+        }
+        }
+    }
+
+    Program* program = new Program(1);
+    program->addSegment(0, new Segment(patterns, count, 1000000));
+    return program;
+}
+
+// Flame on every pin with a single spin over it, blended as given; an
+// opacity of 0 leaves the flame alone
+static Program* buildLayerProgram(BlendMode mode, uint8_t opacity)
+{
+    PatternInstance* patterns[2];
+
+    FlameParams flameParams;
+    flameParams.speed = 80;
+    flameParams.cooling = 55;
+    flameParams.sparking = 120;
+    patterns[0] = new PatternInstance(allPins, NUM_PINS, flameParams);
+
+    SpinParams spinParams;
+    spinParams.speed = 75;
+    spinParams.separation = 20;
+    spinParams.span = 15;
+    spinParams.palette = palette;
+    spinParams.paletteSize = paletteSize;
+    spinParams.loop = false;
+    spinParams.continuous = false;
+    spinParams.blend = false;
+    patterns[1] = new PatternInstance(allPins, NUM_PINS, spinParams);
+    patterns[1]->setBlend(mode, opacity);
+
+    Program* program = new Program(1);
+    program->addSegment(0, new Segment(patterns, 2, 1000000));
+    return program;
+}
+
+// Prepared as a segment would, which builds the gradient LUT of the
+// continuous and loop modes before the first frame
+static BenchCase spinCase(const char* name, bool loop, bool continuous, bool blend)
+{
+    SpinParams params { 75, 20, 15, palette, paletteSize, loop, continuous, blend };
+    return { name, [params] { SpinPattern::prepare(state, allPins, NUM_PINS, params, false, 0); },
+        [params](const FrameTime& t) { return SpinPattern::render(t, state, allPins, NUM_PINS, params); }, 0 };
+}
+
+static Program* symphony = nullptr;
+static Program* dispatch = nullptr;
+static Program* layers = nullptr;
+
+static void startLayers(BlendMode mode, uint8_t opacity)
+{
+    delete layers;
+    layers = buildLayerProgram(mode, opacity);
+    layers->start(millis());
+}
+
+static bool updateLayers(const FrameTime& time)
+{
+    unsigned long before = layers->getFramesPresented();
+    layers->update(time);
+    return layers->getFramesPresented() != before;
+}
+
+// Longest update() of a segment switch and of any other frame over one pass
+// of the main show, best of the repetitions
+static void measureBoundaries(bool prepare, long& switchNs, long& otherNs)
+{
+    Program* program = buildMainProgram();
+    for (int rep = 0; rep < REPETITIONS; rep++) {
+        hostSetMillis(0);
+        FrameScheduler scheduler(BENCH_FPS);
+        program->start(millis());
+        long maxSwitch = 0;
+        long maxOther = 0;
+        // Until the show comes back round to its first segment
+        int segment = 0;
+        do {
+            FrameTime time = scheduler.beginFrame();
+            segment = program->getCurrentSegment();
+            auto begin = std::chrono::steady_clock::now();
+            program->update(time);
+            long ns = std::chrono::nanoseconds(std::chrono::steady_clock::now() - begin).count();
+            long& slot = program->getCurrentSegment() != segment ? maxSwitch : maxOther;
+            slot = max(slot, ns);
+            if (prepare) {
+                program->prepareNext();
+            }
+        } while (program->getCurrentSegment() != 0 || segment == 0);
+        program->stop();
+        if (rep == 0 || maxSwitch < switchNs) {
+            switchNs = maxSwitch;
+        }
+        if (rep == 0 || maxOther < otherNs) {
+            otherNs = maxOther;
+        }
+    }
+    delete program;
+}
+
+// The incoming frame blended over a copy of the transition's outgoing one
+static bool renderBlend(BlendMode mode, uint8_t opacity)
+{
+    memcpy(transitionBuffer, ledBuffer, sizeof(ledBuffer));
+    for (int pin = 0; pin < NUM_PINS; pin++) {
+        blendPixels(mode, opacity, transitionBuffer + pinOffset(pin), incomingBuffer + pinOffset(pin), pinLeds(pin),
+            false);
+    }
+    return true;
+}
+
+static bool renderTransition(TransitionType type, const FrameTime& time)
+{
+    float progress = (time.frame % BENCH_FPS) / (float)BENCH_FPS;
+    composeTransition(type, progress, ledBuffer, incomingBuffer, transitionBuffer, allDirty, noFlip);
+    return true;
+}
+
+int main()
+{
+    static_assert(TIMED_FRAMES < GROW_FILL_FRAMES, "grow cases must stay in one phase while timed");
+
+    for (int pin = 0; pin < NUM_PINS; pin++) {
+        allPins[pin] = pin;
+        allDirty[pin] = true;
+    }
+    for (int i = 0; i < TOTAL_LEDS; i++) {
+        incomingBuffer[i] = CRGB(i, i * 3, 255 - i);
+    }
+    setOutputFrame(outputBuffer);
+    correction.build(2.2f, CRGB(255, 176, 240));
+
+    size_t stateBytes = 0;
+    for (int i = 0; i < Patterns::count; i++) {
+        stateBytes = max(stateBytes, Patterns::table[i]->stateSize(NUM_PINS));
+    }
+    arena.allocate(stateBytes);
+    state = arena.at(0);
+
+    BenchCase cases[] = {
+        { "breathing", [] { BreathingPattern::reset(state, NUM_PINS); },
+            [](const FrameTime& t) {
+                return BreathingPattern::render(t, state, allPins, NUM_PINS,
+                    BreathingParams { 50, palette, paletteSize });
+            },
+            0 },
+        { "flame", [] { FlamePattern::reset(state, NUM_PINS); },
+            [](const FrameTime& t) {
+                return FlamePattern::render(t, state, allPins, NUM_PINS, FlameParams { 80, 55, 120 });
+            },
+            0 },
+        { "grow/growing", [] { GrowPattern::reset(state, NUM_PINS); },
+            [](const FrameTime& t) {
+                return GrowPattern::render(t, state, allPins, NUM_PINS,
+                    GrowParams { 60, 1, GROW_DELAY_MS, 2000, palette, paletteSize, 40, 0 });
+            },
+            0 },
+        { "grow/holding", [] { GrowPattern::reset(state, NUM_PINS); },
+            [](const FrameTime& t) {
+                return GrowPattern::render(t, state, allPins, NUM_PINS,
+                    GrowParams { 60, MAX_LEDS_PER_PIN, GROW_DELAY_MS, 1000000, palette, paletteSize, 40, 0 });
+            },
+            1 },
+        { "grow/shrinking", [] { GrowPattern::reset(state, NUM_PINS); },
+            [](const FrameTime& t) {
+                return GrowPattern::render(t, state, allPins, NUM_PINS,
+                    GrowParams { 60, 1, GROW_DELAY_MS, 0, palette, paletteSize, 40, 0 });
+            },
+            GROW_FILL_FRAMES + 2 },
+        { "chase", [] { ChasePattern::reset(state, NUM_PINS); },
+            [](const FrameTime& t) {
+                return ChasePattern::render(t, state, allPins, NUM_PINS,
+                    ChaseParams { 75, palette, paletteSize, 40, 200, 0 });
+            },
+            0 },
+        { "chase/fast", [] { ChasePattern::reset(state, NUM_PINS); },
+            [](const FrameTime& t) {
+                return ChasePattern::render(t, state, allPins, NUM_PINS,
+                    ChaseParams { 100, palette, paletteSize, 40, 50, 0 });
+            },
+            0 },
+        { "pop/sequential", [] { PopPattern::reset(state, NUM_PINS); },
+            [](const FrameTime& t) {
+                return PopPattern::render(t, state, allPins, NUM_PINS,
+                    PopParams { 80, 0, palette, paletteSize, false, 0 });
+            },
+            0 },
+        { "pop/random", [] { PopPattern::reset(state, NUM_PINS); },
+            [](const FrameTime& t) {
+                return PopPattern::render(t, state, allPins, NUM_PINS,
+                    PopParams { 80, 0, palette, paletteSize, true, 0 });
+            },
+            0 },
+        spinCase("spin/single", false, false, false),
+        spinCase("spin/loop", true, false, false),
+        spinCase("spin/loop+blend", true, false, true),
+        spinCase("spin/continuous", true, true, false),
+        spinCase("spin/continuous+blend", true, true, true),
+        { "program/symphony",
+            [] {
+                delete symphony;
+                symphony = buildSymphonyProgram();
+                symphony->start(millis());
+            },
+            [](const FrameTime& t) {
+                unsigned long before = symphony->getFramesPresented();
+                symphony->update(t);
+                return symphony->getFramesPresented() != before;
+            },
+            0 },
+        { "program/dispatch",
+            [] {
+                delete dispatch;
+                dispatch = buildDispatchProgram();
+                dispatch->start(millis());
+            },
+            [](const FrameTime& t) { return dispatch->render(t); }, 0 },
+        { "layers/flame", [] { startLayers(BLEND_REPLACE, 0); }, updateLayers, 0 },
+        { "layers/flame+spin/replace", [] { startLayers(BLEND_REPLACE, 255); }, updateLayers, 0 },
+        { "layers/flame+spin/add", [] { startLayers(BLEND_ADD, 255); }, updateLayers, 0 },
+        { "layers/flame+spin/alpha", [] { startLayers(BLEND_ALPHA, 192); }, updateLayers, 0 },
+        { "transition/crossfade", [] {},
+            [](const FrameTime& t) { return renderTransition(TRANSITION_CROSSFADE, t); }, 0 },
+        { "transition/wipe", [] {}, [](const FrameTime& t) { return renderTransition(TRANSITION_WIPE, t); }, 0 },
+        { "transition/stagger", [] {},
+            [](const FrameTime& t) { return renderTransition(TRANSITION_STAGGER, t); }, 0 },
+        { "blend/replace", [] {}, [](const FrameTime& t) { return renderBlend(BLEND_REPLACE, 192); }, 0 },
+        { "blend/add", [] {}, [](const FrameTime& t) { return renderBlend(BLEND_ADD, 192); }, 0 },
+        { "blend/max", [] {}, [](const FrameTime& t) { return renderBlend(BLEND_MAX, 192); }, 0 },
+        { "blend/multiply", [] {}, [](const FrameTime& t) { return renderBlend(BLEND_MULTIPLY, 192); }, 0 },
+        { "blend/alpha", [] {}, [](const FrameTime& t) { return renderBlend(BLEND_ALPHA, 192); }, 0 },
+        { "output/copy", [] {},
+            [](const FrameTime& t) {
+                composeFrame(outputBuffer, allDirty);
+                return true;
+            },
+            0 },
+        { "output/rotated",
+            [] {
+                for (int pin = 0; pin < NUM_PINS; pin++) {
+                    setPinRotation(pin, pinLeds(pin) / 3);
+                }
+            },
+            [](const FrameTime& t) {
+                composeFrame(outputBuffer, allDirty);
+                return true;
+            },
+            0 },
+        { "output/reverse+lut+dim",
+            [] {
+                for (int pin = 0; pin < NUM_PINS; pin++) {
+                    setPinRotation(pin, 0);
+                    setPinReversed(pin, true);
+                    setPinBrightness(pin, 128);
+                }
+                for (int strip = 0; strip < TOTAL_STRIPS; strip++) {
+                    setStripCorrection(strip, &correction);
+                }
+            },
+            [](const FrameTime& t) {
+                composeFrame(outputBuffer, allDirty);
+                return true;
+            },
+            0 },
+    };
+
+    printf("geometry: %d pins, %d LEDs, %d to %d per pin\n", NUM_PINS, TOTAL_LEDS, shortestPinLeds(0), MAX_LEDS_PER_PIN);
+    printf("%d fps, %d frames per case\n", BENCH_FPS, TIMED_FRAMES);
+    printf("state bytes on %d pins:", NUM_PINS);
+    for (int i = 0; i < Patterns::count; i++) {
+        printf(" %s %u", Patterns::table[i]->name, (unsigned)Patterns::table[i]->stateSize(NUM_PINS));
+    }
+    printf("\n");
+    printf("%-24s %10s %10s %10s %8s %12s\n", "pattern", "ns/frame", "renders/fr", "ns/render", "ns/LED",
+        "shows/frame");
+    for (const BenchCase& benchCase : cases) {
+        runCase(benchCase);
+    }
+    printf("program/symphony arena: %u bytes\n", (unsigned)symphony->getArenaBytes());
+
+    long coldSwitch, coldOther, warmSwitch, warmOther;
+    measureBoundaries(false, coldSwitch, coldOther);
+    measureBoundaries(true, warmSwitch, warmOther);
+    printf("main show max ns/frame: cold switch %ld other %ld, prepared switch %ld other %ld\n", coldSwitch,
+        coldOther, warmSwitch, warmOther);
+
+    return 0;
+}
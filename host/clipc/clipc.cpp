@@ -0,0 +1,223 @@
+// Records one pass of a show into a clip for the playback pattern.
+//
+//   clipc [output.bin [show.bin]]     defaults: clip.bin, the built-in show
+//
+// The Program is run on the shim's virtual clock at CLIP_FPS and leds[] is
+// taken after every frame, so the clip is frame-exact however long the
+// patterns take. Each frame is coded per pin against the frame before (see
+// clip.h). The clip is then played back through decodeClipFrame() and
+// checked against the recording, and the compression ratio, per segment and
+// overall, and the decode cost per frame are reported.
+
+#include "clip.h"
+#include "output.h"
+#include "program.h"
+#include "scheduler.h"
+#include "show.h"
+#include "show_loader.h"
+#include <chrono>
+#include <vector>
+
+#define CLIP_FPS 60
+// Stops the recording of a show that never comes back to its first segment
+#define MAX_SECONDS 3600
+
+static CRGB ledBuffer[TOTAL_LEDS];
+CRGB* leds = ledBuffer;
+
+struct SegmentStats {
+    unsigned long frames;
+    size_t bytes;
+};
+
+static void putRun(std::vector<uint8_t>& out, int op, int count)
+{
+    if (count <= CLIP_MAX_SHORT_RUN) {
+        out.push_back(op << 6 | count);
+    } else {
+        out.push_back(op << 6);
+        out.push_back(count & 0xFF);
+        out.push_back(count >> 8);
+    }
+}
+
+static void putPixels(std::vector<uint8_t>& out, const CRGB* pixels, int count)
+{
+    const uint8_t* bytes = pixels[0].raw;
+    out.insert(out.end(), bytes, bytes + 3 * count);
+}
+
+// Greedy: unchanged pixels are skipped, two or more equal ones are a fill
+// and the rest go out as literals. previous is null for the key frame.
+static void encodePin(std::vector<uint8_t>& out, const CRGB* pixels, const CRGB* previous, int count)
+{
+    int i = 0;
+    while (i < count) {
+        int skip = 0;
+        while (previous != nullptr && i + skip < count && pixels[i + skip] == previous[i + skip]) {
+            skip++;
+        }
+        if (skip > 0) {
+            putRun(out, CLIP_SKIP, skip);
+            i += skip;
+            continue;
+        }
+
+        int fill = 1;
+        while (i + fill < count && pixels[i + fill] == pixels[i]) {
+            fill++;
+        }
+        if (fill >= 2) {
+            putRun(out, CLIP_FILL, fill);
+            putPixels(out, pixels + i, 1);
+            i += fill;
+            continue;
+        }
+
+        int end = i + 1;
+        while (end < count && !(end + 1 < count && pixels[end] == pixels[end + 1])
+            && !(previous != nullptr && pixels[end] == previous[end])) {
+            end++;
+        }
+        putRun(out, CLIP_LITERAL, end - i);
+        putPixels(out, pixels + i, end - i);
+        i = end;
+    }
+}
+
+static void encodeFrame(std::vector<uint8_t>& out, const CRGB* frame, const CRGB* previous)
+{
+    size_t maskAt = out.size();
+    out.resize(out.size() + (NUM_PINS + 7) / 8, 0);
+    for (int pin = 0; pin < NUM_PINS; pin++) {
+        const CRGB* pixels = frame + pinOffset(pin);
+        const CRGB* before = previous != nullptr ? previous + pinOffset(pin) : nullptr;
+        if (before != nullptr && memcmp(pixels, before, pinLeds(pin) * sizeof(CRGB)) == 0) {
+            continue;
+        }
+        out[maskAt + pin / 8] |= 1 << (pin % 8);
+        encodePin(out, pixels, before, pinLeds(pin));
+    }
+}
+
+static Program* buildProgram(const char* showPath, std::vector<uint8_t>& memory)
+{
+    if (showPath == nullptr) {
+        return buildMainProgram();
+    }
+    static uint8_t image[65536];
+    size_t size;
+    if (!readShowFile(showPath, image, sizeof(image), &size)) {
+        return nullptr;
+    }
+    memory.resize(showMemoryBytes(image, size));
+    return loadShow(image, size, memory.data(), memory.size());
+}
+
+int main(int argc, char** argv)
+{
+    const char* outputName = argc > 1 ? argv[1] : "clip.bin";
+    const char* showPath = argc > 2 ? argv[2] : nullptr;
+
+    std::vector<uint8_t> showMemory;
+    Program* program = buildProgram(showPath, showMemory);
+    if (program == nullptr || !program->allocateState()) {
+        fprintf(stderr, "cannot load %s\n", showPath);
+        return 1;
+    }
+
+    // Record until the show is back at its first segment. The frames are
+    // taken from leds[] rather than composed, so no pin may be left rotated.
+    beginSideFrame();
+    std::vector<CRGB> frames;
+    std::vector<int> frameSegments;
+    hostSetMillis(0);
+    FrameScheduler scheduler(CLIP_FPS);
+    program->start(millis());
+    bool leftFirstSegment = false;
+    for (unsigned long f = 0; f < (unsigned long)MAX_SECONDS * CLIP_FPS; f++) {
+        FrameTime time = scheduler.beginFrame();
+        program->render(time);
+        scheduler.endFrame();
+
+        int segment = program->getCurrentSegment();
+        if (segment == 0 && leftFirstSegment) {
+            break;
+        }
+        leftFirstSegment |= segment != 0;
+        frames.insert(frames.end(), leds, leds + TOTAL_LEDS);
+        frameSegments.push_back(segment);
+    }
+    endSideFrame();
+    unsigned long numFrames = frameSegments.size();
+
+    std::vector<uint8_t> clip(sizeof(ClipHeader));
+    std::vector<SegmentStats> segments(program->getNumSegments(), SegmentStats { 0, 0 });
+    for (unsigned long f = 0; f < numFrames; f++) {
+        size_t before = clip.size();
+        encodeFrame(clip, &frames[f * TOTAL_LEDS], f == 0 ? nullptr : &frames[(f - 1) * TOTAL_LEDS]);
+        segments[frameSegments[f]].frames++;
+        segments[frameSegments[f]].bytes += clip.size() - before;
+    }
+
+    ClipHeader header;
+    memcpy(header.magic, CLIP_MAGIC, sizeof(header.magic));
+    header.version = CLIP_VERSION;
+    header.fps = CLIP_FPS;
+    header.numPins = NUM_PINS;
+    header.totalLeds = TOTAL_LEDS;
+    header.numFrames = numFrames;
+    header.totalBytes = clip.size();
+    memcpy(clip.data(), &header, sizeof(header));
+
+    // Play it back from a cleared buffer and compare every frame
+    setClipRegion(clip.data(), clip.size());
+    ClipHeader found;
+    const uint8_t* start = findClip(0, found);
+    int pins[NUM_PINS];
+    for (int pin = 0; pin < NUM_PINS; pin++) {
+        pins[pin] = pin;
+    }
+    memset(ledBuffer, 0, sizeof(ledBuffer));
+    const uint8_t* next = start != nullptr ? start + sizeof(ClipHeader) : nullptr;
+    double decodeNs = 0;
+    double maxDecodeNs = 0;
+    for (unsigned long f = 0; f < numFrames && next != nullptr; f++) {
+        bool changed;
+        auto begin = std::chrono::steady_clock::now();
+        next = decodeClipFrame(next, clip.data() + clip.size(), found, pins, NUM_PINS, &changed);
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count();
+        decodeNs += ns;
+        maxDecodeNs = max(maxDecodeNs, ns);
+        if (next != nullptr && memcmp(ledBuffer, &frames[f * TOTAL_LEDS], sizeof(ledBuffer)) != 0) {
+            next = nullptr;
+        }
+    }
+    if (next != clip.data() + clip.size()) {
+        fprintf(stderr, "clip does not play back as recorded\n");
+        return 1;
+    }
+
+    FILE* output = fopen(outputName, "wb");
+    if (output == nullptr || fwrite(clip.data(), 1, clip.size(), output) != clip.size()) {
+        fprintf(stderr, "cannot write %s\n", outputName);
+        return 1;
+    }
+    fclose(output);
+
+    size_t frameBytes = TOTAL_LEDS * sizeof(CRGB);
+    printf("%s: %lu frames at %d fps, %d pins, %d LEDs\n", outputName, numFrames, CLIP_FPS, NUM_PINS, TOTAL_LEDS);
+    printf("segment   frames      bytes  bytes/frame     ratio\n");
+    for (size_t s = 0; s < segments.size(); s++) {
+        if (segments[s].frames == 0) {
+            continue;
+        }
+        printf("%7zu %8lu %10zu %12.1f %8.1fx\n", s, segments[s].frames, segments[s].bytes,
+            (double)segments[s].bytes / segments[s].frames,
+            (double)segments[s].frames * frameBytes / max(segments[s].bytes, (size_t)1));
+    }
+    printf("total   %8lu %10zu %12.1f %8.1fx\n", numFrames, clip.size(), (double)clip.size() / numFrames,
+        (double)numFrames * frameBytes / clip.size());
+    printf("decode ns/frame: mean %.0f max %.0f\n", decodeNs / numFrames, maxDecodeNs);
+    return 0;
+}
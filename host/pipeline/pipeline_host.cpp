@@ -0,0 +1,170 @@
+// Runs a Program for a few seconds of wall time, first with render and show
+// back to back on one thread and then through FramePipeline with the
+// renderer on its own std::thread. show() is given the WS2812B wire time of
+// a pin so the numbers reflect what the ESP32 spends blocked on output.
+// Only strips whose pins changed are sent; the sent column is the share of
+// strips that went out, the rest being wire time saved. The async modes go
+// through the ParallelOutput mock, whose show() returns once the transfer
+// is queued, so output us/fr is encode time plus any wait on the fence.
+//
+// The opening segments of the main show tick slower than the wire, so the
+// flame program is included as the output-bound case where the pipeline
+// has something to overlap.
+
+#include "output.h"
+#include "patterns.h"
+#include "pipeline.h"
+#include "program.h"
+#include "scheduler.h"
+#include "show.h"
+#include <chrono>
+#include <thread>
+
+#define RUN_SECONDS 5
+
+// Above what the wire can carry, so output is the bottleneck
+#define TARGET_FPS 240
+
+static CRGB renderBuffer[TOTAL_LEDS];
+static CRGB ledBuffers[2][TOTAL_LEDS];
+CRGB* leds = renderBuffer;
+
+static void addControllers()
+{
+    FastLED.addLeds<WS2812B, 0, GRB>(ledBuffers[0], pinOffset(0), pinLeds(0));
+    FastLED.addLeds<WS2812B, 1, GRB>(ledBuffers[0], pinOffset(1), pinLeds(1));
+    FastLED.addLeds<WS2812B, 2, GRB>(ledBuffers[0], pinOffset(2), pinLeds(2));
+    FastLED.addLeds<WS2812B, 3, GRB>(ledBuffers[0], pinOffset(3), pinLeds(3));
+    FastLED.addLeds<WS2812B, 4, GRB>(ledBuffers[0], pinOffset(4), pinLeds(4));
+    FastLED.addLeds<WS2812B, 5, GRB>(ledBuffers[0], pinOffset(5), pinLeds(5));
+    FastLED.addLeds<WS2812B, 6, GRB>(ledBuffers[0], pinOffset(6), pinLeds(6));
+    FastLED.addLeds<WS2812B, 7, GRB>(ledBuffers[0], pinOffset(7), pinLeds(7));
+}
+
+// Overlap is the share of render time that ran while a show() was on the wire
+static void report(const char* mode, unsigned long frames, unsigned long renderMicros, unsigned long overlapMicros,
+    unsigned long outputMicros, unsigned long wallMicros)
+{
+    unsigned long strips = getStripsSent() + getStripsSkipped();
+    printf("%-20s %8lu %10.1f %14.1f %14.1f %9.0f%% %7.0f%%\n", mode, frames, frames * 1e6 / wallMicros,
+        frames ? (double)renderMicros / frames : 0.0, frames ? (double)outputMicros / frames : 0.0,
+        renderMicros ? 100.0 * overlapMicros / renderMicros : 0.0, strips ? 100.0 * getStripsSent() / strips : 0.0);
+}
+
+// Flame on every pin at full speed: the staggered per-pin ticks produce a
+// new frame more often than one can be transmitted
+static Program* buildFlameProgram()
+{
+    static int allPins[] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+    FlameParams flameParams;
+    flameParams.speed = 100;
+    flameParams.cooling = 55;
+    flameParams.sparking = 120;
+
+    Program* program = new Program(1);
+    program->addSegment(0, new Segment(allPins, NUM_PINS, 3600, flameParams));
+    return program;
+}
+
+static ParallelOutput* parallelOutput = nullptr;
+
+static void runSequential(const char* name, Program* (*buildProgram)(), bool async)
+{
+    Program* program = buildProgram();
+    FrameScheduler scheduler(TARGET_FPS);
+    unsigned long renderMicros = 0;
+    unsigned long overlapMicros = 0;
+    unsigned long outputMicros = 0;
+    unsigned long frames = 0;
+
+    setOutputFrame(ledBuffers[0]);
+    useParallelOutput(async ? parallelOutput : nullptr);
+    resetStripCounters();
+    program->start(millis());
+
+    unsigned long begin = micros();
+    while (micros() - begin < RUN_SECONDS * 1000000UL) {
+        FrameTime time = scheduler.beginFrame();
+        bool busyAtBegin = outputBusy();
+        unsigned long renderBegin = micros();
+        bool changed = program->render(time);
+
+        if (changed) {
+            bool dirty[NUM_PINS];
+            takeDirtyPins(dirty);
+            composeFrame(ledBuffers[0], dirty);
+            unsigned long elapsed = micros() - renderBegin;
+            renderMicros += elapsed;
+            if (busyAtBegin && outputBusy()) {
+                overlapMicros += elapsed;
+            }
+            unsigned long outputBegin = micros();
+            showPins(dirty);
+            outputMicros += micros() - outputBegin;
+            frames++;
+        }
+        scheduler.endFrame();
+    }
+
+    if (parallelOutput) {
+        parallelOutput->wait();
+    }
+    report(name, frames, renderMicros, overlapMicros, outputMicros, micros() - begin);
+    delete program;
+}
+
+static void runPipelined(const char* name, Program* (*buildProgram)(), bool async)
+{
+    Program* program = buildProgram();
+    FrameScheduler scheduler(TARGET_FPS);
+    FramePipeline pipeline(program, &scheduler, ledBuffers[0], ledBuffers[1]);
+
+    setOutputFrame(ledBuffers[0]);
+    useParallelOutput(async ? parallelOutput : nullptr);
+    resetStripCounters();
+    program->start(millis());
+    pipeline.start(0);
+
+    unsigned long begin = micros();
+    while (micros() - begin < RUN_SECONDS * 1000000UL) {
+        if (!pipeline.present()) {
+            std::this_thread::yield();
+        }
+    }
+    pipeline.stop();
+    if (parallelOutput) {
+        parallelOutput->wait();
+    }
+
+    report(name, pipeline.getFramesPresented(), pipeline.getRenderMicros(), pipeline.getOverlapMicros(),
+        pipeline.getOutputMicros(), micros() - begin);
+    delete program;
+}
+
+int main()
+{
+    hostUseRealClock(true);
+    hostModelWireTime(true);
+    addControllers();
+
+    static const int lanePins[PARALLEL_LANES] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+    parallelOutput = new ParallelOutput(lanePins, NUM_PINS);
+    parallelOutput->begin();
+
+    printf("%d pins, %d LEDs, %d s per mode, %d us wire time per frame\n", NUM_PINS, TOTAL_LEDS, RUN_SECONDS,
+        MAX_LEDS_PER_PIN * WS2812B_MICROS_PER_LED);
+    printf("%-20s %8s %10s %14s %14s %10s %8s\n", "mode", "frames", "fps", "render us/fr", "output us/fr", "overlap",
+        "sent");
+    runSequential("show/sequential", buildMainProgram, false);
+    runPipelined("show/pipelined", buildMainProgram, false);
+    runSequential("flame/sequential", buildFlameProgram, false);
+    runPipelined("flame/pipelined", buildFlameProgram, false);
+    runSequential("flame/async", buildFlameProgram, true);
+    runPipelined("flame/async+pipelined", buildFlameProgram, true);
+
+    printf("parallel output: %lu transfers, %.1f us encode per transfer\n", parallelOutput->getTransfers(),
+        parallelOutput->getTransfers() ? (double)parallelOutput->getEncodeMicros() / parallelOutput->getTransfers()
+                                       : 0.0);
+    delete parallelOutput;
+    return 0;
+}
@@ -0,0 +1,151 @@
+#!/usr/bin/env python3
+"""Decodes the frame profiler's records (see src/profiler.h).
+
+    decode_profile.py [capture | - | /dev/ttyUSB0] [--baud 115200]
+
+Reads a capture file, stdin (the default), or a serial port, which needs
+pyserial. Records are found by their magic among whatever else is on the
+line, such as the firmware's text report, and ones that fail the checksum
+are skipped. Each record is printed as a table of its probes with min, p50,
+p99 and max in microseconds. Percentiles come from the histogram buckets and
+are the upper edge of the bucket they fall in, clamped to the probe's min and
+max.
+"""
+
+import argparse
+import struct
+import sys
+
+MAGIC = b"FLPR"
+VERSION = 1
+HEADER = struct.Struct("<4sHHI")
+KINDS = ["loop", "compose", "show", "pattern"]
+
+
+def fnv1a(data):
+    value = 2166136261
+    for byte in data:
+        value = ((value ^ byte) * 16777619) & 0xFFFFFFFF
+    return value
+
+
+def bucket_upper(bucket):
+    """Cycles at the top of a bucket, as src/profiler.cpp fills them."""
+    if bucket == 0:
+        return 64
+    octave = 6 + (bucket - 1) // 4
+    sub = (bucket - 1) % 4
+    return (5 + sub) << (octave - 2)
+
+
+def percentile(buckets, count, fraction):
+    target = fraction * count
+    seen = 0
+    for bucket, bucket_count in sorted(buckets):
+        seen += bucket_count
+        if seen >= target:
+            return bucket_upper(bucket)
+    return 0
+
+
+def parse_payload(payload):
+    cycles_per_micro, window_ms, num_probes = struct.unpack_from("<HIB", payload, 0)
+    offset = 7
+    probes = []
+    for _ in range(num_probes):
+        kind, segment, instance, name_bytes = struct.unpack_from("<BBBB", payload, offset)
+        offset += 4
+        name = payload[offset : offset + name_bytes].decode("ascii", "replace")
+        offset += name_bytes
+        count, low, high, used = struct.unpack_from("<IIIB", payload, offset)
+        offset += 13
+        buckets = []
+        for _ in range(used):
+            buckets.append(struct.unpack_from("<BI", payload, offset))
+            offset += 5
+        probes.append((kind, segment, instance, name, count, low, high, buckets))
+    return cycles_per_micro, window_ms, probes
+
+
+def print_record(cycles_per_micro, window_ms, probes):
+    def us(cycles):
+        return cycles / cycles_per_micro
+
+    print(f"window {window_ms / 1000:.1f} s, {cycles_per_micro} cycles/us")
+    print(f"{'probe':<24} {'count':>8} {'min us':>9} {'p50 us':>9} {'p99 us':>9} {'max us':>9}")
+    for kind, segment, instance, name, count, low, high, buckets in probes:
+        if kind == KINDS.index("pattern"):
+            label = f"{segment}.{instance} {name}"
+        else:
+            label = name
+        if count == 0:
+            print(f"{label:<24} {0:>8}")
+            continue
+        p50 = min(max(percentile(buckets, count, 0.50), low), high)
+        p99 = min(max(percentile(buckets, count, 0.99), low), high)
+        print(f"{label:<24} {count:>8} {us(low):>9.1f} {us(p50):>9.1f} {us(p99):>9.1f} {us(high):>9.1f}")
+    print()
+
+
+def decode(stream):
+    buffer = b""
+    while True:
+        chunk = stream.read(4096)
+        if not chunk:
+            break
+        buffer += chunk
+        while True:
+            start = buffer.find(MAGIC)
+            if start < 0:
+                buffer = buffer[-(len(MAGIC) - 1) :]
+                break
+            if len(buffer) - start < HEADER.size:
+                buffer = buffer[start:]
+                break
+            _, version, payload_bytes, checksum = HEADER.unpack_from(buffer, start)
+            end = start + HEADER.size + payload_bytes
+            if len(buffer) < end:
+                buffer = buffer[start:]
+                break
+            payload = buffer[start + HEADER.size : end]
+            if version == VERSION and fnv1a(payload) == checksum:
+                print_record(*parse_payload(payload))
+                buffer = buffer[end:]
+            else:
+                buffer = buffer[start + 1 :]
+        sys.stdout.flush()
+
+
+class SerialStream:
+    """Reads whatever has arrived, waiting for more rather than ending."""
+
+    def __init__(self, port):
+        self.port = port
+
+    def read(self, size):
+        while True:
+            chunk = self.port.read(min(size, max(1, self.port.in_waiting)))
+            if chunk:
+                return chunk
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("source", nargs="?", default="-")
+    parser.add_argument("--baud", type=int, default=115200)
+    args = parser.parse_args()
+
+    if args.source == "-":
+        decode(sys.stdin.buffer)
+    elif args.source.startswith("/dev/") or args.source.upper().startswith("COM"):
+        import serial
+
+        with serial.Serial(args.source, args.baud, timeout=0.2) as port:
+            decode(SerialStream(port))
+    else:
+        with open(args.source, "rb") as capture:
+            decode(capture)
+
+
+if __name__ == "__main__":
+    main()
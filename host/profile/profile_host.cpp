@@ -0,0 +1,55 @@
+// Host run of the frame profiler. The built-in show plays as loop() plays
+// it without the render pipeline, on the shim's virtual clock, and a profile
+// record is written to stdout every REPORT_SECONDS of show time, as the
+// firmware sends it over Serial. Decode it with
+//
+//   pio run -e native_profile -t exec | python3 host/profile/decode_profile.py
+//
+// Times are real host nanoseconds, reported as cycles of a 1 GHz clock.
+
+#include "output.h"
+#include "profiler.h"
+#include "program.h"
+#include "scheduler.h"
+#include "show.h"
+
+#if !FRAME_PROFILER
+#error "build with -DFRAME_PROFILER=1"
+#endif
+
+#define PROFILE_FPS 60
+#define PROFILE_SECONDS 95
+#define REPORT_SECONDS 10
+
+static CRGB renderBuffer[TOTAL_LEDS];
+static CRGB outputBuffer[TOTAL_LEDS];
+CRGB* leds = renderBuffer;
+
+int main()
+{
+    setOutputFrame(outputBuffer);
+    Program* program = buildMainProgram();
+    FrameScheduler scheduler(PROFILE_FPS);
+    hostSetMillis(0);
+    program->start(millis());
+
+    unsigned long lastReport = 0;
+    for (int frame = 0; frame < PROFILE_FPS * PROFILE_SECONDS; frame++) {
+        {
+            ProfileScope scope(PROFILE_PROBE_LOOP);
+            FrameTime time = scheduler.beginFrame();
+            program->update(time);
+            scheduler.endFrame();
+            program->prepareNext();
+        }
+        if (millis() - lastReport >= REPORT_SECONDS * 1000) {
+            lastReport = millis();
+            dumpProfile();
+        }
+    }
+    dumpProfile();
+    fflush(stdout);
+
+    delete program;
+    return 0;
+}
@@ -0,0 +1,142 @@
+// Golden trace test. One pass of the built-in show and one of data/show.bin
+// are played with traceProgram() and compared frame by frame against a trace
+// recorded earlier; the first frame that differs fails the test, with its
+// time and segment.
+//
+//   replay_host [--record] [trace]     default: host/replay/main_show.trace
+//
+// --record writes the trace from the built-in show instead, for when a change
+// is meant to change the output. Run from the repository root.
+
+#include "replay.h"
+#include "show.h"
+#include "show_loader.h"
+#include <string>
+#include <vector>
+
+#define TRACE_FPS 60
+#define TRACE_SEED 0
+#define SHOW_IMAGE_BYTES 4096
+
+static CRGB ledBuffer[TOTAL_LEDS];
+CRGB* leds = ledBuffer;
+
+struct Replay {
+    Program* program;
+    const std::vector<uint32_t>* expected;
+    std::vector<uint32_t> hashes;
+    long firstDiverging;
+    int divergingSegment;
+};
+
+static void checkFrame(unsigned long frame, uint32_t hash, void* context)
+{
+    Replay* replay = static_cast<Replay*>(context);
+    replay->hashes.push_back(hash);
+    if (replay->expected == nullptr || replay->firstDiverging >= 0) {
+        return;
+    }
+    if (frame >= replay->expected->size() || (*replay->expected)[frame] != hash) {
+        replay->firstDiverging = frame;
+        replay->divergingSegment = replay->program->getCurrentSegment();
+    }
+}
+
+static unsigned long framesOf(Program* program) { return (uint64_t)program->getDurationMillis() * TRACE_FPS / 1000; }
+
+static bool readTrace(const char* path, std::vector<uint32_t>& hashes)
+{
+    FILE* file = fopen(path, "r");
+    if (file == nullptr) {
+        return false;
+    }
+    char line[128];
+    while (fgets(line, sizeof(line), file) != nullptr) {
+        char* end;
+        unsigned long hash = strtoul(line, &end, 16);
+        if (line[0] != '#' && end == line + 8) {
+            hashes.push_back(hash);
+        }
+    }
+    fclose(file);
+    return true;
+}
+
+static bool writeTrace(const char* path, const std::vector<uint32_t>& hashes)
+{
+    FILE* file = fopen(path, "w");
+    if (file == nullptr) {
+        return false;
+    }
+    fprintf(file, "# seed %d fps %d frames %zu\n", TRACE_SEED, TRACE_FPS, hashes.size());
+    for (uint32_t hash : hashes) {
+        fprintf(file, "%08x\n", hash);
+    }
+    return fclose(file) == 0;
+}
+
+static bool replay(const char* name, Program* program, const std::vector<uint32_t>& expected)
+{
+    Replay replay = { program, &expected, {}, -1, 0 };
+    program->setSeed(TRACE_SEED);
+    traceProgram(*program, TRACE_FPS, framesOf(program), checkFrame, &replay);
+
+    if (replay.hashes.size() != expected.size() && replay.firstDiverging < 0) {
+        replay.firstDiverging = min(replay.hashes.size(), expected.size());
+    }
+    if (replay.firstDiverging >= 0) {
+        unsigned long frame = replay.firstDiverging;
+        printf("%s: FAIL at frame %lu (%lu ms, segment %d): expected %08x, got %08x\n", name, frame,
+            fixedFrameTime(frame, TRACE_FPS).now, replay.divergingSegment,
+            frame < expected.size() ? expected[frame] : 0, frame < replay.hashes.size() ? replay.hashes[frame] : 0);
+        return false;
+    }
+    printf("%s: %zu frames match\n", name, expected.size());
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    bool record = false;
+    const char* tracePath = "host/replay/main_show.trace";
+    for (int i = 1; i < argc; i++) {
+        if (std::string(argv[i]) == "--record") {
+            record = true;
+        } else {
+            tracePath = argv[i];
+        }
+    }
+
+    Program* builtIn = buildMainProgram();
+    if (record) {
+        Replay replay = { builtIn, nullptr, {}, -1, 0 };
+        builtIn->setSeed(TRACE_SEED);
+        traceProgram(*builtIn, TRACE_FPS, framesOf(builtIn), checkFrame, &replay);
+        if (!writeTrace(tracePath, replay.hashes)) {
+            fprintf(stderr, "cannot write %s\n", tracePath);
+            return 1;
+        }
+        printf("%s: %zu frames recorded\n", tracePath, replay.hashes.size());
+        return 0;
+    }
+
+    std::vector<uint32_t> expected;
+    if (!readTrace(tracePath, expected)) {
+        fprintf(stderr, "cannot read %s\n", tracePath);
+        return 1;
+    }
+    bool passed = replay("built-in show", builtIn, expected);
+
+    static uint8_t image[SHOW_IMAGE_BYTES];
+    size_t size;
+    if (!readShowFile("data/show.bin", image, sizeof(image), &size)) {
+        fprintf(stderr, "cannot read data/show.bin\n");
+        return 1;
+    }
+    std::vector<uint8_t> memory(showMemoryBytes(image, size));
+    Program* loaded = loadShow(image, size, memory.data(), memory.size());
+    passed = loaded != nullptr && replay("data/show.bin", loaded, expected) && passed;
+
+    printf(passed ? "PASS\n" : "FAIL\n");
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,46 @@
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+// Host stand-in for the parts of the Arduino core the show code uses.
+// Time is virtual by default: millis() only moves when the host harness
+// advances it. Tools that run threads against wall time switch to the real
+// clock instead.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using std::max;
+using std::min;
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+void hostSetMillis(unsigned long ms);
+void hostAdvanceMillis(unsigned long ms);
+void hostUseRealClock(bool enabled);
+// Makes the real clock run fast or slow by ppm, as a board's crystal does
+void hostSetClockDrift(long ppm);
+
+long map(long x, long inMin, long inMax, long outMin, long outMax);
+
+// Where the ESP32 core places code that interrupts run; the host has no such
+// constraint
+#define IRAM_ATTR
+
+class HostSerial {
+public:
+    void begin(unsigned long baud) { (void)baud; }
+    void print(const char* text) { fputs(text, stdout); }
+    void println(const char* text) { puts(text); }
+    size_t write(const uint8_t* data, size_t length) { return fwrite(data, 1, length, stdout); }
+};
+
+extern HostSerial Serial;
+
+#endif
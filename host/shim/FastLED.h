@@ -0,0 +1,185 @@
+#ifndef HOST_FASTLED_H
+#define HOST_FASTLED_H
+
+// Host stand-in for the subset of FastLED the show code uses. The math
+// helpers follow FastLED's integer definitions so host output matches the
+// device bit for bit.
+
+#include <Arduino.h>
+
+typedef uint8_t fract8;
+
+inline uint8_t qadd8(uint8_t i, uint8_t j)
+{
+    unsigned int t = i + j;
+    return t > 255 ? 255 : t;
+}
+
+inline uint8_t qsub8(uint8_t i, uint8_t j) { return i > j ? i - j : 0; }
+
+inline uint8_t scale8(uint8_t i, fract8 scale) { return ((uint16_t)i * (1 + (uint16_t)scale)) >> 8; }
+
+inline uint8_t scale8_video(uint8_t i, fract8 scale) { return (((int)i * (int)scale) >> 8) + ((i && scale) ? 1 : 0); }
+
+inline uint8_t lerp8by8(uint8_t a, uint8_t b, fract8 frac)
+{
+    if (b > a) {
+        return a + scale8(b - a, frac);
+    }
+    return a - scale8(a - b, frac);
+}
+
+extern uint16_t rand16seed;
+
+inline uint8_t random8()
+{
+    rand16seed = (rand16seed * 2053) + 13849;
+    return (uint8_t)(((uint8_t)(rand16seed & 0xFF)) + ((uint8_t)(rand16seed >> 8)));
+}
+
+inline uint8_t random8(uint8_t lim) { return (random8() * lim) >> 8; }
+
+inline uint8_t random8(uint8_t min, uint8_t lim) { return random8(lim - min) + min; }
+
+inline uint16_t random16()
+{
+    rand16seed = (rand16seed * 2053) + 13849;
+    return rand16seed;
+}
+
+inline void random16_set_seed(uint16_t seed) { rand16seed = seed; }
+
+struct CRGB {
+    union {
+        struct {
+            uint8_t r;
+            uint8_t g;
+            uint8_t b;
+        };
+        uint8_t raw[3];
+    };
+
+    typedef enum {
+        Black = 0x000000,
+        Blue = 0x0000FF,
+        Cyan = 0x00FFFF,
+        Green = 0x008000,
+        Indigo = 0x4B0082,
+        Magenta = 0xFF00FF,
+        Orange = 0xFFA500,
+        Pink = 0xFFC0CB,
+        Purple = 0x800080,
+        Red = 0xFF0000,
+        Teal = 0x008080,
+        Violet = 0xEE82EE,
+        White = 0xFFFFFF,
+        Yellow = 0xFFFF00
+    } HTMLColorCode;
+
+    CRGB() = default;
+    constexpr CRGB(uint8_t ir, uint8_t ig, uint8_t ib)
+        : r(ir)
+        , g(ig)
+        , b(ib)
+    {
+    }
+    constexpr CRGB(uint32_t colorcode)
+        : r((colorcode >> 16) & 0xFF)
+        , g((colorcode >> 8) & 0xFF)
+        , b(colorcode & 0xFF)
+    {
+    }
+    constexpr CRGB(HTMLColorCode colorcode)
+        : CRGB((uint32_t)colorcode)
+    {
+    }
+
+    CRGB& nscale8(uint8_t scaledown)
+    {
+        r = scale8(r, scaledown);
+        g = scale8(g, scaledown);
+        b = scale8(b, scaledown);
+        return *this;
+    }
+
+    CRGB lerp8(const CRGB& other, fract8 frac) const
+    {
+        return CRGB(lerp8by8(r, other.r, frac), lerp8by8(g, other.g, frac), lerp8by8(b, other.b, frac));
+    }
+
+    bool operator==(const CRGB& other) const { return r == other.r && g == other.g && b == other.b; }
+    bool operator!=(const CRGB& other) const { return !(*this == other); }
+};
+
+CRGB HeatColor(uint8_t temperature);
+
+enum EOrder { RGB = 0012, GRB = 0102 };
+
+template <uint8_t DATA_PIN, EOrder RGB_ORDER> class WS2812B { };
+
+class CLEDController {
+public:
+    CLEDController& setLeds(CRGB* data, int nLeds)
+    {
+        ledData = data;
+        numLeds = nLeds;
+        return *this;
+    }
+
+    CRGB* leds() { return ledData; }
+    int size() { return numLeds; }
+
+    // show() passes over disabled controllers
+    void setEnabled(bool enabled) { isEnabled = enabled; }
+    bool getEnabled() { return isEnabled; }
+
+private:
+    CRGB* ledData = nullptr;
+    int numLeds = 0;
+    bool isEnabled = true;
+};
+
+// Records controller registrations and show() calls so host tools can see
+// how much output a frame would have cost on the wire. With the wire time
+// model on, show() also blocks for as long as a WS2812B chain of the longest
+// enabled controller takes to clock out, as the RMT driver does on the ESP32.
+class CFastLED {
+public:
+    static const int MAX_CONTROLLERS = 16;
+
+    template <template <uint8_t, EOrder> class CHIPSET, uint8_t DATA_PIN, EOrder RGB_ORDER>
+    CLEDController& addLeds(CRGB* data, int offset, int count)
+    {
+        CLEDController& controller = controllers[numControllers < MAX_CONTROLLERS ? numControllers++ : 0];
+        return controller.setLeds(data + offset, count);
+    }
+
+    CLEDController& operator[](int index) { return controllers[index]; }
+    int count() { return numControllers; }
+
+    void setBrightness(uint8_t scale) { brightness = scale; }
+    uint8_t getBrightness() { return brightness; }
+    void clear();
+    void show();
+
+    unsigned long getShowCount() { return showCount; }
+    unsigned long getLedsShown() { return ledsShown; }
+    void resetCounters();
+
+private:
+    CLEDController controllers[MAX_CONTROLLERS];
+    int numControllers = 0;
+    uint8_t brightness = 255;
+    unsigned long showCount = 0;
+    unsigned long ledsShown = 0;
+};
+
+extern CFastLED FastLED;
+
+// WS2812B bit time is 1.25us, so 24 bits per LED take 30us on the wire
+#define WS2812B_MICROS_PER_LED 30
+
+void hostModelWireTime(bool enabled);
+bool hostIsModellingWireTime();
+
+#endif
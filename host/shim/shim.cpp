@@ -0,0 +1,124 @@
+#include <Arduino.h>
+#include <FastLED.h>
+#include <chrono>
+#include <thread>
+
+static unsigned long virtualMicros = 0;
+static bool realClock = false;
+static std::chrono::steady_clock::time_point realClockEpoch;
+static long clockDriftPpm = 0;
+static bool wireTimeModel = false;
+
+HostSerial Serial;
+CFastLED FastLED;
+uint16_t rand16seed = 1337;
+
+unsigned long millis() { return micros() / 1000UL; }
+
+unsigned long micros()
+{
+    if (realClock) {
+        auto elapsed = std::chrono::steady_clock::now() - realClockEpoch;
+        int64_t us = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+        return us + us * clockDriftPpm / 1000000;
+    }
+    return virtualMicros;
+}
+
+void delay(unsigned long ms)
+{
+    if (realClock) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+    } else {
+        virtualMicros += ms * 1000UL;
+    }
+}
+
+void delayMicroseconds(unsigned int us)
+{
+    if (realClock) {
+        std::this_thread::sleep_for(std::chrono::microseconds(us));
+    } else {
+        virtualMicros += us;
+    }
+}
+
+void hostSetMillis(unsigned long ms) { virtualMicros = ms * 1000UL; }
+
+void hostAdvanceMillis(unsigned long ms) { virtualMicros += ms * 1000UL; }
+
+void hostUseRealClock(bool enabled)
+{
+    realClock = enabled;
+    realClockEpoch = std::chrono::steady_clock::now();
+}
+
+void hostSetClockDrift(long ppm) { clockDriftPpm = ppm; }
+
+void hostModelWireTime(bool enabled) { wireTimeModel = enabled; }
+
+bool hostIsModellingWireTime() { return wireTimeModel; }
+
+long map(long x, long inMin, long inMax, long outMin, long outMax)
+{
+    return (x - inMin) * (outMax - outMin) / (inMax - inMin) + outMin;
+}
+
+CRGB HeatColor(uint8_t temperature)
+{
+    CRGB heatcolor;
+
+    // Scale 'heat' down from 0-255 to 0-191, then split into three ramps
+    uint8_t t192 = scale8_video(temperature, 191);
+    uint8_t heatramp = t192 & 0x3F;
+    heatramp <<= 2;
+
+    if (t192 & 0x80) {
+        heatcolor.r = 255;
+        heatcolor.g = 255;
+        heatcolor.b = heatramp;
+    } else if (t192 & 0x40) {
+        heatcolor.r = 255;
+        heatcolor.g = heatramp;
+        heatcolor.b = 0;
+    } else {
+        heatcolor.r = heatramp;
+        heatcolor.g = 0;
+        heatcolor.b = 0;
+    }
+
+    return heatcolor;
+}
+
+void CFastLED::clear()
+{
+    for (int c = 0; c < numControllers; c++) {
+        for (int i = 0; i < controllers[c].size(); i++) {
+            controllers[c].leds()[i] = CRGB::Black;
+        }
+    }
+}
+
+void CFastLED::show()
+{
+    int longestChain = 0;
+
+    showCount++;
+    for (int c = 0; c < numControllers; c++) {
+        if (!controllers[c].getEnabled()) {
+            continue;
+        }
+        ledsShown += controllers[c].size();
+        longestChain = max(longestChain, controllers[c].size());
+    }
+
+    if (wireTimeModel) {
+        std::this_thread::sleep_for(std::chrono::microseconds(longestChain * WS2812B_MICROS_PER_LED));
+    }
+}
+
+void CFastLED::resetCounters()
+{
+    showCount = 0;
+    ledsShown = 0;
+}
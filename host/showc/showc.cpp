@@ -0,0 +1,381 @@
+// Compiles a text show description into the binary image loadShow() reads.
+//
+//   showc [input.txt [output.bin]]     defaults: data/show.txt, data/show.bin
+//
+// The description is a list of segments, each followed by its pattern
+// instances, one to a line. A segment may name the transition it comes in
+// with and its length in milliseconds. A token starting with '#' starts a
+// comment.
+//
+//   segment 15 crossfade 1500
+//   spin pins=0-7 speed=75 loop=1 palette=Red,Blue,#00FF80
+//   flame pins=3,4,5 reverse speed=90 cooling=60 sparking=130
+//   spin pins=3,4,5 layer=alpha opacity=200 speed=75 palette=White
+//
+// Keys are the pattern's param names. Fields left out are 0, and palettes
+// take FastLED color names or #RRGGBB. Identical palettes are stored once.
+// An instance sharing pins with earlier ones in its segment goes over them
+// as its layer= blend mode says, replace by default, at its opacity=, 0 to
+// 255 and 255 by default.
+// The image is loaded back before it is written, and the memory it takes
+// and the time it takes to load are reported.
+
+#include "show_format.h"
+#include "show_loader.h"
+#include <chrono>
+#include <string>
+#include <vector>
+
+CRGB* leds = nullptr;
+
+struct NamedColor {
+    const char* name;
+    CRGB color;
+};
+
+static const NamedColor namedColors[] = {
+    { "Black", CRGB::Black },
+    { "Blue", CRGB::Blue },
+    { "Cyan", CRGB::Cyan },
+    { "Green", CRGB::Green },
+    { "Indigo", CRGB::Indigo },
+    { "Magenta", CRGB::Magenta },
+    { "Orange", CRGB::Orange },
+    { "Pink", CRGB::Pink },
+    { "Purple", CRGB::Purple },
+    { "Red", CRGB::Red },
+    { "Teal", CRGB::Teal },
+    { "Violet", CRGB::Violet },
+    { "White", CRGB::White },
+    { "Yellow", CRGB::Yellow },
+};
+
+struct ShowBuilder {
+    std::vector<ShowSegment> segments;
+    std::vector<ShowInstance> instances;
+    std::vector<int32_t> values;
+    std::vector<ShowColor> colors;
+    std::vector<uint8_t> pins;
+};
+
+static std::string sourceName;
+static int lineNumber = 0;
+
+static bool fail(const std::string& message)
+{
+    fprintf(stderr, "%s:%d: %s\n", sourceName.c_str(), lineNumber, message.c_str());
+    return false;
+}
+
+static std::vector<std::string> split(const std::string& text, char separator)
+{
+    std::vector<std::string> parts;
+    size_t start = 0;
+    while (start <= text.size()) {
+        size_t end = text.find(separator, start);
+        if (end == std::string::npos) {
+            end = text.size();
+        }
+        if (end > start) {
+            parts.push_back(text.substr(start, end - start));
+        }
+        start = end + 1;
+    }
+    return parts;
+}
+
+static bool parseInt(const std::string& text, int32_t& value)
+{
+    char* end;
+    long parsed = strtol(text.c_str(), &end, 10);
+    if (text.empty() || *end != '\0') {
+        return false;
+    }
+    value = (int32_t)parsed;
+    return true;
+}
+
+static bool parseColor(const std::string& text, ShowColor& color)
+{
+    if (text.size() == 7 && text[0] == '#') {
+        char* end;
+        unsigned long rgb = strtoul(text.c_str() + 1, &end, 16);
+        if (*end != '\0') {
+            return false;
+        }
+        color = { (uint8_t)(rgb >> 16), (uint8_t)(rgb >> 8), (uint8_t)rgb };
+        return true;
+    }
+    for (const NamedColor& named : namedColors) {
+        if (text == named.name) {
+            color = { named.color.r, named.color.g, named.color.b };
+            return true;
+        }
+    }
+    return false;
+}
+
+// "0-7" or "0,1,2", or a mix of both
+static bool parsePins(const std::string& text, ShowBuilder& show, ShowInstance& instance)
+{
+    instance.firstPin = show.pins.size();
+    for (const std::string& part : split(text, ',')) {
+        std::vector<std::string> range = split(part, '-');
+        int32_t first, last;
+        if (range.empty() || range.size() > 2 || !parseInt(range[0], first)
+            || !parseInt(range.size() == 2 ? range[1] : range[0], last) || first < 0 || last < first
+            || last >= NUM_PINS) {
+            return fail("bad pins '" + text + "'");
+        }
+        for (int pin = first; pin <= last; pin++) {
+            show.pins.push_back(pin);
+        }
+    }
+    instance.numPins = show.pins.size() - instance.firstPin;
+    return true;
+}
+
+// Index of the palette in the color table, reusing an identical run
+static int32_t addPalette(ShowBuilder& show, const std::vector<ShowColor>& palette)
+{
+    for (size_t start = 0; start + palette.size() <= show.colors.size(); start++) {
+        if (memcmp(&show.colors[start], palette.data(), palette.size() * sizeof(ShowColor)) == 0) {
+            return start;
+        }
+    }
+    int32_t start = show.colors.size();
+    show.colors.insert(show.colors.end(), palette.begin(), palette.end());
+    return start;
+}
+
+static bool parseInstance(const std::vector<std::string>& tokens, ShowBuilder& show)
+{
+    if (show.segments.empty()) {
+        return fail("pattern before the first segment");
+    }
+    const PatternOps* ops = Patterns::find(tokens[0].c_str());
+    if (ops == nullptr) {
+        return fail("unknown pattern '" + tokens[0] + "'");
+    }
+
+    ShowInstance instance;
+    memset(&instance, 0, sizeof(instance));
+    if (strlen(ops->name) > SHOW_PATTERN_NAME_BYTES) {
+        return fail("pattern name too long for the format");
+    }
+    memcpy(instance.pattern, ops->name, strlen(ops->name));
+    instance.blend = BLEND_REPLACE;
+    instance.opacity = 255;
+
+    // Values in field order, filled in by key
+    std::vector<std::string> settings;
+    for (const ParamField* field = ops->fields; field->name != nullptr; field++) {
+        settings.push_back("");
+    }
+    bool hasPins = false;
+    for (size_t t = 1; t < tokens.size(); t++) {
+        if (tokens[t] == "reverse") {
+            instance.reverse = 1;
+            continue;
+        }
+        size_t equals = tokens[t].find('=');
+        if (equals == std::string::npos) {
+            return fail("expected key=value, got '" + tokens[t] + "'");
+        }
+        std::string key = tokens[t].substr(0, equals);
+        std::string value = tokens[t].substr(equals + 1);
+        if (key == "pins") {
+            if (!parsePins(value, show, instance)) {
+                return false;
+            }
+            hasPins = true;
+            continue;
+        }
+        if (key == "layer") {
+            int mode = findBlendMode(value.c_str());
+            if (mode < 0) {
+                return fail("unknown blend mode '" + value + "'");
+            }
+            instance.blend = mode;
+            continue;
+        }
+        if (key == "opacity") {
+            int32_t opacity;
+            if (!parseInt(value, opacity) || opacity < 0 || opacity > 255) {
+                return fail("bad opacity '" + value + "'");
+            }
+            instance.opacity = opacity;
+            continue;
+        }
+        int index = 0;
+        const ParamField* field = ops->fields;
+        while (field->name != nullptr && key != field->name) {
+            field++;
+            index++;
+        }
+        if (field->name == nullptr) {
+            return fail(std::string(ops->name) + " has no param '" + key + "'");
+        }
+        settings[index] = value;
+    }
+    if (!hasPins || instance.numPins == 0) {
+        return fail("pattern without pins");
+    }
+
+    instance.firstValue = show.values.size();
+    int index = 0;
+    for (const ParamField* field = ops->fields; field->name != nullptr; field++, index++) {
+        const std::string& setting = settings[index];
+        if (field->type == PARAM_PALETTE) {
+            std::vector<ShowColor> palette;
+            for (const std::string& name : split(setting, ',')) {
+                ShowColor color;
+                if (!parseColor(name, color)) {
+                    return fail("bad color '" + name + "'");
+                }
+                palette.push_back(color);
+            }
+            show.values.push_back(addPalette(show, palette));
+            show.values.push_back(palette.size());
+            continue;
+        }
+        int32_t value = 0;
+        if (field->type == PARAM_BOOL && (setting == "true" || setting == "false")) {
+            value = setting == "true";
+        } else if (!setting.empty() && !parseInt(setting, value)) {
+            return fail("bad value '" + setting + "' for " + field->name);
+        }
+        if (field->type == PARAM_INT && (value < field->min || value > field->max)) {
+            return fail(std::string(field->name) + " must be " + std::to_string(field->min) + " to "
+                + std::to_string(field->max) + ", not " + std::to_string(value));
+        }
+        show.values.push_back(value);
+    }
+    instance.numValues = show.values.size() - instance.firstValue;
+
+    show.instances.push_back(instance);
+    show.segments.back().numInstances++;
+    return true;
+}
+
+static bool parseShow(FILE* input, ShowBuilder& show)
+{
+    char line[1024];
+    while (fgets(line, sizeof(line), input) != nullptr) {
+        lineNumber++;
+        std::string text = line;
+        for (char& c : text) {
+            if (c == '\t' || c == '\r' || c == '\n') {
+                c = ' ';
+            }
+        }
+        // A comment starts a token; colors have '#' inside one
+        for (size_t i = 0; i < text.size(); i++) {
+            if (text[i] == '#' && (i == 0 || text[i - 1] == ' ')) {
+                text.resize(i);
+            }
+        }
+        std::vector<std::string> tokens = split(text, ' ');
+        if (tokens.empty()) {
+            continue;
+        }
+
+        if (tokens[0] == "segment") {
+            int32_t seconds;
+            int32_t millis = 0;
+            int transition = TRANSITION_CUT;
+            if ((tokens.size() != 2 && tokens.size() != 4) || !parseInt(tokens[1], seconds) || seconds <= 0) {
+                return fail("expected 'segment <seconds> [<transition> <ms>]'");
+            }
+            if (tokens.size() == 4) {
+                transition = findTransition(tokens[2].c_str());
+                if (transition < 0 || !parseInt(tokens[3], millis) || millis < 0 || millis > 65535) {
+                    return fail("bad transition '" + tokens[2] + " " + tokens[3] + "'");
+                }
+            }
+            ShowSegment segment
+                = { (uint32_t)seconds, (uint16_t)show.instances.size(), 0, (uint16_t)millis, (uint8_t)transition, 0 };
+            show.segments.push_back(segment);
+        } else if (!parseInstance(tokens, show)) {
+            return false;
+        }
+    }
+    if (show.segments.empty()) {
+        return fail("no segments");
+    }
+    return true;
+}
+
+template <typename T> static void append(std::vector<uint8_t>& image, const T* records, size_t count)
+{
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(records);
+    image.insert(image.end(), bytes, bytes + count * sizeof(T));
+}
+
+static std::vector<uint8_t> encodeShow(const ShowBuilder& show)
+{
+    ShowHeader header;
+    memcpy(header.magic, SHOW_MAGIC, sizeof(header.magic));
+    header.version = SHOW_VERSION;
+    header.numSegments = show.segments.size();
+    header.numInstances = show.instances.size();
+    header.numPins = show.pins.size();
+    header.numValues = show.values.size();
+    header.numColors = show.colors.size();
+
+    std::vector<uint8_t> image(sizeof(ShowHeader));
+    append(image, show.segments.data(), show.segments.size());
+    append(image, show.instances.data(), show.instances.size());
+    append(image, show.values.data(), show.values.size());
+    append(image, show.colors.data(), show.colors.size());
+    append(image, show.pins.data(), show.pins.size());
+
+    header.totalBytes = image.size();
+    header.checksum = showChecksum(image.data() + sizeof(ShowHeader), image.size() - sizeof(ShowHeader));
+    memcpy(image.data(), &header, sizeof(header));
+    return image;
+}
+
+int main(int argc, char** argv)
+{
+    sourceName = argc > 1 ? argv[1] : "data/show.txt";
+    const char* outputName = argc > 2 ? argv[2] : "data/show.bin";
+
+    FILE* input = fopen(sourceName.c_str(), "r");
+    if (input == nullptr) {
+        fprintf(stderr, "cannot open %s\n", sourceName.c_str());
+        return 1;
+    }
+    ShowBuilder show;
+    bool parsed = parseShow(input, show);
+    fclose(input);
+    if (!parsed) {
+        return 1;
+    }
+    std::vector<uint8_t> image = encodeShow(show);
+
+    // Load it back as the firmware would
+    size_t memoryBytes = showMemoryBytes(image.data(), image.size());
+    std::vector<uint8_t> memory(memoryBytes);
+    auto begin = std::chrono::steady_clock::now();
+    Program* program = loadShow(image.data(), image.size(), memory.data(), memory.size());
+    auto elapsed = std::chrono::steady_clock::now() - begin;
+    if (program == nullptr || !program->allocateState()) {
+        fprintf(stderr, "image does not load\n");
+        return 1;
+    }
+
+    FILE* output = fopen(outputName, "wb");
+    if (output == nullptr || fwrite(image.data(), 1, image.size(), output) != image.size()) {
+        fprintf(stderr, "cannot write %s\n", outputName);
+        return 1;
+    }
+    fclose(output);
+
+    printf("%s: %zu segments, %zu instances, %zu colors\n", outputName, show.segments.size(), show.instances.size(),
+        show.colors.size());
+    printf("image bytes: %zu  program bytes: %zu  arena bytes: %zu  load us: %.1f\n", image.size(), memoryBytes,
+        program->getArenaBytes(), std::chrono::duration<double, std::micro>(elapsed).count());
+    program->~Program();
+    return 0;
+}
@@ -0,0 +1,190 @@
+// Headless simulator for whole shows. The Program is driven by a
+// FrameScheduler on the shim's virtual clock, exactly as loop() drives it
+// without the render pipeline, but no frame ever waits, so hours of show time
+// play in seconds.
+//
+//   sim_host [--hours H | --seconds S] [--fps F] [--seed N] [--max-drift MS] [--boundaries] [show.bin]
+//
+// Without show.bin the built-in show plays. The report has, per segment, how
+// many times it started, its frames, the frames that rendered something, and
+// the mean and max host time of update() with the share of the frame budget
+// it took. Segment boundaries are checked against the segment durations: a
+// segment ends on the first frame at or past its duration, so every boundary
+// is noticed up to a frame late, but the next segment starts at the nominal
+// boundary all the same. The drift is how far a segment's start has moved
+// from the nominal timeline; the run fails if it ever exceeds --max-drift,
+// one frame by default. --boundaries lists every boundary.
+
+#include "output.h"
+#include "program.h"
+#include "scheduler.h"
+#include "show.h"
+#include "show_loader.h"
+#include <chrono>
+#include <string>
+#include <vector>
+
+#define DEFAULT_FPS 60
+#define DEFAULT_SECONDS 3600
+#define SHOW_IMAGE_BYTES 4096
+
+static CRGB renderBuffer[TOTAL_LEDS];
+static CRGB outputBuffer[TOTAL_LEDS];
+CRGB* leds = renderBuffer;
+
+struct SegmentStats {
+    unsigned long starts;
+    unsigned long frames;
+    unsigned long rendered;
+    double totalNs;
+    long maxNs;
+};
+
+static void usage()
+{
+    fprintf(stderr,
+        "usage: sim_host [--hours H | --seconds S] [--fps F] [--seed N] [--max-drift MS] [--boundaries] [show.bin]\n");
+}
+
+int main(int argc, char** argv)
+{
+    double seconds = DEFAULT_SECONDS;
+    int fps = DEFAULT_FPS;
+    uint32_t seed = 0;
+    long maxDriftMillis = -1;
+    bool listBoundaries = false;
+    const char* showPath = nullptr;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--hours" && hasValue) {
+            seconds = atof(argv[++i]) * 3600;
+        } else if (arg == "--seconds" && hasValue) {
+            seconds = atof(argv[++i]);
+        } else if (arg == "--fps" && hasValue) {
+            fps = atoi(argv[++i]);
+        } else if (arg == "--seed" && hasValue) {
+            seed = strtoul(argv[++i], nullptr, 0);
+        } else if (arg == "--max-drift" && hasValue) {
+            maxDriftMillis = atol(argv[++i]);
+        } else if (arg == "--boundaries") {
+            listBoundaries = true;
+        } else if (arg[0] != '-') {
+            showPath = argv[i];
+        } else {
+            usage();
+            return 1;
+        }
+    }
+    if (seconds <= 0 || fps <= 0) {
+        usage();
+        return 1;
+    }
+    if (maxDriftMillis < 0) {
+        maxDriftMillis = (1000 + fps - 1) / fps;
+    }
+
+    static uint8_t image[SHOW_IMAGE_BYTES];
+    std::vector<uint8_t> memory;
+    Program* program;
+    if (showPath != nullptr) {
+        size_t size;
+        if (!readShowFile(showPath, image, sizeof(image), &size)) {
+            fprintf(stderr, "cannot read %s\n", showPath);
+            return 1;
+        }
+        memory.resize(showMemoryBytes(image, size));
+        program = loadShow(image, size, memory.data(), memory.size());
+        if (program == nullptr) {
+            fprintf(stderr, "%s is not a valid show\n", showPath);
+            return 1;
+        }
+    } else {
+        program = buildMainProgram();
+    }
+
+    int numSegments = program->getNumSegments();
+    unsigned long passMillis = program->getDurationMillis();
+    printf("show: %s, %d segments, %.1f s per pass, %d fps\n", showPath ? showPath : "built-in", numSegments,
+        passMillis / 1000.0, fps);
+
+    setOutputFrame(outputBuffer);
+    hostSetMillis(0);
+    FrameScheduler scheduler(fps);
+    program->setSeed(seed);
+    program->start(millis());
+
+    std::vector<SegmentStats> stats(numSegments, SegmentStats { 1, 0, 0, 0, 0 });
+    unsigned long frames = (unsigned long)(seconds * fps);
+    unsigned long boundaries = 0;
+    unsigned long nominalMillis = 0;
+    unsigned long segmentStart = 0;
+    long drift = 0;
+    long maxDrift = 0;
+    long maxLate = 0;
+
+    auto begin = std::chrono::steady_clock::now();
+    for (unsigned long frame = 0; frame < frames; frame++) {
+        FrameTime time = scheduler.beginFrame();
+        int segment = program->getCurrentSegment();
+        unsigned long presented = program->getFramesPresented();
+
+        auto frameBegin = std::chrono::steady_clock::now();
+        program->update(time);
+        long ns = std::chrono::nanoseconds(std::chrono::steady_clock::now() - frameBegin).count();
+        scheduler.endFrame();
+        program->prepareNext();
+
+        SegmentStats& s = stats[segment];
+        s.frames++;
+        s.rendered += program->getFramesPresented() != presented;
+        s.totalNs += ns;
+        s.maxNs = max(s.maxNs, ns);
+
+        int next = program->getCurrentSegment();
+        if (next != segment) {
+            // How late the boundary was noticed, and how far the next
+            // segment's start is from the nominal timeline
+            unsigned long duration = program->getSegmentDurationMillis(segment);
+            nominalMillis += duration;
+            maxLate = max(maxLate, (long)(time.now - segmentStart - duration));
+            segmentStart = program->getSegmentStart();
+            drift = (long)segmentStart - (long)nominalMillis;
+            maxDrift = max(maxDrift, drift < 0 ? -drift : drift);
+            boundaries++;
+            stats[next].starts++;
+            if (listBoundaries) {
+                printf("%10.3f s  segment %d -> %d  drift %ld ms\n", time.now / 1000.0, segment, next, drift);
+            }
+        }
+    }
+    double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    program->stop();
+
+    double simulated = (double)frames / fps;
+    printf("simulated %.1f s (%lu frames, %.1f passes) in %.2f s: %.0fx real time\n", simulated, frames,
+        simulated * 1000 / passMillis, wallSeconds, simulated / wallSeconds);
+    printf("%-8s %8s %10s %10s %10s %10s %8s\n", "segment", "starts", "frames", "rendered", "mean us", "max us",
+        "budget");
+    double budgetNs = 1e9 / fps;
+    for (int i = 0; i < numSegments; i++) {
+        const SegmentStats& s = stats[i];
+        double meanNs = s.frames ? s.totalNs / s.frames : 0;
+        printf("%-8d %8lu %10lu %10lu %10.2f %10.2f %7.2f%%\n", i, s.starts, s.frames, s.rendered, meanNs / 1000,
+            s.maxNs / 1000.0, 100 * meanNs / budgetNs);
+    }
+    printf("boundaries: %lu, latest noticed %ld ms after its segment's end, drift at the last %ld ms, at most %ld "
+           "ms\n",
+        boundaries, maxLate, drift, maxDrift);
+    bool drifted = maxDrift > maxDriftMillis;
+    if (drifted) {
+        printf("FAIL: drift over %ld ms\n", maxDriftMillis);
+    }
+
+    if (showPath != nullptr) {
+        program->~Program();
+    } else {
+        delete program;
+    }
+    return drifted ? 1 : 0;
+}
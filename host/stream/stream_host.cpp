@@ -0,0 +1,226 @@
+// Loopback test of the stream pattern. A sender thread sends E1.31 frames
+// to 127.0.0.1 while the main thread plays them through a Program on all
+// pins, and every composed frame is checked for pixels from another frame.
+//
+// Every pixel carries its frame's sequence number in red, its pin in green
+// and its universe in blue, so a torn frame shows up as mixed reds. The
+// sender also misbehaves on a schedule: some frames lose a universe, which
+// must not be shown, some are followed by a stale packet of garbage, which
+// must be dropped, and some go out in reverse universe order. Latency is
+// from the sender starting a frame to the receiver completing it.
+
+#include "output.h"
+#include "patterns.h"
+#include "program.h"
+#include "scheduler.h"
+#include "stream_input.h"
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+#define TEST_PORT 15568
+#define FIRST_UNIVERSE 1
+#define SEND_FPS 40
+#define SEND_SECONDS 3
+#define RENDER_FPS 120
+// Faults, every so many frames
+#define LOSE_UNIVERSE_EVERY 37
+#define STALE_PACKET_EVERY 53
+#define REVERSE_ORDER_EVERY 41
+#define GARBAGE 0xEE
+
+static CRGB renderBuffer[TOTAL_LEDS];
+static CRGB outputBuffer[TOTAL_LEDS];
+CRGB* leds = renderBuffer;
+
+static std::atomic<bool> sending;
+static unsigned long sendMicros[256];
+static unsigned long framesSent = 0;
+static unsigned long universesLost = 0;
+static unsigned long stalePackets = 0;
+
+static unsigned long nowMicros()
+{
+    static const auto epoch = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+static void put16(uint8_t* at, uint16_t value)
+{
+    at[0] = value >> 8;
+    at[1] = value & 0xFF;
+}
+
+static void put32(uint8_t* at, uint32_t value)
+{
+    put16(at, value >> 16);
+    put16(at + 2, value & 0xFFFF);
+}
+
+// One E1.31 data packet for a universe, every pixel set to color
+static int buildPacket(uint8_t* packet, uint16_t universe, uint8_t sequence, int pixels, CRGB color)
+{
+    static const char identifier[12] = { 'A', 'S', 'C', '-', 'E', '1', '.', '1', '7', 0, 0, 0 };
+    int channels = pixels * 3;
+    int length = E131_HEADER_BYTES + channels;
+    memset(packet, 0, E131_HEADER_BYTES);
+    put16(packet, 0x0010);
+    memcpy(packet + 4, identifier, sizeof(identifier));
+    put16(packet + 16, 0x7000 | (length - 16));
+    put32(packet + 18, 0x00000004);
+    put16(packet + 38, 0x7000 | (length - 38));
+    put32(packet + 40, 0x00000002);
+    strcpy(reinterpret_cast<char*>(packet + 44), "stream_host");
+    packet[108] = 100;
+    packet[111] = sequence;
+    put16(packet + 113, universe);
+    put16(packet + 115, 0x7000 | (length - 115));
+    packet[117] = 0x02;
+    packet[118] = 0xA1;
+    put16(packet + 121, 1);
+    put16(packet + 123, channels + 1);
+    for (int i = 0; i < pixels; i++) {
+        memcpy(packet + E131_HEADER_BYTES + 3 * i, color.raw, 3);
+    }
+    return length;
+}
+
+static void sendFrames()
+{
+    int sender = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(TEST_PORT);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    uint8_t packet[E131_HEADER_BYTES + E131_MAX_CHANNELS];
+    int universes = NUM_PINS * STREAM_UNIVERSES_PER_PIN;
+    unsigned long frameMicros = 1000000 / SEND_FPS;
+    unsigned long next = nowMicros();
+    for (unsigned long f = 0; f < SEND_FPS * SEND_SECONDS; f++) {
+        uint8_t sequence = f & 0xFF;
+        sendMicros[sequence] = nowMicros();
+        for (int i = 0; i < universes; i++) {
+            int slot = f % REVERSE_ORDER_EVERY == 0 ? universes - 1 - i : i;
+            int pin = slot / STREAM_UNIVERSES_PER_PIN;
+            if (slot % STREAM_UNIVERSES_PER_PIN >= pinUniverses(pin)) {
+                continue;
+            }
+            if (f % LOSE_UNIVERSE_EVERY == 0 && slot == universes / 2) {
+                universesLost++;
+                continue;
+            }
+            int first = (slot % STREAM_UNIVERSES_PER_PIN) * STREAM_PIXELS_PER_UNIVERSE;
+            int pixels = min(STREAM_PIXELS_PER_UNIVERSE, pinLeds(pin) - first);
+            int length = buildPacket(packet, FIRST_UNIVERSE + slot, sequence, pixels, CRGB(sequence, pin, slot));
+            sendto(sender, packet, length, 0, reinterpret_cast<struct sockaddr*>(&address), sizeof(address));
+        }
+        if (f % STALE_PACKET_EVERY == 0 && f >= 5) {
+            int length = buildPacket(packet, FIRST_UNIVERSE, sequence - 5, STREAM_PIXELS_PER_UNIVERSE,
+                CRGB(GARBAGE, GARBAGE, GARBAGE));
+            sendto(sender, packet, length, 0, reinterpret_cast<struct sockaddr*>(&address), sizeof(address));
+            stalePackets++;
+        }
+        framesSent++;
+
+        next += frameMicros;
+        while (nowMicros() < next) {
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+    }
+    close(sender);
+    sending.store(false);
+}
+
+// Every pixel of the composed frame must be from one frame and in place
+static bool frameIsWhole(const CRGB* frame)
+{
+    uint8_t sequence = frame[0].r;
+    for (int pin = 0; pin < NUM_PINS; pin++) {
+        for (int i = 0; i < pinLeds(pin); i++) {
+            const CRGB& pixel = frame[pinOffset(pin) + i];
+            int slot = pin * STREAM_UNIVERSES_PER_PIN + i / STREAM_PIXELS_PER_UNIVERSE;
+            if (pixel.r != sequence || pixel.g != pin || pixel.b != slot) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+int main()
+{
+    if (!beginStreamInput(TEST_PORT)) {
+        fprintf(stderr, "cannot listen on port %d\n", TEST_PORT);
+        return 1;
+    }
+
+    static int allPins[NUM_PINS];
+    for (int pin = 0; pin < NUM_PINS; pin++) {
+        allPins[pin] = pin;
+    }
+    StreamParams streamParams;
+    streamParams.universe = FIRST_UNIVERSE;
+    Program program(1);
+    program.addSegment(0, new Segment(allPins, NUM_PINS, 3600, streamParams));
+    setOutputFrame(outputBuffer);
+
+    hostUseRealClock(true);
+    FrameScheduler scheduler(RENDER_FPS);
+    program.start(millis());
+
+    sending.store(true);
+    std::thread sender(sendFrames);
+
+    unsigned long presented = 0;
+    unsigned long torn = 0;
+    unsigned long endToEnd = 0;
+    unsigned long maxEndToEnd = 0;
+    unsigned long drainUntil = 0;
+    while (sending.load() || nowMicros() < drainUntil) {
+        if (sending.load()) {
+            drainUntil = nowMicros() + 100000;
+        }
+        unsigned long before = getStreamCounters().frames;
+        FrameTime time = scheduler.beginFrame();
+        program.update(time);
+        scheduler.endFrame();
+
+        if (getStreamCounters().frames != before) {
+            unsigned long latency = nowMicros() - sendMicros[getStreamCounters().lastSequence];
+            endToEnd += latency;
+            maxEndToEnd = max(maxEndToEnd, latency);
+            presented++;
+            if (!frameIsWhole(outputBuffer)) {
+                torn++;
+            }
+        }
+    }
+    sender.join();
+    endStreamInput();
+
+    const StreamCounters& counters = getStreamCounters();
+    int universes = 0;
+    for (int pin = 0; pin < NUM_PINS; pin++) {
+        universes += pinUniverses(pin);
+    }
+    printf("geometry: %d pins, %d LEDs, %d universes\n", NUM_PINS, TOTAL_LEDS, universes);
+    printf("sent: %lu frames, %lu universes held back, %lu stale packets\n", framesSent, universesLost,
+        stalePackets);
+    printf("received: %lu packets, %lu frames, %lu incomplete, %lu dropped, %lu lost\n", counters.packets,
+        counters.frames, counters.incompleteFrames, counters.dropped, counters.lost);
+    printf("assembly us: mean %.0f max %lu   end to end us: mean %.0f max %lu\n",
+        counters.frames ? (double)counters.latencyMicros / counters.frames : 0.0, counters.maxLatencyMicros,
+        presented ? (double)endToEnd / presented : 0.0, maxEndToEnd);
+    printf("torn frames shown: %lu\n", torn);
+
+    bool passed = torn == 0 && counters.frames > 0 && counters.dropped >= stalePackets
+        && counters.frames + counters.incompleteFrames <= framesSent;
+    puts(passed ? "PASS" : "FAIL");
+    return passed ? 0 : 1;
+}
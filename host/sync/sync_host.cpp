@@ -0,0 +1,281 @@
+// Loopback test of frame sync (src/sync.h). A leader and followers each run
+// as a process of their own, playing the built-in show on the real clock at
+// 60 fps, with the leader's beacons broadcast on 127.255.255.255. Every
+// board has a clock of its own: followers boot one after another and their
+// clocks drift by the given ppm, alternately fast and slow.
+//
+//   sync_host [--followers N] [--seconds S] [--drift PPM] [--free]
+//
+// Each board notes the steady clock as it presents every frame. After the
+// run, each follower frame from its first lock on is paired with the
+// leader's frame of the same number, and the difference of their present
+// times is the skew that goes into the histogram. Pairs whose frame time or
+// segment differ are counted as mismatched. --free runs the followers
+// without sync, for comparison; their frame numbers then count from their
+// own boot.
+
+#include "output.h"
+#include "program.h"
+#include "scheduler.h"
+#include "show.h"
+#include "sync.h"
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#define TEST_PORT 15570
+#define TEST_ADDRESS "127.255.255.255"
+#define TEST_FPS 60
+#define DEFAULT_FOLLOWERS 3
+#define DEFAULT_SECONDS 20
+#define DEFAULT_DRIFT_PPM 100
+// Followers boot this far apart, after the leader
+#define BOOT_SPACING_MS 170
+#define MAX_BOARDS 9
+
+static CRGB renderBuffer[TOTAL_LEDS];
+static CRGB outputBuffer[TOTAL_LEDS];
+CRGB* leds = renderBuffer;
+
+struct FrameRecord {
+    uint32_t frame;
+    uint32_t now;
+    uint8_t segment;
+    bool locked;
+    int64_t presentNanos;
+};
+
+// Written by each board into memory shared with the parent
+struct BoardReport {
+    unsigned long frames;
+    SyncCounters sync;
+    bool failed;
+};
+
+struct Options {
+    int followers;
+    double seconds;
+    long driftPpm;
+    bool free;
+};
+
+static int64_t steadyNanos()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+static unsigned long bootMillis(int board) { return board * BOOT_SPACING_MS; }
+
+static long boardDrift(int board, const Options& options)
+{
+    if (board == 0) {
+        return 0;
+    }
+    return board % 2 ? options.driftPpm : -options.driftPpm;
+}
+
+// The leader plays on until the last follower is done
+static unsigned long boardFrames(int board, const Options& options)
+{
+    double seconds = options.seconds;
+    if (board == 0) {
+        seconds += bootMillis(options.followers) / 1000.0 + 1;
+    }
+    return (unsigned long)(seconds * TEST_FPS);
+}
+
+static void runBoard(int board, const Options& options, FrameRecord* records, BoardReport* report)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(bootMillis(board)));
+    hostUseRealClock(true);
+    hostSetClockDrift(boardDrift(board, options));
+
+    int role = board == 0 ? SYNC_LEADER : options.free ? SYNC_OFF : SYNC_FOLLOWER;
+    if (!beginSync(role, TEST_PORT, TEST_ADDRESS)) {
+        report->failed = true;
+        return;
+    }
+    setOutputFrame(outputBuffer);
+    Program* program = buildMainProgram();
+    FrameScheduler scheduler(TEST_FPS);
+    program->start(millis());
+
+    unsigned long frames = boardFrames(board, options);
+    for (unsigned long i = 0; i < frames; i++) {
+        syncBeforeFrame(scheduler, *program);
+        FrameTime time = scheduler.beginFrame();
+        program->update(time);
+
+        FrameRecord& record = records[i];
+        record.presentNanos = steadyNanos();
+        record.frame = time.frame;
+        record.now = time.now;
+        record.segment = program->getCurrentSegment();
+        record.locked = role != SYNC_FOLLOWER || getSyncCounters().steps > 0;
+
+        syncAfterFrame(scheduler, *program, time);
+        scheduler.endFrame();
+        program->prepareNext();
+    }
+    report->frames = frames;
+    report->sync = getSyncCounters();
+    endSync();
+    program->stop();
+    delete program;
+}
+
+static void usage() { fprintf(stderr, "usage: sync_host [--followers N] [--seconds S] [--drift PPM] [--free]\n"); }
+
+static long percentile(std::vector<long>& values, double fraction)
+{
+    if (values.empty()) {
+        return 0;
+    }
+    size_t at = std::min(values.size() - 1, (size_t)(fraction * values.size()));
+    std::nth_element(values.begin(), values.begin() + at, values.end());
+    return values[at];
+}
+
+int main(int argc, char** argv)
+{
+    Options options = { DEFAULT_FOLLOWERS, DEFAULT_SECONDS, DEFAULT_DRIFT_PPM, false };
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--followers" && hasValue) {
+            options.followers = atoi(argv[++i]);
+        } else if (arg == "--seconds" && hasValue) {
+            options.seconds = atof(argv[++i]);
+        } else if (arg == "--drift" && hasValue) {
+            options.driftPpm = atol(argv[++i]);
+        } else if (arg == "--free") {
+            options.free = true;
+        } else {
+            usage();
+            return 1;
+        }
+    }
+    if (options.followers < 1 || options.followers >= MAX_BOARDS || options.seconds <= 0) {
+        usage();
+        return 1;
+    }
+
+    int boards = options.followers + 1;
+    size_t capacity = boardFrames(0, options);
+    size_t bytes = boards * (sizeof(BoardReport) + capacity * sizeof(FrameRecord));
+    void* shared = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shared == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+    BoardReport* reports = static_cast<BoardReport*>(shared);
+    FrameRecord* records = reinterpret_cast<FrameRecord*>(reports + boards);
+
+    printf("leader + %d followers, %.0f s at %d fps, drift +-%ld ppm, %s\n", options.followers, options.seconds,
+        TEST_FPS, options.driftPpm, options.free ? "free running" : "synced");
+    fflush(stdout);
+    std::vector<pid_t> children;
+    for (int board = 0; board < boards; board++) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            runBoard(board, options, records + board * capacity, reports + board);
+            _exit(reports[board].failed ? 1 : 0);
+        }
+        children.push_back(pid);
+    }
+    bool failed = false;
+    for (pid_t pid : children) {
+        int status;
+        waitpid(pid, &status, 0);
+        failed |= !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+    }
+    if (failed) {
+        fprintf(stderr, "a board failed to start\n");
+        return 1;
+    }
+
+    // The leader's records by frame number
+    const BoardReport& leader = reports[0];
+    std::vector<const FrameRecord*> leaderFrames;
+    for (unsigned long i = 0; i < leader.frames; i++) {
+        const FrameRecord& record = records[i];
+        if (record.frame >= leaderFrames.size()) {
+            leaderFrames.resize(record.frame + 1, nullptr);
+        }
+        leaderFrames[record.frame] = &record;
+    }
+
+    static const long bucketEdges[] = { 100, 250, 500, 1000, 2000, 4000, 8333, 16667 };
+    const int numBuckets = sizeof(bucketEdges) / sizeof(bucketEdges[0]) + 1;
+    unsigned long histogram[numBuckets] = {};
+    std::vector<long> allSkews;
+    for (int board = 1; board < boards; board++) {
+        const BoardReport& report = reports[board];
+        const FrameRecord* follower = records + board * capacity;
+        std::vector<long> skews;
+        unsigned long mismatched = 0;
+        long lockedAt = -1;
+        for (unsigned long i = 0; i < report.frames; i++) {
+            const FrameRecord& record = follower[i];
+            if (!record.locked) {
+                continue;
+            }
+            if (lockedAt < 0) {
+                lockedAt = i;
+            }
+            if (record.frame >= leaderFrames.size() || leaderFrames[record.frame] == nullptr) {
+                continue;
+            }
+            const FrameRecord& match = *leaderFrames[record.frame];
+            long skew = (record.presentNanos - match.presentNanos) / 1000;
+            skews.push_back(skew);
+            mismatched += record.now != match.now || record.segment != match.segment;
+
+            long magnitude = skew < 0 ? -skew : skew;
+            int bucket = 0;
+            while (bucket < numBuckets - 1 && magnitude >= bucketEdges[bucket]) {
+                bucket++;
+            }
+            histogram[bucket]++;
+            allSkews.push_back(magnitude);
+        }
+
+        unsigned long compared = skews.size();
+        long low = compared ? *std::min_element(skews.begin(), skews.end()) : 0;
+        long high = compared ? *std::max_element(skews.begin(), skews.end()) : 0;
+        long median = percentile(skews, 0.5);
+        printf("follower %d: boot +%lu ms, drift %+ld ppm, first locked frame %ld, %lu frames compared, %lu "
+               "mismatched, skew us min %ld p50 %ld max %ld\n",
+            board, bootMillis(board), boardDrift(board, options), lockedAt, compared, mismatched, low, median, high);
+        if (!options.free) {
+            const SyncCounters& sync = report.sync;
+            printf("  beacons %lu, lost %lu, steps %lu, joins %lu, last error %ld us, max error %ld us\n",
+                sync.beacons, sync.lost, sync.steps, sync.joins, sync.lastErrorMicros, sync.maxErrorMicros);
+        }
+    }
+
+    unsigned long total = allSkews.size();
+    printf("\n|skew| of follower frames against the leader's, %lu frames\n", total);
+    for (int bucket = 0; bucket < numBuckets; bucket++) {
+        char label[32];
+        if (bucket < numBuckets - 1) {
+            snprintf(label, sizeof(label), "< %ld us", bucketEdges[bucket]);
+        } else {
+            snprintf(label, sizeof(label), ">= %ld us", bucketEdges[bucket - 1]);
+        }
+        double share = total ? 100.0 * histogram[bucket] / total : 0;
+        printf("%12s %8lu %6.2f%% %s\n", label, histogram[bucket], share, std::string((int)(share / 2), '#').c_str());
+    }
+    printf("p50 %ld us, p99 %ld us, max %ld us\n", percentile(allSkews, 0.5), percentile(allSkews, 0.99),
+        percentile(allSkews, 1.0));
+
+    munmap(shared, bytes);
+    return 0;
+}
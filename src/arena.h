@@ -0,0 +1,74 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Pattern state blocks start on a cache line so instances never share one
+#ifdef ARDUINO_ARCH_ESP32
+#define STATE_ALIGNMENT 32
+#else
+#define STATE_ALIGNMENT 64
+#endif
+
+inline size_t alignUp(size_t value, size_t alignment) { return (value + alignment - 1) & ~(alignment - 1); }
+
+// Lays typed arrays out back to back inside a pattern's state block. Built on
+// a null block it only measures, which is how the state size is computed
+// with the same code that later carves the real block.
+class StateLayout {
+private:
+    uint8_t* base;
+    size_t offset;
+
+public:
+    StateLayout(void* block)
+        : base(static_cast<uint8_t*>(block))
+        , offset(0)
+    {
+    }
+
+    template <typename T> T* take(size_t count)
+    {
+        offset = alignUp(offset, alignof(T));
+        T* array = base ? reinterpret_cast<T*>(base + offset) : nullptr;
+        offset += sizeof(T) * count;
+        return array;
+    }
+
+    size_t size() { return offset; }
+};
+
+// One block of memory for all pattern state of a Program, allocated once
+// before playback. Blocks are handed out by offset so the same arena can be
+// laid out again for every segment.
+class StateArena {
+private:
+    uint8_t* allocation;
+    uint8_t* memory;
+    size_t capacity;
+
+public:
+    StateArena()
+        : allocation(nullptr)
+        , memory(nullptr)
+        , capacity(0)
+    {
+    }
+
+    ~StateArena() { delete[] allocation; }
+
+    bool allocate(size_t bytes)
+    {
+        delete[] allocation;
+        allocation = new uint8_t[bytes + STATE_ALIGNMENT];
+        memory = reinterpret_cast<uint8_t*>(alignUp(reinterpret_cast<uintptr_t>(allocation), STATE_ALIGNMENT));
+        capacity = bytes;
+        return allocation != nullptr;
+    }
+
+    uint8_t* at(size_t offset) { return memory + offset; }
+    size_t getCapacity() { return capacity; }
+};
+
+#endif
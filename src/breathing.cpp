@@ -1,92 +1,104 @@
 #include "patterns.h"
 #include <Arduino.h>
 
-static unsigned long lastUpdate = 0;
-static float brightness = 0.0;
-static bool increasing = true;
-static unsigned long colorTransitionTime = 0;
-static float colorProgress = 0.0;
+// Palette progress per second when cycling through a multi-color palette
+#define COLOR_PROGRESS_PER_SECOND 0.2f
 
-void breathingPattern(int pins[], int numPins, int speed, CRGB palette[], int paletteSize, bool reverse)
+// One envelope per instance, shared by all of its pins
+struct BreathingState {
+    float stepAccumulator;
+    float brightness;
+    bool increasing;
+    float colorProgress;
+};
+
+size_t BreathingPattern::stateSize(int numPins) { return sizeof(BreathingState); }
+
+bool BreathingPattern::render(const FrameTime& time, void* state, int pins[], int numPins, const BreathingParams& params, bool reverse)
 {
+    int speed = params.speed;
+    CRGB* palette = params.palette;
+    int paletteSize = params.paletteSize;
+
     if (speed == 0 || paletteSize == 0)
-        return;
+        return false;
 
-    unsigned long currentTime = millis();
-    unsigned long interval = map(speed, 1, 100, 100, 5);
+    BreathingState* s = static_cast<BreathingState*>(state);
+
+    // Smooth color transitions through palette
+    s->colorProgress += COLOR_PROGRESS_PER_SECOND * time.dt;
+    while (s->colorProgress >= paletteSize) {
+        s->colorProgress -= paletteSize;
+    }
 
-    if (currentTime - lastUpdate >= interval) {
-        lastUpdate = currentTime;
+    int steps = takeSteps(s->stepAccumulator, stepsPerSecond(map(speed, 1, 100, 100, 5)), time.dt);
+    if (steps == 0)
+        return false;
 
-        // Update breathing brightness
-        if (increasing) {
-            brightness += 1.0;
-            if (brightness >= 255.0) {
-                brightness = 255.0;
-                increasing = false;
+    // Update breathing brightness, one level per step
+    for (int step = 0; step < steps; step++) {
+        if (s->increasing) {
+            s->brightness += 1.0;
+            if (s->brightness >= 255.0) {
+                s->brightness = 255.0;
+                s->increasing = false;
             }
         } else {
-            brightness -= 1.0;
-            if (brightness <= 0.0) {
-                brightness = 0.0;
-                increasing = true;
+            s->brightness -= 1.0;
+            if (s->brightness <= 0.0) {
+                s->brightness = 0.0;
+                s->increasing = true;
             }
         }
+    }
 
-        // Update color transition for multi-color palettes
-        CRGB currentColor;
-        if (paletteSize == 1) {
-            currentColor = palette[0];
-        } else {
-            // Smooth color transitions through palette
-            unsigned long colorInterval = 50; // Color transition speed
-            if (currentTime - colorTransitionTime >= colorInterval) {
-                colorTransitionTime = currentTime;
-                colorProgress += 0.01; // Increment color progress
-                
-                if (colorProgress >= paletteSize) {
-                    colorProgress = 0.0;
-                }
-            }
-            
-            // Calculate current color by blending between palette colors
-            int colorIndex1 = (int)colorProgress % paletteSize;
-            int colorIndex2 = (colorIndex1 + 1) % paletteSize;
-            float blendAmount = colorProgress - (int)colorProgress;
-            
-            // Use FastLED's lerp8 for smooth blending
-            currentColor = palette[colorIndex1].lerp8(palette[colorIndex2], (uint8_t)(blendAmount * 255));
-        }
+    // Update color transition for multi-color palettes
+    CRGB currentColor;
+    if (paletteSize == 1) {
+        currentColor = palette[0];
+    } else {
+        // Calculate current color by blending between palette colors
+        int colorIndex1 = (int)s->colorProgress % paletteSize;
+        int colorIndex2 = (colorIndex1 + 1) % paletteSize;
+        float blendAmount = s->colorProgress - (int)s->colorProgress;
 
-        // Apply breathing brightness to the current color
-        CRGB scaledColor = currentColor;
-        scaledColor.nscale8((uint8_t)brightness);
-
-        for (int p = 0; p < numPins; p++) {
-            int pin = pins[p];
-            int startIndex = pin * NUM_LEDS_PER_STRIP * NUM_STRIPS_PER_PIN;
-            int endIndex = startIndex + (NUM_LEDS_PER_STRIP * NUM_STRIPS_PER_PIN);
-
-            if (reverse) {
-                for (int i = endIndex - 1; i >= startIndex; i--) {
-                    leds[i] = scaledColor;
-                }
-            } else {
-                for (int i = startIndex; i < endIndex; i++) {
-                    leds[i] = scaledColor;
-                }
-            }
-        }
+        // Use FastLED's lerp8 for smooth blending
+        currentColor = palette[colorIndex1].lerp8(palette[colorIndex2], (uint8_t)(blendAmount * 255));
+    }
+
+    // Apply breathing brightness to the current color
+    CRGB scaledColor = currentColor;
+    scaledColor.nscale8((uint8_t)s->brightness);
 
-        FastLED.show();
+    for (int p = 0; p < numPins; p++) {
+        int pin = pins[p];
+        int startIndex = pinOffset(pin);
+        int endIndex = startIndex + pinLeds(pin);
+        markPinDirty(pin);
+
+        for (int i = startIndex; i < endIndex; i++) {
+            leds[i] = scaledColor;
+        }
     }
+
+    return true;
 }
 
-void resetBreathingPattern()
+void BreathingPattern::reset(void* state, int numPins)
 {
-    lastUpdate = 0;
-    brightness = 0.0;
-    increasing = true;
-    colorTransitionTime = 0;
-    colorProgress = 0.0;
-}
\ No newline at end of file
+    BreathingState* s = static_cast<BreathingState*>(state);
+
+    // Start with one step due so the first frame of a segment renders
+    s->stepAccumulator = 1.0;
+    s->brightness = 0.0;
+    s->increasing = true;
+    s->colorProgress = 0.0;
+}
+
+const ParamField BreathingPattern::fields[] = {
+    PARAM_INT_FIELD(BreathingParams, speed, 0, PARAM_MAX_SPEED),
+    PARAM_PALETTE_FIELD(BreathingParams, palette, paletteSize),
+    PARAM_FIELDS_END,
+};
+
+template struct PatternBase<BreathingPattern, BreathingParams>;
@@ -0,0 +1,172 @@
+#include "output.h"
+#include "patterns.h"
+#include <Arduino.h>
+
+// Per pin slot of the instance, plus the time the instance first rendered.
+// Each pin slot's pixels are kept in a ring of the pin's length: LED i shows
+// ring[(head + i) % length]. A chase step moves the head back one place and
+// writes the new first pixel there. In the frame composeFrame() reads, the
+// pin in leds[] is the ring itself, left rotated by the head, so a step
+// writes one pixel there too whatever the pin's length. In a side frame the
+// pin is written out in order from the ring.
+struct ChaseState {
+    unsigned long* patternStartTime;
+    bool* patternInitialized;
+    // The frame the pins were last written into, and whether as rings
+    CRGB** frame;
+    bool* rotated;
+    float* stepAccumulator;
+    float* colorTransitionProgress;
+    uint16_t* head;
+    uint16_t* runLeft; // steps left in the current lit run or gap
+    uint8_t* currentColorIndex;
+    bool* lit;
+    CRGB* ring;
+};
+
+static ChaseState layoutChaseState(void* block, int numPins, size_t* size = nullptr)
+{
+    StateLayout layout(block);
+    ChaseState state;
+    state.patternStartTime = layout.take<unsigned long>(1);
+    state.patternInitialized = layout.take<bool>(1);
+    state.frame = layout.take<CRGB*>(1);
+    state.rotated = layout.take<bool>(1);
+    state.stepAccumulator = layout.take<float>(numPins);
+    state.colorTransitionProgress = layout.take<float>(numPins);
+    state.head = layout.take<uint16_t>(numPins);
+    state.runLeft = layout.take<uint16_t>(numPins);
+    state.currentColorIndex = layout.take<uint8_t>(numPins);
+    state.lit = layout.take<bool>(numPins);
+    state.ring = layout.take<CRGB>(numPins * MAX_LEDS_PER_PIN);
+    if (size)
+        *size = layout.size();
+    return state;
+}
+
+size_t ChasePattern::stateSize(int numPins)
+{
+    size_t size;
+    layoutChaseState(nullptr, numPins, &size);
+    return size;
+}
+
+bool ChasePattern::render(const FrameTime& time, void* state, int pins[], int numPins, const ChaseParams& params, bool reverse)
+{
+    CRGB* palette = params.palette;
+    int paletteSize = params.paletteSize;
+
+    if (params.speed == 0 || paletteSize == 0) return false;
+
+    ChaseState s = layoutChaseState(state, numPins);
+    unsigned long currentTime = time.now;
+
+    // One LED further along per interval, 10 to 200 a second
+    float stepRate = stepsPerSecond(map(params.speed, 1, 100, 100, 5));
+    // Color transition advances 0.02 per interval, as in grow
+    float colorRate = 0.02f * stepsPerSecond(map(params.transitionSpeed, 1, 100, 100, 10));
+    // The head is lit for holdDelay and then dark as long, so the chase is
+    // runs of color with gaps of the same length; 0 makes it unbroken
+    int runLength = min(max((int)(params.holdDelay * stepRate / 1000), 1), 0xFFFF);
+
+    // Every pin is written out whole when the frame is not the one they
+    // were last written into, or is now a side frame or no longer is
+    bool inPlace = !renderingSideFrame();
+    bool moved = leds != *s.frame || inPlace != *s.rotated;
+    *s.frame = leds;
+    *s.rotated = inPlace;
+    bool changed = false;
+
+    if (!*s.patternInitialized) {
+        *s.patternStartTime = currentTime;
+        *s.patternInitialized = true;
+    }
+
+    for (int p = 0; p < numPins; p++) {
+        int pin = pins[p];
+        int startIndex = pinOffset(pin);
+        int totalLeds = pinLeds(pin);
+        CRGB* ring = s.ring + p * MAX_LEDS_PER_PIN;
+        CRGB* out = leds + startIndex;
+
+        // Pins waiting out their offset stay as the ring started, black
+        int steps = 0;
+        unsigned long pinOffsetDelay = (unsigned long)params.offsetDelay * p;
+        if (currentTime - *s.patternStartTime >= pinOffsetDelay) {
+            s.colorTransitionProgress[p] += colorRate * time.dt;
+            while (s.colorTransitionProgress[p] >= 1.0) {
+                s.colorTransitionProgress[p] -= 1.0;
+                s.currentColorIndex[p] = (s.currentColorIndex[p] + 1) % paletteSize;
+            }
+
+            CRGB currentColor;
+            if (paletteSize == 1) {
+                currentColor = palette[0];
+            } else {
+                int fromIndex = s.currentColorIndex[p];
+                int toIndex = (s.currentColorIndex[p] + 1) % paletteSize;
+                currentColor
+                    = palette[fromIndex].lerp8(palette[toIndex], (uint8_t)(s.colorTransitionProgress[p] * 255));
+            }
+
+            // Older steps would have run off the end already
+            steps = min(takeSteps(s.stepAccumulator[p], stepRate, time.dt), totalLeds);
+            int at = s.head[p];
+            for (int k = 0; k < steps; k++) {
+                if (s.runLeft[p] == 0) {
+                    s.lit[p] = !s.lit[p] || params.holdDelay <= 0;
+                    s.runLeft[p] = runLength;
+                }
+                s.runLeft[p]--;
+                at = at == 0 ? totalLeds - 1 : at - 1;
+                ring[at] = s.lit[p] ? currentColor : CRGB::Black;
+                if (inPlace) {
+                    out[at] = ring[at];
+                }
+            }
+            s.head[p] = at;
+        }
+
+        if (!moved && steps == 0) {
+            continue;
+        }
+        int head = s.head[p];
+        if (inPlace) {
+            // The steps are in leds[] already once the ring is
+            if (moved) {
+                memcpy(out, ring, sizeof(CRGB) * totalLeds);
+            }
+            setPinRotation(pin, head);
+        } else {
+            memcpy(out, ring + head, sizeof(CRGB) * (totalLeds - head));
+            memcpy(out + totalLeds - head, ring, sizeof(CRGB) * head);
+            setPinRotation(pin, 0);
+        }
+        markPinDirty(pin);
+        changed = true;
+    }
+
+    return changed;
+}
+
+void ChasePattern::reset(void* state, int numPins)
+{
+    memset(state, 0, stateSize(numPins));
+
+    ChaseState s = layoutChaseState(state, numPins);
+    for (int p = 0; p < numPins; p++) {
+        // One step is due on a pin's first frame
+        s.stepAccumulator[p] = 1.0;
+    }
+}
+
+const ParamField ChasePattern::fields[] = {
+    PARAM_INT_FIELD(ChaseParams, speed, 0, PARAM_MAX_SPEED),
+    PARAM_PALETTE_FIELD(ChaseParams, palette, paletteSize),
+    PARAM_INT_FIELD(ChaseParams, transitionSpeed, 0, PARAM_MAX_SPEED),
+    PARAM_INT_FIELD(ChaseParams, holdDelay, 0, PARAM_MAX_MILLIS),
+    PARAM_INT_FIELD(ChaseParams, offsetDelay, 0, PARAM_MAX_MILLIS),
+    PARAM_FIELDS_END,
+};
+
+template struct PatternBase<ChasePattern, ChaseParams>;
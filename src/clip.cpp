@@ -0,0 +1,113 @@
+#include "clip.h"
+
+#ifdef ARDUINO_ARCH_ESP32
+#include <esp_partition.h>
+#endif
+
+static const uint8_t* clipRegion = nullptr;
+static size_t clipRegionSize = 0;
+
+void setClipRegion(const uint8_t* region, size_t size)
+{
+    clipRegion = region;
+    clipRegionSize = size;
+}
+
+const uint8_t* findClip(int index, ClipHeader& header)
+{
+    size_t offset = 0;
+    while (clipRegion != nullptr && offset + sizeof(ClipHeader) <= clipRegionSize) {
+        memcpy(&header, clipRegion + offset, sizeof(header));
+        if (memcmp(header.magic, CLIP_MAGIC, sizeof(header.magic)) != 0 || header.version != CLIP_VERSION
+            || header.totalBytes < sizeof(ClipHeader) || header.totalBytes > clipRegionSize - offset) {
+            return nullptr;
+        }
+        if (index == 0) {
+            bool fits = header.numPins > 0 && header.numPins <= NUM_PINS
+                && header.totalLeds == pinOffset(header.numPins - 1) + pinLeds(header.numPins - 1) && header.fps > 0
+                && header.numFrames > 0;
+            return fits ? clipRegion + offset : nullptr;
+        }
+        offset += header.totalBytes;
+        index--;
+    }
+    return nullptr;
+}
+
+const uint8_t* decodeClipFrame(
+    const uint8_t* frame, const uint8_t* end, const ClipHeader& header, int pins[], int numPins, bool* changed)
+{
+    *changed = false;
+    if (end - frame < clipMaskBytes(header)) {
+        return nullptr;
+    }
+    const uint8_t* mask = frame;
+    const uint8_t* in = frame + clipMaskBytes(header);
+
+    for (int k = 0; k < header.numPins; k++) {
+        if (!(mask[k / 8] & (1 << (k % 8)))) {
+            continue;
+        }
+
+        // Pins the instance does not have are still read past
+        CRGB* out = k < numPins ? leds + pinOffset(pins[k]) : nullptr;
+        int length = pinLeds(k);
+        int kept = k < numPins ? min(length, pinLeds(pins[k])) : 0;
+        int pixel = 0;
+        while (pixel < length) {
+            if (in >= end) {
+                return nullptr;
+            }
+            int op = *in >> 6;
+            int count = *in++ & CLIP_MAX_SHORT_RUN;
+            if (count == 0 && end - in >= 2) {
+                count = in[0] | (in[1] << 8);
+                in += 2;
+            }
+            int bytes = op == CLIP_FILL ? 3 : op == CLIP_LITERAL ? 3 * count : 0;
+            if (op > CLIP_LITERAL || count == 0 || count > length - pixel || bytes > end - in) {
+                return nullptr;
+            }
+
+            int written = max(0, min(count, kept - pixel));
+            if (written > 0 && op == CLIP_FILL) {
+                CRGB color(in[0], in[1], in[2]);
+                for (int i = 0; i < written; i++) {
+                    out[pixel + i] = color;
+                }
+            } else if (written > 0 && op == CLIP_LITERAL) {
+                memcpy(out + pixel, in, written * 3);
+            }
+            pixel += count;
+            in += bytes;
+        }
+
+        if (out != nullptr) {
+            markPinDirty(pins[k]);
+            *changed = true;
+        }
+    }
+    return in;
+}
+
+#ifdef ARDUINO_ARCH_ESP32
+
+bool mapClipPartition()
+{
+    const esp_partition_t* partition
+        = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, "clips");
+    if (partition == nullptr) {
+        return false;
+    }
+
+    // The mapping lasts for the life of the firmware
+    const void* region;
+    spi_flash_mmap_handle_t handle;
+    if (esp_partition_mmap(partition, 0, partition->size, SPI_FLASH_MMAP_DATA, &region, &handle) != ESP_OK) {
+        return false;
+    }
+    setClipRegion(static_cast<const uint8_t*>(region), partition->size);
+    return true;
+}
+
+#endif
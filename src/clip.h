@@ -0,0 +1,64 @@
+#ifndef CLIP_H
+#define CLIP_H
+
+#include "patterns.h"
+#include <stdint.h>
+
+// Pre-rendered frames, as recorded by host/clipc and played by the playback
+// pattern. A clip is a header and its frames back to back. Each frame starts
+// with a bit mask of the pins that changed, one bit per pin from bit 0 of
+// the first byte, followed by the runs of every changed pin in order. Clip
+// pin k is as long as pin k of the layout, and its runs cover it exactly:
+//
+//   SKIP n         n pixels as in the previous frame
+//   FILL n rgb     n pixels of one color
+//   LITERAL n rgb* n pixels given one by one
+//
+// The op byte holds the kind in its top two bits and n in the rest. n of 0
+// means a 16-bit little-endian length follows. The first frame is a key
+// frame: every pin is set and has no SKIP, so playback can start and loop
+// there whatever leds[] holds. A clip plays on builds whose first numPins
+// pins hold totalLeds LEDs, as in the build it was recorded on.
+#define CLIP_MAGIC "FLCP"
+#define CLIP_VERSION 2
+#define CLIP_MAX_SHORT_RUN 63
+
+enum ClipOp { CLIP_SKIP, CLIP_FILL, CLIP_LITERAL };
+
+struct ClipHeader {
+    char magic[4];
+    uint16_t version;
+    uint16_t fps;
+    uint16_t numPins;
+    uint16_t totalLeds;
+    uint32_t numFrames;
+    // Whole clip, header included
+    uint32_t totalBytes;
+};
+
+static_assert(sizeof(ClipHeader) == 20, "clip header must not be padded");
+// The layout table has the same limit today; this one is the clip format's
+// own, so a wider layout has to come with a new CLIP_VERSION
+static_assert((long)TOTAL_LEDS <= 0xFFFF, "clip headers hold totalLeds in 16 bits");
+
+inline int clipMaskBytes(const ClipHeader& header) { return (header.numPins + 7) / 8; }
+
+// Clips are played from one region of memory, the clip partition mapped
+// from flash on the ESP32, holding one or more clips back to back.
+void setClipRegion(const uint8_t* region, size_t size);
+// Clip index of the region, or nullptr if it is not there or does not fit
+// this build's strips
+const uint8_t* findClip(int index, ClipHeader& header);
+
+// Decodes the frame at frame into leds[], clip pin k going to pins[k] and
+// marking it dirty when it changed; pins past numPins, and pixels past the
+// end of a shorter pin, are decoded and dropped. Returns the next frame, or nullptr if the frame runs past end.
+const uint8_t* decodeClipFrame(
+    const uint8_t* frame, const uint8_t* end, const ClipHeader& header, int pins[], int numPins, bool* changed);
+
+#ifdef ARDUINO_ARCH_ESP32
+// Maps the "clips" data partition and makes it the clip region
+bool mapClipPartition();
+#endif
+
+#endif
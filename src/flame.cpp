@@ -1,70 +1,309 @@
 #include "patterns.h"
 #include <Arduino.h>
 
-static unsigned long lastUpdate[8] = { 0 };
-static uint8_t heat[8][NUM_LEDS_PER_STRIP * NUM_STRIPS_PER_PIN];
+// Per pin slot: milliseconds until the next simulation step, how many steps
+// fell into this frame, and the heat of every cell. Every step draws a fresh
+// 0-30ms jitter so the pins flicker out of step with each other. The jitter
+// and sparks come from random, the cooling noise from its own xorshift32. The heat rows
+// of all pins sit back to back, each as long as the longest pin rounded up to
+// whole words, and the scratch row holds one row's cooling noise and then,
+// for the byte loops, its diffused heat.
+struct FlameState {
+    PatternRandom* random;
+    uint32_t* noiseSeed;
+    float* untilNextStep;
+    uint8_t* stepsDue;
+    uint8_t* scratch;
+    uint8_t* heat;
+};
 
-void flamepattern(int pins[], int numPins, int speed, int cooling, int sparking, bool reverse)
+// Rows start on a word for the SWAR kernels below
+static const int heatRowBytes = (MAX_LEDS_PER_PIN + 3) & ~3;
+
+static FlameState layoutFlameState(void* block, int numPins, size_t* size = nullptr)
 {
-    if (speed == 0)
-        return;
+    StateLayout layout(block);
+    FlameState state;
+    state.random = layout.take<PatternRandom>(1);
+    state.noiseSeed = layout.take<uint32_t>(1);
+    state.untilNextStep = layout.take<float>(numPins);
+    state.stepsDue = layout.take<uint8_t>(numPins);
+    state.scratch = reinterpret_cast<uint8_t*>(layout.take<uint32_t>(heatRowBytes / 4));
+    state.heat = reinterpret_cast<uint8_t*>(layout.take<uint32_t>(numPins * heatRowBytes / 4));
+    if (size)
+        *size = layout.size();
+    return state;
+}
 
-    unsigned long currentTime = millis();
+// HeatColor(scale8(heat, 240)) for every heat value, shared by all instances
+static CRGB heatColors[256];
+static bool heatColorsReady = false;
 
-    for (int p = 0; p < numPins; p++) {
-        int pin = pins[p];
+static void buildHeatColors()
+{
+    for (int h = 0; h < 256; h++) {
+        heatColors[h] = HeatColor(scale8(h, 240));
+    }
+    heatColorsReady = true;
+}
 
-        // Add random time offset per pin (0-30ms)
-        unsigned long interval = map(speed, 1, 100, 100, 10) + random8(0, 31);
+// Cooling noise for a whole row, four bytes per xorshift32 step
+template <typename Count> static void fillNoise(uint32_t* seed, uint8_t* noise, Count count)
+{
+    uint32_t x = *seed;
+    for (int i = 0; i < count; i += 4) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        memcpy(noise + i, &x, min(4, count - i));
+    }
+    *seed = x;
+}
 
-        if (currentTime - lastUpdate[pin] >= interval) {
-            lastUpdate[pin] = currentTime;
+// The kernels below have no loop-carried dependencies and do not alias, so
+// the compiler can vectorize them where the target has SIMD. Rows are
+// stepped through ForPinLength, so each is compiled for the pin lengths of
+// the layout.
+template <typename Count>
+static void coolRow(uint8_t* __restrict heat, const uint8_t* __restrict noise, Count count, uint8_t limit)
+{
+    for (int i = 0; i < count; i++) {
+        uint8_t cooling = (noise[i] * limit) >> 8;
+        heat[i] = heat[i] > cooling ? heat[i] - cooling : 0;
+    }
+}
 
-            int startIndex = pin * NUM_LEDS_PER_STRIP * NUM_STRIPS_PER_PIN;
-            int ledsPerPin = NUM_LEDS_PER_STRIP * NUM_STRIPS_PER_PIN;
+// Heat from each cell drifts 'up' and diffuses a little. Cells 0 and 1 keep
+// their heat; the rest are computed from the old row into scratch.
+template <typename Count> static void diffuseRow(uint8_t* __restrict heat, uint8_t* __restrict scratch, Count count)
+{
+    for (int k = 2; k < count; k++) {
+        scratch[k] = (uint16_t)(heat[k - 1] + heat[k - 2] + heat[k - 2]) / 3;
+    }
+    memcpy(heat + 2, scratch + 2, count - 2);
+}
 
-            // Step 1: Cool down every cell with slight random variation
-            uint8_t pinCooling = cooling + random8(0, 11) - 5; // ±5 variation
-            for (int i = 0; i < ledsPerPin; i++) {
-                heat[pin][i] = qsub8(heat[pin][i], random8(0, ((pinCooling * 10) / ledsPerPin) + 2));
-            }
+// Targets without SIMD, such as the ESP32's LX6, get the byte loops above as
+// SWAR kernels instead, four cells to a uint32_t with each pair of cells in
+// 16-bit lanes so no lane carries into the next. They give the same heat as
+// the byte loops, which stay the reference and are used where the compiler
+// vectorizes them. -DFLAME_SWAR=1 forces them on, as native_replay_swar does.
+#ifndef FLAME_SWAR
+#if defined(__SSE2__) || defined(__ARM_NEON)
+#define FLAME_SWAR 0
+#else
+#define FLAME_SWAR 1
+#endif
+#endif
 
-            // Step 2: Heat from each cell drifts 'up' and diffuses a little
-            for (int k = ledsPerPin - 1; k >= 2; k--) {
-                heat[pin][k] = (heat[pin][k - 1] + heat[pin][k - 2] + heat[pin][k - 2]) / 3;
-            }
+#if FLAME_SWAR
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "the SWAR flame kernels take cell 0 as the low byte");
 
-            // Step 3: Randomly ignite new 'sparks' with slight random variation
-            uint8_t pinSparking = sparking + random8(0, 21) - 10; // ±10 variation
-            if (random8() < pinSparking) {
-                int y = random8(7);
-                heat[pin][y] = qadd8(heat[pin][y], random8(160, 255));
-            }
+#define EVEN_CELLS 0x00FF00FFu
 
-            // Step 4: Map from heat cells to LED colors using HeatColor palette
-            for (int j = 0; j < ledsPerPin; j++) {
-                // Scale heat value to palette index
-                uint8_t colorindex = scale8(heat[pin][j], 240);
-                CRGB color = HeatColor(colorindex);
-
-                if (reverse) {
-                    leds[startIndex + (ledsPerPin - 1 - j)] = color;
-                } else {
-                    leds[startIndex + j] = color;
-                }
-            }
+static inline uint32_t loadCells(const uint8_t* cells)
+{
+    uint32_t word;
+    memcpy(&word, __builtin_assume_aligned(cells, 4), 4);
+    return word;
+}
+
+static inline void storeCells(uint8_t* cells, uint32_t word) { memcpy(__builtin_assume_aligned(cells, 4), &word, 4); }
+
+// Two cells cooled, one per lane. A guard bit over each lane's heat keeps the
+// subtraction in the lane and is left clear where it went below zero, which
+// becomes the mask that clamps those lanes to 0.
+static inline uint32_t coolLanes(uint32_t heat, uint32_t noise, uint8_t limit)
+{
+    uint32_t cooling = ((noise * limit) >> 8) & EVEN_CELLS;
+    uint32_t cooled = (heat | 0x01000100u) - cooling;
+    uint32_t kept = ((cooled >> 8) & 0x00010001u) * 0xFF;
+    return cooled & kept;
+}
+
+template <typename Count>
+static void coolRowWords(uint8_t* heat, const uint8_t* noise, Count count, uint8_t limit)
+{
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        uint32_t h = loadCells(heat + i);
+        uint32_t n = loadCells(noise + i);
+        uint32_t even = coolLanes(h & EVEN_CELLS, n & EVEN_CELLS, limit);
+        uint32_t odd = coolLanes((h >> 8) & EVEN_CELLS, (n >> 8) & EVEN_CELLS, limit);
+        storeCells(heat + i, even | (odd << 8));
+    }
+    for (; i < count; i++) {
+        uint8_t cooling = (noise[i] * limit) >> 8;
+        heat[i] = heat[i] > cooling ? heat[i] - cooling : 0;
+    }
+}
+
+// Two diffused cells, (near + 2 * far) / 3 per lane. The sum s is up to 765,
+// too wide for a multiply by a reciprocal to stay in the lane, so it is taken
+// as 4q + r: s / 3 is q + (q + r) / 3, and the last divide is small enough
+// for * 171 >> 9 to be exact.
+static inline uint32_t diffuseLanes(uint32_t near, uint32_t far)
+{
+    uint32_t sum = near + far + far;
+    uint32_t quarter = (sum >> 2) & EVEN_CELLS;
+    uint32_t rest = quarter + (sum & 0x00030003u);
+    return quarter + (((rest * 171) >> 9) & 0x007F007Fu);
+}
+
+// In place, a word at a time: each word's cells are worked out from it and
+// the word before, kept as it was before being overwritten. The last word
+// may be partial and is padded with cold cells, which only later cells read.
+template <typename Count> static void diffuseRowWords(uint8_t* heat, Count count)
+{
+    uint32_t before = 0;
+    for (int i = 0; i < count; i += 4) {
+        int cells = min(4, count - i);
+        uint32_t word = 0;
+        if (cells == 4) {
+            word = loadCells(heat + i);
+        } else {
+            memcpy(&word, heat + i, cells);
+        }
+        uint32_t near = (word << 8) | (before >> 24);
+        uint32_t far = (word << 16) | (before >> 16);
+        uint32_t even = diffuseLanes(near & EVEN_CELLS, far & EVEN_CELLS);
+        uint32_t odd = diffuseLanes((near >> 8) & EVEN_CELLS, (far >> 8) & EVEN_CELLS);
+        uint32_t diffused = even | (odd << 8);
+        // Cells 0 and 1 keep their heat
+        if (i == 0) {
+            diffused = (diffused & 0xFFFF0000u) | (word & 0xFFFFu);
+        }
+        if (cells == 4) {
+            storeCells(heat + i, diffused);
+        } else {
+            memcpy(heat + i, &diffused, cells);
+        }
+        before = word;
+    }
+}
+#endif
+
+// Steps 1 and 2 below for one row
+struct StepHeatRow {
+    template <typename Count>
+    static void run(Count count, uint32_t* noiseSeed, uint8_t* heat, uint8_t* scratch, uint8_t pinCooling)
+    {
+        fillNoise(noiseSeed, scratch, count);
+#if FLAME_SWAR
+        coolRowWords(heat, scratch, count, ((pinCooling * 10) / count) + 2);
+        diffuseRowWords(heat, count);
+#else
+        coolRow(heat, scratch, count, ((pinCooling * 10) / count) + 2);
+        diffuseRow(heat, scratch, count);
+#endif
+    }
+};
+
+struct ColorHeatRow {
+    template <typename Count> static void run(Count count, CRGB* out, const uint8_t* heat)
+    {
+        for (int j = 0; j < count; j++) {
+            out[j] = heatColors[heat[j]];
         }
     }
+};
+
+static void seedFlame(const FlameState& s, uint32_t seed)
+{
+    s.random->seed(seed);
+    // The noise takes a stream of its own; xorshift32 must not start from zero
+    *s.noiseSeed = mixSeed(seed, 1) | 1;
+}
 
-    FastLED.show();
+size_t FlamePattern::stateSize(int numPins)
+{
+    size_t size;
+    layoutFlameState(nullptr, numPins, &size);
+    return size;
 }
 
-void resetFlamePattern()
+bool FlamePattern::render(const FrameTime& time, void* state, int pins[], int numPins, const FlameParams& params, bool reverse)
 {
-    for (int i = 0; i < 8; i++) {
-        lastUpdate[i] = 0;
-        for (int j = 0; j < NUM_LEDS_PER_STRIP * NUM_STRIPS_PER_PIN; j++) {
-            heat[i][j] = 0;
+    int speed = params.speed;
+    int cooling = params.cooling;
+    int sparking = params.sparking;
+
+    if (speed == 0)
+        return false;
+
+    FlameState s = layoutFlameState(state, numPins);
+    float elapsedMs = time.dt * 1000.0f;
+    unsigned long baseInterval = map(speed, 1, 100, 100, 10);
+
+    // Work out how many simulation steps fell into this frame for each pin
+    int rounds = 0;
+    for (int p = 0; p < numPins; p++) {
+        int steps = 0;
+        s.untilNextStep[p] -= elapsedMs;
+        while (s.untilNextStep[p] <= 0) {
+            s.untilNextStep[p] += baseInterval + s.random->next8(0, 31);
+            steps++;
         }
+        s.stepsDue[p] = min(steps, 255);
+        rounds = max(rounds, steps);
     }
-}
\ No newline at end of file
+    if (rounds == 0)
+        return false;
+
+    // Step every pin that is due as one batch, a round per step
+    for (int round = 0; round < rounds; round++) {
+        for (int p = 0; p < numPins; p++) {
+            if (s.stepsDue[p] <= round)
+                continue;
+            uint8_t* heat = s.heat + p * heatRowBytes;
+
+            // Step 1: Cool down every cell with slight random variation
+            // Step 2: Drift and diffuse
+            uint8_t pinCooling = cooling + s.random->next8(0, 11) - 5; // ±5 variation
+            ForPinLength<StepHeatRow>::run(pinLeds(pins[p]), s.noiseSeed, heat, s.scratch, pinCooling);
+
+            // Step 3: Randomly ignite new 'sparks' with slight random variation
+            uint8_t pinSparking = sparking + s.random->next8(0, 21) - 10; // ±10 variation
+            if (s.random->next8() < pinSparking) {
+                int y = s.random->next8(7);
+                heat[y] = qadd8(heat[y], s.random->next8(160, 255));
+            }
+        }
+    }
+
+    // Step 4: Map from heat cells to LED colors through the HeatColor table
+    for (int p = 0; p < numPins; p++) {
+        if (s.stepsDue[p] == 0)
+            continue;
+        const uint8_t* heat = s.heat + p * heatRowBytes;
+        markPinDirty(pins[p]);
+        ForPinLength<ColorHeatRow>::run(pinLeds(pins[p]), leds + pinOffset(pins[p]), heat);
+    }
+
+    return true;
+}
+
+void FlamePattern::reset(void* state, int numPins)
+{
+    memset(state, 0, stateSize(numPins));
+    if (!heatColorsReady) {
+        buildHeatColors();
+    }
+
+    seedFlame(layoutFlameState(state, numPins), 0);
+}
+
+void FlamePattern::prepare(void* state, int pins[], int numPins, const FlameParams& params, bool reverse, uint32_t seed)
+{
+    reset(state, numPins);
+    seedFlame(layoutFlameState(state, numPins), seed);
+}
+
+const ParamField FlamePattern::fields[] = {
+    PARAM_INT_FIELD(FlameParams, speed, 0, PARAM_MAX_SPEED),
+    PARAM_INT_FIELD(FlameParams, cooling, 0, 255),
+    PARAM_INT_FIELD(FlameParams, sparking, 0, 255),
+    PARAM_FIELDS_END,
+};
+
+template struct PatternBase<FlamePattern, FlameParams>;
@@ -0,0 +1,47 @@
+#ifndef FRAMERATE_H
+#define FRAMERATE_H
+
+// Counts presented frames and turns them into a frames-per-second figure
+// once per one-second window.
+class FrameRateCounter {
+private:
+    unsigned long windowStart;
+    unsigned long windowFrames;
+    unsigned long totalFrames;
+    float fps;
+
+public:
+    FrameRateCounter()
+        : windowStart(0)
+        , windowFrames(0)
+        , totalFrames(0)
+        , fps(0)
+    {
+    }
+
+    void reset(unsigned long now)
+    {
+        windowStart = now;
+        windowFrames = 0;
+    }
+
+    void update(unsigned long now, bool presented)
+    {
+        if (presented) {
+            windowFrames++;
+            totalFrames++;
+        }
+
+        unsigned long windowLength = now - windowStart;
+        if (windowLength >= 1000) {
+            fps = windowFrames * 1000.0f / windowLength;
+            windowStart = now;
+            windowFrames = 0;
+        }
+    }
+
+    unsigned long getTotalFrames() { return totalFrames; }
+    float getFps() { return fps; }
+};
+
+#endif
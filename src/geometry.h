@@ -0,0 +1,159 @@
+#ifndef GEOMETRY_H
+#define GEOMETRY_H
+
+#include <stdint.h>
+
+// The LEDs on every output pin, described once. A pin drives a chain of
+// strips of one length, and pins sit back to back in leds[] and in every
+// frame buffer, in pin order. All of it is constexpr, so a pin's length and
+// offset are constants wherever the pin is.
+//
+// LED_LAYOUT picks the layout. LAYOUT_UNIFORM is NUM_PINS pins of
+// NUM_STRIPS_PER_PIN strips of NUM_LEDS_PER_STRIP each, which the build can
+// override; the other layouts are tables.
+#define LAYOUT_UNIFORM 0
+#define LAYOUT_MIXED_16 1
+
+#ifndef LED_LAYOUT
+#define LED_LAYOUT LAYOUT_UNIFORM
+#endif
+
+// One output pin: where its LEDs start in leds[], the length and number of
+// its strips, and the index of its first strip among all strips
+struct OutputLayout {
+    uint16_t offset;
+    uint16_t stripLeds;
+    uint8_t strips;
+    uint8_t firstStrip;
+};
+
+#if LED_LAYOUT == LAYOUT_UNIFORM
+
+#ifndef NUM_LEDS_PER_STRIP
+#define NUM_LEDS_PER_STRIP 122
+#endif
+#ifndef NUM_STRIPS_PER_PIN
+#define NUM_STRIPS_PER_PIN 2
+#endif
+#ifndef NUM_PINS
+#define NUM_PINS 8
+#endif
+
+constexpr OutputLayout outputLayout(int pin)
+{
+    return { (uint16_t)(pin * NUM_LEDS_PER_STRIP * NUM_STRIPS_PER_PIN), NUM_LEDS_PER_STRIP, NUM_STRIPS_PER_PIN,
+        (uint8_t)(pin * NUM_STRIPS_PER_PIN) };
+}
+
+#elif LED_LAYOUT == LAYOUT_MIXED_16
+
+// Eight pins of three 300-LED runs, four of four 122-LED runs and four of
+// two 90-LED runs: 9872 LEDs
+#define NUM_PINS 16
+
+constexpr OutputLayout outputLayouts[NUM_PINS] = {
+    { 0, 300, 3, 0 },
+    { 900, 300, 3, 3 },
+    { 1800, 300, 3, 6 },
+    { 2700, 300, 3, 9 },
+    { 3600, 300, 3, 12 },
+    { 4500, 300, 3, 15 },
+    { 5400, 300, 3, 18 },
+    { 6300, 300, 3, 21 },
+    { 7200, 122, 4, 24 },
+    { 7688, 122, 4, 28 },
+    { 8176, 122, 4, 32 },
+    { 8664, 122, 4, 36 },
+    { 9152, 90, 2, 40 },
+    { 9332, 90, 2, 42 },
+    { 9512, 90, 2, 44 },
+    { 9692, 90, 2, 46 },
+};
+
+constexpr OutputLayout outputLayout(int pin) { return outputLayouts[pin]; }
+
+#else
+#error "unknown LED_LAYOUT"
+#endif
+
+constexpr int pinOffset(int pin) { return outputLayout(pin).offset; }
+constexpr int pinStripLeds(int pin) { return outputLayout(pin).stripLeds; }
+constexpr int pinStrips(int pin) { return outputLayout(pin).strips; }
+constexpr int pinFirstStrip(int pin) { return outputLayout(pin).firstStrip; }
+constexpr int pinLeds(int pin) { return pinStripLeds(pin) * pinStrips(pin); }
+
+// Longest pin and strip from pin on, one call per pin
+constexpr int maxPinLeds(int pin, int longest = 0)
+{
+    return pin == NUM_PINS ? longest : maxPinLeds(pin + 1, pinLeds(pin) > longest ? pinLeds(pin) : longest);
+}
+constexpr int maxStripLeds(int pin, int longest = 0)
+{
+    return pin == NUM_PINS ? longest
+                           : maxStripLeds(pin + 1, pinStripLeds(pin) > longest ? pinStripLeds(pin) : longest);
+}
+
+// Lengths of the layout's pins, each length counted once, for tables kept
+// per pin length
+constexpr bool lengthBefore(int pin, int before)
+{
+    return before > 0 && (pinLeds(before - 1) == pinLeds(pin) || lengthBefore(pin, before - 1));
+}
+constexpr int distinctPinLeds(int pin)
+{
+    return pin == NUM_PINS ? 0 : (lengthBefore(pin, pin) ? 0 : pinLeds(pin)) + distinctPinLeds(pin + 1);
+}
+
+// Each pin starts where the one before it ends, and so does its first strip
+constexpr bool layoutIsPacked(int pin)
+{
+    return pin == NUM_PINS
+        || ((pin == 0 ? pinOffset(0) == 0 && pinFirstStrip(0) == 0
+                      : pinOffset(pin) == pinOffset(pin - 1) + pinLeds(pin - 1)
+                          && pinFirstStrip(pin) == pinFirstStrip(pin - 1) + pinStrips(pin - 1))
+            && pinLeds(pin) > 0 && layoutIsPacked(pin + 1));
+}
+
+// Held in constants so that they are worked out once, here, and not by
+// recursive calls wherever they are used
+constexpr int layoutLeds = pinOffset(NUM_PINS - 1) + pinLeds(NUM_PINS - 1);
+constexpr int layoutStrips = pinFirstStrip(NUM_PINS - 1) + pinStrips(NUM_PINS - 1);
+constexpr int layoutMaxPinLeds = maxPinLeds(0);
+constexpr int layoutMaxStripLeds = maxStripLeds(0);
+constexpr int layoutDistinctPinLeds = distinctPinLeds(0);
+
+#define TOTAL_LEDS layoutLeds
+#define TOTAL_STRIPS layoutStrips
+// Per pin buffers and state rows are this long
+#define MAX_LEDS_PER_PIN layoutMaxPinLeds
+#define MAX_STRIP_LEDS layoutMaxStripLeds
+#define DISTINCT_PIN_LEDS layoutDistinctPinLeds
+
+static_assert(layoutIsPacked(0), "pins of the LED layout must be back to back");
+static_assert((long)TOTAL_LEDS <= 0xFFFF && (long)TOTAL_STRIPS <= 0xFF, "LED layout too large for its table");
+
+// A length known at compile time, which converts to int where a count goes
+template <int N> struct FixedLength {
+    constexpr operator int() const { return N; }
+};
+
+// Calls Kernel::run(length, args...) with length a FixedLength when count is
+// the length of one of the layout's pins, so a loop over a pin is compiled
+// once for each length the layout has and can unroll and inline as it would
+// for a literal size. Any other count is passed as an int.
+template <typename Kernel, int Pin = 0> struct ForPinLength {
+    template <typename... Args> static inline void run(int count, Args... args)
+    {
+        if (count == pinLeds(Pin)) {
+            Kernel::run(FixedLength<pinLeds(Pin)>(), args...);
+        } else {
+            ForPinLength<Kernel, Pin + 1>::run(count, args...);
+        }
+    }
+};
+
+template <typename Kernel> struct ForPinLength<Kernel, NUM_PINS> {
+    template <typename... Args> static inline void run(int count, Args... args) { Kernel::run(count, args...); }
+};
+
+#endif
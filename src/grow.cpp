@@ -1,57 +1,122 @@
 #include "patterns.h"
 #include <Arduino.h>
 
-static unsigned long lastUpdate[8] = { 0 };
-static int currentPhase[8] = { 0 }; // 0: growing, 1: holding, 2: shrinking
-static int activeLeds[8] = { 0 };
-static unsigned long phaseStartTime[8] = { 0 };
-static unsigned long nextLedTime[8] = { 0 };
-static float brightness[8][NUM_LEDS_PER_STRIP * NUM_STRIPS_PER_PIN] = { 0 };
-static unsigned long colorTransitionTime[8] = { 0 };
-static int currentColorIndex[8] = { 0 };
-static float colorTransitionProgress[8] = { 0.0 };
-static unsigned long patternStartTime = 0;
-static bool patternInitialized = false;
-
-void growPattern(int pins[], int numPins, int speed, int n, int fadeDelay, int holdDelay, CRGB palette[], int paletteSize, int transitionSpeed, int offsetDelay, bool reverse)
+// Per pin slot of the instance, plus the time the instance first rendered.
+// Fade levels are 8-bit and only LEDs in [rangeStart, rangeEnd) can still be
+// fading; every LED outside it sits at full or off depending on which side of
+// the grow/shrink frontier (activeLeds) it is.
+struct GrowState {
+    unsigned long* patternStartTime;
+    bool* patternInitialized;
+    unsigned long* phaseStartTime;
+    float* fadeAccumulator;
+    float* ledTimer; // ms towards the next grow/shrink step, < 0 before the pin starts
+    float* colorTransitionProgress;
+    uint16_t* activeLeds;
+    uint16_t* rangeStart;
+    uint16_t* rangeEnd;
+    uint8_t* currentPhase; // 0: growing, 1: holding, 2: shrinking
+    uint8_t* currentColorIndex;
+    uint8_t* level;
+};
+
+static GrowState layoutGrowState(void* block, int numPins, size_t* size = nullptr)
+{
+    StateLayout layout(block);
+    GrowState state;
+    state.patternStartTime = layout.take<unsigned long>(1);
+    state.patternInitialized = layout.take<bool>(1);
+    state.phaseStartTime = layout.take<unsigned long>(numPins);
+    state.fadeAccumulator = layout.take<float>(numPins);
+    state.ledTimer = layout.take<float>(numPins);
+    state.colorTransitionProgress = layout.take<float>(numPins);
+    state.activeLeds = layout.take<uint16_t>(numPins);
+    state.rangeStart = layout.take<uint16_t>(numPins);
+    state.rangeEnd = layout.take<uint16_t>(numPins);
+    state.currentPhase = layout.take<uint8_t>(numPins);
+    state.currentColorIndex = layout.take<uint8_t>(numPins);
+    state.level = layout.take<uint8_t>(numPins * MAX_LEDS_PER_PIN);
+    if (size)
+        *size = layout.size();
+    return state;
+}
+
+// Writes LEDs [from, to) of a pin
+static void fillLeds(int startIndex, int from, int to, const CRGB& color)
+{
+    for (int i = startIndex + from; i < startIndex + to; i++) {
+        leds[i] = color;
+    }
+}
+
+size_t GrowPattern::stateSize(int numPins)
+{
+    size_t size;
+    layoutGrowState(nullptr, numPins, &size);
+    return size;
+}
+
+bool GrowPattern::render(const FrameTime& time, void* state, int pins[], int numPins, const GrowParams& params, bool reverse)
 {
-    if (n == 0 || speed == 0 || paletteSize == 0) return;
-    
-    unsigned long currentTime = millis();
-    unsigned long colorInterval = map(transitionSpeed, 1, 100, 100, 10);
+    int speed = params.speed;
+    int n = params.n;
+    int fadeDelay = params.fadeDelay;
+    int holdDelay = params.holdDelay;
+    CRGB* palette = params.palette;
+    int paletteSize = params.paletteSize;
+    int transitionSpeed = params.transitionSpeed;
+    int offsetDelay = params.offsetDelay;
+
+    if (n == 0 || speed == 0 || paletteSize == 0) return false;
+
+    GrowState s = layoutGrowState(state, numPins);
+    unsigned long currentTime = time.now;
+    float elapsedMs = time.dt * 1000.0f;
+    float stepDelay = max(fadeDelay, 1);
+
+    // Color transition advances 0.02 per interval, fading 1 per interval
+    float colorRate = 0.02f * stepsPerSecond(map(transitionSpeed, 1, 100, 100, 10));
+    float fadeRate = stepsPerSecond(map(speed, 1, 100, 50, 5));
+    // Faster speed = bigger fade steps
+    int fadeStepPerTick = map(speed, 1, 100, 2, 15);
+
+    // Pins waiting out their offset are blanked on the first call only; after
+    // that they stay black and produce no new frame
+    bool firstCall = !*s.patternInitialized;
+    bool changed = firstCall;
 
     // Initialize pattern start time on first call
-    if (!patternInitialized) {
-        patternStartTime = currentTime;
-        patternInitialized = true;
+    if (!*s.patternInitialized) {
+        *s.patternStartTime = currentTime;
+        *s.patternInitialized = true;
     }
 
     for (int p = 0; p < numPins; p++) {
         int pin = pins[p];
-        int startIndex = pin * NUM_LEDS_PER_STRIP * NUM_STRIPS_PER_PIN;
-        int totalLeds = NUM_LEDS_PER_STRIP * NUM_STRIPS_PER_PIN;
+        int startIndex = pinOffset(pin);
+        int totalLeds = pinLeds(pin);
+        uint8_t* level = s.level + p * MAX_LEDS_PER_PIN;
 
         // Calculate offset delay for this pin
         unsigned long pinOffsetDelay = (unsigned long)offsetDelay * p;
-        
+
         // Check if this pin should start yet
-        if (currentTime - patternStartTime < pinOffsetDelay) {
+        if (currentTime - *s.patternStartTime < pinOffsetDelay) {
             // Pin hasn't started yet, keep LEDs off
-            for (int i = 0; i < totalLeds; i++) {
-                leds[startIndex + i] = CRGB::Black;
+            if (firstCall) {
+                for (int i = 0; i < totalLeds; i++) {
+                    leds[startIndex + i] = CRGB::Black;
+                }
+                markPinDirty(pin);
             }
             continue;
         }
 
         // Update color transition
-        if (currentTime - colorTransitionTime[pin] >= colorInterval) {
-            colorTransitionTime[pin] = currentTime;
-            colorTransitionProgress[pin] += 0.02; // Increment transition progress
-            
-            if (colorTransitionProgress[pin] >= 1.0) {
-                colorTransitionProgress[pin] = 0.0;
-                currentColorIndex[pin] = (currentColorIndex[pin] + 1) % paletteSize;
-            }
+        s.colorTransitionProgress[p] += colorRate * time.dt;
+        while (s.colorTransitionProgress[p] >= 1.0) {
+            s.colorTransitionProgress[p] -= 1.0;
+            s.currentColorIndex[p] = (s.currentColorIndex[p] + 1) % paletteSize;
         }
 
         // Calculate current color by blending between palette colors
@@ -59,126 +124,127 @@ void growPattern(int pins[], int numPins, int speed, int n, int fadeDelay, int h
         if (paletteSize == 1) {
             currentColor = palette[0];
         } else {
-            int fromIndex = currentColorIndex[pin];
-            int toIndex = (currentColorIndex[pin] + 1) % paletteSize;
-            currentColor = palette[fromIndex].lerp8(palette[toIndex], (uint8_t)(colorTransitionProgress[pin] * 255));
+            int fromIndex = s.currentColorIndex[p];
+            int toIndex = (s.currentColorIndex[p] + 1) % paletteSize;
+            currentColor = palette[fromIndex].lerp8(palette[toIndex], (uint8_t)(s.colorTransitionProgress[p] * 255));
         }
 
-        if (currentTime >= nextLedTime[pin]) {
-            switch (currentPhase[pin]) {
-                case 0: // Growing phase
-                    if (activeLeds[pin] < totalLeds) {
-                        // Add n LEDs (or remaining LEDs if less than n)
-                        int ledsToAdd = min(n, totalLeds - activeLeds[pin]);
-                        
-                        // Fade in the new LEDs
-                        for (int i = 0; i < ledsToAdd; i++) {
-                            int ledIndex;
-                            if (reverse) {
-                                ledIndex = startIndex + (totalLeds - 1 - activeLeds[pin] - i);
-                            } else {
-                                ledIndex = startIndex + activeLeds[pin] + i;
-                            }
-                            
-                            // Start with black and fade to full color
-                            static float brightness[8][NUM_LEDS_PER_STRIP * NUM_STRIPS_PER_PIN] = { 0 };
-                            brightness[pin][reverse ? (totalLeds - 1 - activeLeds[pin] - i) : (activeLeds[pin] + i)] = 0;
-                        }
-                        
-                        activeLeds[pin] += ledsToAdd;
-                        nextLedTime[pin] = currentTime + fadeDelay;
-                        
-                        if (activeLeds[pin] >= totalLeds) {
-                            currentPhase[pin] = 1; // Switch to holding phase
-                            phaseStartTime[pin] = currentTime;
-                        }
-                    }
-                    break;
-                    
-                case 1: // Holding phase
-                    if (currentTime - phaseStartTime[pin] >= (unsigned long)holdDelay) {
-                        currentPhase[pin] = 2; // Switch to shrinking phase
-                        nextLedTime[pin] = currentTime;
-                    }
-                    break;
-                    
-                case 2: // Shrinking phase
-                    if (activeLeds[pin] > 0) {
-                        // Remove n LEDs (or remaining LEDs if less than n)
-                        int ledsToRemove = min(n, activeLeds[pin]);
-                        activeLeds[pin] -= ledsToRemove;
-                        nextLedTime[pin] = currentTime + fadeDelay;
-                        
-                        if (activeLeds[pin] <= 0) {
-                            currentPhase[pin] = 0; // Reset to growing phase
-                            activeLeds[pin] = 0;
-                        }
-                    }
-                    break;
-            }
+        // Grow or shrink by n LEDs for every fadeDelay that passed; the
+        // first step is due as soon as the pin starts
+        if (s.ledTimer[p] < 0) {
+            s.ledTimer[p] = stepDelay;
+        } else {
+            s.ledTimer[p] += elapsedMs;
+        }
+        if (s.currentPhase[p] == 1 && currentTime - s.phaseStartTime[p] >= (unsigned long)holdDelay) {
+            s.currentPhase[p] = 2; // Switch to shrinking phase
+            s.ledTimer[p] = stepDelay; // First LEDs go out right away
         }
 
-        // Update LED display with fade effect
-        
-        // Calculate fade update interval based on speed (0-100 -> 50-5ms)
-        unsigned long fadeInterval = map(speed, 1, 100, 50, 5);
-        
-        if (currentTime - lastUpdate[pin] >= fadeInterval) {
-            lastUpdate[pin] = currentTime;
-            
-            for (int i = 0; i < totalLeds; i++) {
-                int ledIndex;
-                if (reverse) {
-                    ledIndex = startIndex + (totalLeds - 1 - i);
-                } else {
-                    ledIndex = startIndex + i;
-                }
-                
-                bool shouldBeOn = false;
-                if (currentPhase[pin] == 0) { // Growing
-                    shouldBeOn = (i < activeLeds[pin]);
-                } else if (currentPhase[pin] == 1) { // Holding
-                    shouldBeOn = true;
-                } else { // Shrinking
-                    shouldBeOn = (i < activeLeds[pin]);
+        int frontier = s.activeLeds[p];
+        while (s.currentPhase[p] != 1 && s.ledTimer[p] >= stepDelay) {
+            s.ledTimer[p] -= stepDelay;
+
+            if (s.currentPhase[p] == 0) { // Growing phase
+                // Add n LEDs (or remaining LEDs if less than n); they start
+                // from black and fade in. Never fewer than none, so a bad n
+                // cannot run the pin past its end.
+                int ledsToAdd = max(min(n, totalLeds - s.activeLeds[p]), 0);
+                s.activeLeds[p] += ledsToAdd;
+
+                if (s.activeLeds[p] >= totalLeds) {
+                    s.currentPhase[p] = 1; // Switch to holding phase
+                    s.phaseStartTime[p] = currentTime;
                 }
-                
-                // Calculate fade step based on speed (faster speed = bigger steps)
-                float fadeStep = map(speed, 1, 100, 2, 15);
-                
-                if (shouldBeOn && brightness[pin][i] < 255.0) {
-                    brightness[pin][i] += fadeStep; // Fade in
-                    if (brightness[pin][i] > 255.0) brightness[pin][i] = 255.0;
-                } else if (!shouldBeOn && brightness[pin][i] > 0.0) {
-                    brightness[pin][i] -= fadeStep; // Fade out
-                    if (brightness[pin][i] < 0.0) brightness[pin][i] = 0.0;
+            } else { // Shrinking phase
+                // Remove n LEDs (or remaining LEDs if less than n)
+                int ledsToRemove = max(min(n, (int)s.activeLeds[p]), 0);
+                s.activeLeds[p] -= ledsToRemove;
+
+                if (s.activeLeds[p] <= 0) {
+                    s.currentPhase[p] = 0; // Reset to growing phase
+                    s.activeLeds[p] = 0;
                 }
-                
+            }
+        }
+
+        // LEDs the frontier passed over start fading towards their new target
+        int active = s.activeLeds[p];
+        if (active != frontier) {
+            int from = min(frontier, active);
+            int to = max(frontier, active);
+            if (s.rangeStart[p] >= s.rangeEnd[p]) {
+                s.rangeStart[p] = from;
+                s.rangeEnd[p] = to;
+            } else {
+                s.rangeStart[p] = min((int)s.rangeStart[p], from);
+                s.rangeEnd[p] = max((int)s.rangeEnd[p], to);
+            }
+        }
+
+        // Update LED display with fade effect
+        int fadeSteps = takeSteps(s.fadeAccumulator[p], fadeRate, time.dt);
+
+        if (fadeSteps > 0) {
+            changed = true;
+            markPinDirty(pin);
+
+            uint8_t fadeStep = min(fadeStepPerTick * fadeSteps, 255);
+            int start = s.rangeStart[p];
+            int end = s.rangeEnd[p];
+
+            // Fade the LEDs in the active range, then drop the ones that
+            // settled from its ends
+            for (int i = start; i < end; i++) {
+                level[i] = i < active ? qadd8(level[i], fadeStep) : qsub8(level[i], fadeStep);
+            }
+            while (start < end && level[start] == (start < active ? 255 : 0)) {
+                start++;
+            }
+            while (end > start && level[end - 1] == (end - 1 < active ? 255 : 0)) {
+                end--;
+            }
+            s.rangeStart[p] = start;
+            s.rangeEnd[p] = end;
+
+            // Settled LEDs are the plain color or black; only the range
+            // needs scaling
+            fillLeds(startIndex, 0, min(start, active), currentColor);
+            fillLeds(startIndex, min(start, active), start, CRGB::Black);
+            for (int i = start; i < end; i++) {
                 CRGB scaledColor = currentColor;
-                scaledColor.nscale8((uint8_t)brightness[pin][i]);
-                leds[ledIndex] = scaledColor;
+                scaledColor.nscale8(level[i]);
+                leds[startIndex + i] = scaledColor;
             }
+            fillLeds(startIndex, end, max(end, active), currentColor);
+            fillLeds(startIndex, max(end, active), totalLeds, CRGB::Black);
         }
     }
 
-    FastLED.show();
+    return changed;
 }
 
-void resetGrowPattern()
+void GrowPattern::reset(void* state, int numPins)
 {
-    for (int i = 0; i < 8; i++) {
-        lastUpdate[i] = 0;
-        currentPhase[i] = 0;
-        activeLeds[i] = 0;
-        phaseStartTime[i] = 0;
-        nextLedTime[i] = 0;
-        colorTransitionTime[i] = 0;
-        currentColorIndex[i] = 0;
-        colorTransitionProgress[i] = 0.0;
-        for (int j = 0; j < NUM_LEDS_PER_STRIP * NUM_STRIPS_PER_PIN; j++) {
-            brightness[i][j] = 0.0;
-        }
+    memset(state, 0, stateSize(numPins));
+
+    GrowState s = layoutGrowState(state, numPins);
+    for (int p = 0; p < numPins; p++) {
+        // One fade step and one grow step are due on a pin's first frame
+        s.fadeAccumulator[p] = 1.0;
+        s.ledTimer[p] = -1.0;
     }
-    patternStartTime = 0;
-    patternInitialized = false;
-}
\ No newline at end of file
+}
+
+const ParamField GrowPattern::fields[] = {
+    PARAM_INT_FIELD(GrowParams, speed, 0, PARAM_MAX_SPEED),
+    PARAM_INT_FIELD(GrowParams, n, 0, MAX_LEDS_PER_PIN),
+    PARAM_INT_FIELD(GrowParams, fadeDelay, 0, PARAM_MAX_MILLIS),
+    PARAM_INT_FIELD(GrowParams, holdDelay, 0, PARAM_MAX_MILLIS),
+    PARAM_PALETTE_FIELD(GrowParams, palette, paletteSize),
+    PARAM_INT_FIELD(GrowParams, transitionSpeed, 0, PARAM_MAX_SPEED),
+    PARAM_INT_FIELD(GrowParams, offsetDelay, 0, PARAM_MAX_MILLIS),
+    PARAM_FIELDS_END,
+};
+
+template struct PatternBase<GrowPattern, GrowParams>;
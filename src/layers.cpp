@@ -0,0 +1,100 @@
+#include "layers.h"
+#include "transition.h"
+
+static const char* const blendModeNames[] = { "replace", "add", "max", "multiply", "alpha" };
+
+int findBlendMode(const char* name)
+{
+    for (int i = 0; i < (int)(sizeof(blendModeNames) / sizeof(blendModeNames[0])); i++) {
+        if (strcmp(blendModeNames[i], name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+const char* blendModeName(int mode) { return blendModeNames[mode]; }
+
+// Byte loops over the channels like crossfadeBytes() in transition.cpp, and
+// scaled the same way
+static void addBytes(uint8_t* target, const uint8_t* layer, int count, uint8_t opacity)
+{
+    uint16_t scale = 1 + opacity;
+    for (int i = 0; i < count; i++) {
+        uint16_t sum = target[i] + ((layer[i] * scale) >> 8);
+        target[i] = sum > 255 ? 255 : sum;
+    }
+}
+
+static void maxBytes(uint8_t* target, const uint8_t* layer, int count, uint8_t opacity)
+{
+    uint16_t scale = 1 + opacity;
+    for (int i = 0; i < count; i++) {
+        uint8_t value = (layer[i] * scale) >> 8;
+        target[i] = value > target[i] ? value : target[i];
+    }
+}
+
+// The layer is first faded towards white by the opacity
+static void multiplyBytes(uint8_t* target, const uint8_t* layer, int count, uint8_t opacity)
+{
+    uint16_t scale = 1 + opacity;
+    for (int i = 0; i < count; i++) {
+        uint16_t factor = 1 + 255 - (((255 - layer[i]) * scale) >> 8);
+        target[i] = (target[i] * factor) >> 8;
+    }
+}
+
+// Each pixel's alpha is spread over its three bytes first, so the crossfade
+// is a byte loop like the others
+static void alphaPixels(CRGB* target, const CRGB* layer, int count, uint8_t opacity)
+{
+    static uint8_t alphas[MAX_LEDS_PER_PIN * 3];
+    uint16_t scale = 1 + opacity;
+    for (int i = 0; i < count; i++) {
+        const CRGB& pixel = layer[i];
+        uint8_t brightest = max(pixel.r, max(pixel.g, pixel.b));
+        uint8_t alpha = (brightest * scale) >> 8;
+        alphas[i * 3] = alpha;
+        alphas[i * 3 + 1] = alpha;
+        alphas[i * 3 + 2] = alpha;
+    }
+
+    uint8_t* below = target[0].raw;
+    const uint8_t* above = layer[0].raw;
+    for (int i = 0; i < count * 3; i++) {
+        uint16_t sum = ((below[i] * (256 - alphas[i])) >> 8) + ((above[i] * (1 + alphas[i])) >> 8);
+        below[i] = sum > 255 ? 255 : sum;
+    }
+}
+
+void blendPixels(BlendMode mode, uint8_t opacity, CRGB* target, const CRGB* layer, int count, bool flip)
+{
+    if (opacity == 0) {
+        return;
+    }
+    static CRGB scratch[MAX_LEDS_PER_PIN];
+    layer = mirroredPin(layer, count, flip, scratch);
+
+    switch (mode) {
+    case BLEND_REPLACE:
+        if (opacity == 255) {
+            memcpy(target, layer, sizeof(CRGB) * count);
+        } else {
+            crossfadeBytes(target[0].raw, target[0].raw, layer[0].raw, count * 3, opacity);
+        }
+        break;
+    case BLEND_ADD:
+        addBytes(target[0].raw, layer[0].raw, count * 3, opacity);
+        break;
+    case BLEND_MAX:
+        maxBytes(target[0].raw, layer[0].raw, count * 3, opacity);
+        break;
+    case BLEND_MULTIPLY:
+        multiplyBytes(target[0].raw, layer[0].raw, count * 3, opacity);
+        break;
+    case BLEND_ALPHA:
+        alphaPixels(target, layer, count, opacity);
+        break;
+    }
+}
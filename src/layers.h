@@ -0,0 +1,32 @@
+#ifndef LAYERS_H
+#define LAYERS_H
+
+#include "patterns.h"
+
+// How a pattern instance's layer goes over the instances before it in its
+// segment, on the pins they share; the first visible layer on a pin goes
+// over black. Opacity scales what the layer does, 0 leaving the pin as it
+// was and 255 doing all of it.
+//
+//   REPLACE   the layer covers what is below it
+//   ADD       the layer is added on, clamped at 255
+//   MAX       the brighter of the layer and what is below, per channel
+//   MULTIPLY  what is below is scaled by the layer, white leaving it as is
+//   ALPHA     the layer's brightest channel is its alpha, so black in the
+//             layer shows what is below and full color covers it
+enum BlendMode { BLEND_REPLACE, BLEND_ADD, BLEND_MAX, BLEND_MULTIPLY, BLEND_ALPHA };
+
+// By name, as in show files; -1 if there is none
+int findBlendMode(const char* name);
+const char* blendModeName(int mode);
+
+// A layer that draws its pixels as they are over black and hides everything
+// below it
+inline bool blendIsOpaque(BlendMode mode, uint8_t opacity) { return mode == BLEND_REPLACE && opacity == 255; }
+
+// Blends count pixels of layer into target in place. With flip the layer is
+// read from its last pixel back, for a layer that runs the other way from
+// the pin it is shown on.
+void blendPixels(BlendMode mode, uint8_t opacity, CRGB* target, const CRGB* layer, int count, bool flip);
+
+#endif
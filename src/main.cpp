@@ -1,13 +1,92 @@
+#include "clip.h"
+#include "output.h"
 #include "patterns.h"
+#include "pipeline.h"
+#include "profiler.h"
 #include "program.h"
+#include "replay.h"
+#include "scheduler.h"
+#include "show.h"
+#include "show_loader.h"
+#include "stream_input.h"
+#include "sync.h"
 #include <Arduino.h>
 #include <FastLED.h>
+#ifdef ARDUINO_ARCH_ESP32
+#include <LittleFS.h>
+#include <WiFi.h>
+#endif
 
-#define NUM_LEDS_PER_STRIP 122
-#define NUM_STRIPS_PER_PIN 2
-#define NUM_PINS 8
-#define TOTAL_LEDS (NUM_PINS * NUM_STRIPS_PER_PIN * NUM_LEDS_PER_STRIP)
 #define COLOR_ORDER GRB
+#define TARGET_FPS 60
+
+// Render on one core while the other transmits the previous frame. Set to 0
+// to render and show back to back from loop().
+#ifndef RENDER_PIPELINE
+#define RENDER_PIPELINE 1
+#endif
+
+// Send all 8 pins as one parallel I2S stream by DMA instead of through
+// FastLED's RMT controllers, with show() returning once the stream is queued
+#ifndef PARALLEL_OUTPUT
+#define PARALLEL_OUTPUT 0
+#endif
+
+// Supply limits in mA for the whole installation and for each pin; 0 leaves
+// the output unlimited. The estimate is reported either way.
+#ifndef CURRENT_LIMIT_MA
+#define CURRENT_LIMIT_MA 0
+#endif
+#ifndef PIN_CURRENT_LIMIT_MA
+#define PIN_CURRENT_LIMIT_MA 0
+#endif
+
+// Load the show from /show.bin on the LittleFS partition, as compiled by
+// host/showc, falling back to the built-in one when it is missing or invalid.
+// The image is read into showImage and the Program is built in showMemory.
+#ifndef SHOW_FROM_FLASH
+#define SHOW_FROM_FLASH 1
+#endif
+#define SHOW_PATH "/show.bin"
+
+// Join WiFi and listen for E1.31, for shows with segments that play the
+// stream pattern
+#ifndef STREAM_INPUT
+#define STREAM_INPUT 0
+#endif
+// Play in step with other boards: SYNC_LEADER broadcasts its frame clock to
+// SYNC_ADDRESS and SYNC_FOLLOWER boards follow it (sync.h). Every board
+// needs the same show.
+#ifndef SYNC_ROLE
+#define SYNC_ROLE SYNC_OFF
+#endif
+#ifndef SYNC_ADDRESS
+#define SYNC_ADDRESS "255.255.255.255"
+#endif
+#ifndef WIFI_SSID
+#define WIFI_SSID ""
+#endif
+#ifndef WIFI_PASSWORD
+#define WIFI_PASSWORD ""
+#endif
+
+// Seed of the patterns' random numbers. With DETERMINISTIC_TRACE, one pass
+// of the show is played on a fixed clock before it starts and the hash of
+// every frame is printed over Serial, as a trace for replay.h.
+#ifndef SHOW_SEED
+#define SHOW_SEED 0
+#endif
+#ifndef DETERMINISTIC_TRACE
+#define DETERMINISTIC_TRACE 0
+#endif
+
+// The frame profiler (profiler.h) is built in for the whole firmware with
+// -DFRAME_PROFILER=1, as in the esp32dev_profile environment. Its record goes
+// out over Serial with every report, for host/profile/decode_profile.py.
+#define PROFILE_TX_BUFFER_BYTES 4096
+
+#define SHOW_IMAGE_BYTES 2048
+#define SHOW_MEMORY_BYTES 4096
 
 #define PIN1 13
 #define PIN2 12
@@ -17,205 +96,268 @@
 #define PIN6 25
 #define PIN7 33
 #define PIN8 32
+static_assert(NUM_PINS == 8 || NUM_PINS == 16, "setup() drives 8 or 16 pins");
+#if PARALLEL_OUTPUT && NUM_PINS > PARALLEL_LANES
+#error "parallel output drives at most 8 pins"
+#endif
 
-CRGB leds[TOTAL_LEDS];
+#if NUM_PINS > 8
+#define PIN9 4
+#define PIN10 16
+#define PIN11 17
+#define PIN12 5
+#define PIN13 18
+#define PIN14 19
+#define PIN15 21
+#define PIN16 22
+#endif
+
+// Patterns render into renderBuffer and the output stage composes that into
+// the back buffer; the front buffer is what is transmitted. Without the
+// pipeline both roles use ledBuffers[0].
+CRGB renderBuffer[TOTAL_LEDS];
+CRGB ledBuffers[2][TOTAL_LEDS];
+CRGB* leds = renderBuffer;
+// WS2812B gamma, and FastLED's TypicalLEDStrip correction as white balance
+ColorCorrection stripCorrection;
 Program* mainProgram;
+FrameScheduler scheduler(TARGET_FPS);
+FramePipeline* pipeline;
+#if PARALLEL_OUTPUT
+int outputPins[] = { PIN1, PIN2, PIN3, PIN4, PIN5, PIN6, PIN7, PIN8 };
+ParallelOutput parallelOutput(outputPins, 8);
+#endif
+#if SHOW_FROM_FLASH
+uint8_t showImage[SHOW_IMAGE_BYTES];
+uint8_t showMemory[SHOW_MEMORY_BYTES];
+#endif
+
+Program* loadMainProgram()
+{
+#if SHOW_FROM_FLASH
+    size_t size;
+    if (LittleFS.begin() && readShowFile(SHOW_PATH, showImage, sizeof(showImage), &size)) {
+        Program* program = loadShow(showImage, size, showMemory, sizeof(showMemory));
+        if (program != nullptr) {
+            Serial.println("show loaded from " SHOW_PATH);
+            return program;
+        }
+        Serial.print("invalid show image, needs bytes: ");
+        Serial.println((unsigned long)showMemoryBytes(showImage, size));
+    }
+#endif
+    Serial.println("built-in show");
+    return buildMainProgram();
+}
+
+#if DETERMINISTIC_TRACE
+void printTraceFrame(unsigned long frame, uint32_t hash, void* context)
+{
+    char line[12];
+    snprintf(line, sizeof(line), "%08lx", (unsigned long)hash);
+    Serial.println(line);
+}
+
+void traceMainProgram()
+{
+    unsigned long frames = (uint64_t)mainProgram->getDurationMillis() * TARGET_FPS / 1000;
+    char header[64];
+    snprintf(header, sizeof(header), "# seed %lu fps %d frames %lu", (unsigned long)SHOW_SEED, TARGET_FPS, frames);
+    Serial.println(header);
+
+    unsigned long begin = millis();
+    traceProgram(*mainProgram, TARGET_FPS, frames, printTraceFrame, nullptr);
+    Serial.print("trace ms: ");
+    Serial.println(millis() - begin);
+}
+#endif
 
 void setup()
 {
+#if FRAME_PROFILER
+    // Room for a whole record, so dumping it does not wait on the UART
+    Serial.setTxBufferSize(PROFILE_TX_BUFFER_BYTES);
+#endif
     Serial.begin(115200);
 
-    // Configure FastLED for 8 pins, each controlling 2 strips of 122 LEDs
-    FastLED.addLeds<WS2812B, PIN1, COLOR_ORDER>(
-        leds, 0 * NUM_LEDS_PER_STRIP * NUM_STRIPS_PER_PIN, NUM_LEDS_PER_STRIP * NUM_STRIPS_PER_PIN);
-    FastLED.addLeds<WS2812B, PIN2, COLOR_ORDER>(
-        leds, 1 * NUM_LEDS_PER_STRIP * NUM_STRIPS_PER_PIN, NUM_LEDS_PER_STRIP * NUM_STRIPS_PER_PIN);
-    FastLED.addLeds<WS2812B, PIN3, COLOR_ORDER>(
-        leds, 2 * NUM_LEDS_PER_STRIP * NUM_STRIPS_PER_PIN, NUM_LEDS_PER_STRIP * NUM_STRIPS_PER_PIN);
-    FastLED.addLeds<WS2812B, PIN4, COLOR_ORDER>(
-        leds, 3 * NUM_LEDS_PER_STRIP * NUM_STRIPS_PER_PIN, NUM_LEDS_PER_STRIP * NUM_STRIPS_PER_PIN);
-    FastLED.addLeds<WS2812B, PIN5, COLOR_ORDER>(
-        leds, 4 * NUM_LEDS_PER_STRIP * NUM_STRIPS_PER_PIN, NUM_LEDS_PER_STRIP * NUM_STRIPS_PER_PIN);
-    FastLED.addLeds<WS2812B, PIN6, COLOR_ORDER>(
-        leds, 5 * NUM_LEDS_PER_STRIP * NUM_STRIPS_PER_PIN, NUM_LEDS_PER_STRIP * NUM_STRIPS_PER_PIN);
-    FastLED.addLeds<WS2812B, PIN7, COLOR_ORDER>(
-        leds, 6 * NUM_LEDS_PER_STRIP * NUM_STRIPS_PER_PIN, NUM_LEDS_PER_STRIP * NUM_STRIPS_PER_PIN);
-    FastLED.addLeds<WS2812B, PIN8, COLOR_ORDER>(
-        leds, 7 * NUM_LEDS_PER_STRIP * NUM_STRIPS_PER_PIN, NUM_LEDS_PER_STRIP * NUM_STRIPS_PER_PIN);
+#if PARALLEL_OUTPUT
+    if (!parallelOutput.begin()) {
+        Serial.println("parallel output init failed");
+    }
+    useParallelOutput(&parallelOutput);
+#else
+    // One controller per pin, over the pin's LEDs in the layout
+    FastLED.addLeds<WS2812B, PIN1, COLOR_ORDER>(ledBuffers[0], pinOffset(0), pinLeds(0));
+    FastLED.addLeds<WS2812B, PIN2, COLOR_ORDER>(ledBuffers[0], pinOffset(1), pinLeds(1));
+    FastLED.addLeds<WS2812B, PIN3, COLOR_ORDER>(ledBuffers[0], pinOffset(2), pinLeds(2));
+    FastLED.addLeds<WS2812B, PIN4, COLOR_ORDER>(ledBuffers[0], pinOffset(3), pinLeds(3));
+    FastLED.addLeds<WS2812B, PIN5, COLOR_ORDER>(ledBuffers[0], pinOffset(4), pinLeds(4));
+    FastLED.addLeds<WS2812B, PIN6, COLOR_ORDER>(ledBuffers[0], pinOffset(5), pinLeds(5));
+    FastLED.addLeds<WS2812B, PIN7, COLOR_ORDER>(ledBuffers[0], pinOffset(6), pinLeds(6));
+    FastLED.addLeds<WS2812B, PIN8, COLOR_ORDER>(ledBuffers[0], pinOffset(7), pinLeds(7));
+#if NUM_PINS > 8
+    FastLED.addLeds<WS2812B, PIN9, COLOR_ORDER>(ledBuffers[0], pinOffset(8), pinLeds(8));
+    FastLED.addLeds<WS2812B, PIN10, COLOR_ORDER>(ledBuffers[0], pinOffset(9), pinLeds(9));
+    FastLED.addLeds<WS2812B, PIN11, COLOR_ORDER>(ledBuffers[0], pinOffset(10), pinLeds(10));
+    FastLED.addLeds<WS2812B, PIN12, COLOR_ORDER>(ledBuffers[0], pinOffset(11), pinLeds(11));
+    FastLED.addLeds<WS2812B, PIN13, COLOR_ORDER>(ledBuffers[0], pinOffset(12), pinLeds(12));
+    FastLED.addLeds<WS2812B, PIN14, COLOR_ORDER>(ledBuffers[0], pinOffset(13), pinLeds(13));
+    FastLED.addLeds<WS2812B, PIN15, COLOR_ORDER>(ledBuffers[0], pinOffset(14), pinLeds(14));
+    FastLED.addLeds<WS2812B, PIN16, COLOR_ORDER>(ledBuffers[0], pinOffset(15), pinLeds(15));
+#endif
 
     FastLED.setBrightness(255);
-    FastLED.clear();
-    FastLED.show();
-
-    // Create a program with 7 segments
-    mainProgram = new Program(7);
-
-    // Segment 1: Spin pattern test on all pins for 15 seconds
-    int allPins[] = { 0, 1, 2, 3, 4, 5, 6, 7 };
-    static CRGB spinPalette[] = { CRGB::Red, CRGB::Blue, CRGB::Green, CRGB::Yellow };
-    PatternParams spinParams;
-    spinParams.spin.speed = 75; // Medium-fast speed
-    spinParams.spin.separation = 20; // 20 LEDs of black space between colors
-    spinParams.spin.span = 15; // Each color fills 15 LEDs
-    spinParams.spin.palette = spinPalette;
-    spinParams.spin.paletteSize = 4;
-    spinParams.spin.loop = true; // Fill entire strip with repeating pattern
-    spinParams.spin.continuous = true; // Use span/separation pattern instead of all LEDs
-    spinParams.spin.blend = true; // Smooth color transitions using FastLED lerp8
-    mainProgram->addSegment(0, new Segment(PATTERN_SPIN, allPins, 8, 15, spinParams));
-
-    // Segment 2: Multi-color breathing on all pins for 10 seconds
-    static CRGB breathingPalette[] = { CRGB::Purple, CRGB::Magenta, CRGB::Blue, CRGB::Cyan };
-    PatternParams breathingParams;
-    breathingParams.breathing.speed = 50;
-    breathingParams.breathing.palette = breathingPalette;
-    breathingParams.breathing.paletteSize = 4;
-    mainProgram->addSegment(1, new Segment(PATTERN_BREATHING, allPins, 8, 10, breathingParams));
-
-    // Segment 3: Flame pattern on all pins for 15 seconds
-    PatternParams flameParams;
-    flameParams.flame.speed = 80;
-    flameParams.flame.cooling = 55;
-    flameParams.flame.sparking = 120;
-    mainProgram->addSegment(2, new Segment(PATTERN_FLAME, allPins, 8, 10, flameParams, 1));
-
-    // Segment 4: Grow pattern on all pins for 20 seconds
-    static CRGB growPalette[] = { CRGB::Cyan, CRGB::Blue, CRGB::Purple, CRGB::Magenta, CRGB::Red, CRGB::Orange };
-    PatternParams growParams;
-    growParams.grow.speed = 60;
-    growParams.grow.n = 1;
-    growParams.grow.fadeDelay = 100;
-    growParams.grow.holdDelay = 2000;
-    growParams.grow.palette = growPalette;
-    growParams.grow.paletteSize = 6;
-    growParams.grow.transitionSpeed = 40;
-    growParams.grow.offsetDelay = 1000;
-    mainProgram->addSegment(3, new Segment(PATTERN_GROW, allPins, 8, 10, growParams, 1));
-
-    // Segment 5: Multi-pattern segment - different patterns on different pins
-    // Create pattern instances for different pin groups
-    PatternInstance* patterns[3];
-
-    // Breathing on pins 0-2
-    int breathingPins[] = { 0, 1, 2 };
-    static CRGB multiBreathingPalette[] = { CRGB(0, 255, 128), CRGB::Green, CRGB::Teal };
-    PatternParams multiBreathingParams;
-    multiBreathingParams.breathing.speed = 60;
-    multiBreathingParams.breathing.palette = multiBreathingPalette;
-    multiBreathingParams.breathing.paletteSize = 3;
-    patterns[0] = new PatternInstance(PATTERN_BREATHING, breathingPins, 3, multiBreathingParams);
-
-    // Flame on pins 3-5
-    int flamePins[] = { 3, 4, 5 };
-    PatternParams multiFlameParams;
-    multiFlameParams.flame.speed = 90;
-    multiFlameParams.flame.cooling = 60;
-    multiFlameParams.flame.sparking = 130;
-    patterns[1] = new PatternInstance(PATTERN_FLAME, flamePins, 3, multiFlameParams);
-
-    int growPins[] = { 6, 7 };
-    PatternParams growParams2;
-    growParams2.grow.speed = 60;
-    growParams2.grow.n = 1;
-    growParams2.grow.fadeDelay = 100;
-    growParams2.grow.holdDelay = 2000;
-    growParams2.grow.palette = growPalette;
-    growParams2.grow.paletteSize = 6;
-    growParams2.grow.transitionSpeed = 40;
-    growParams2.grow.offsetDelay = 1000;
-    patterns[2] = new PatternInstance(PATTERN_GROW, growPins, 2, growParams2);
-
-    mainProgram->addSegment(4, new Segment(patterns, 3, 5));
-
-    // Segment 6: Pop pattern with random pins and acceleration
-    static CRGB popPalette[]
-        = { CRGB::Red, CRGB::Orange, CRGB::Yellow, CRGB::Green, CRGB::Blue, CRGB::Purple, CRGB::Pink, CRGB::White };
-    PatternParams popParams;
-    popParams.pop.speed = 10; // Maximum speed after acceleration
-    popParams.pop.holdDelay = 300; // Hold each color for 300ms
-    popParams.pop.palette = popPalette;
-    popParams.pop.paletteSize = 8;
-    popParams.pop.random = true; // Randomize pin order
-    popParams.pop.accelerationTime = 8; // Accelerate over 8 seconds
-    mainProgram->addSegment(5, new Segment(PATTERN_POP, allPins, 8, 20, popParams));
-
-    // Segment 7: Complex multi-pattern symphony - showcase of all features
-    PatternInstance* symphonyPatterns[4];
-
-    // Pattern 1: Pulsing ocean colors on pins 0-1 with smooth breathing
-    int oceanPins[] = { 0, 1 };
-    static CRGB oceanPalette[] = { 
-        CRGB(0, 100, 150),    // Deep blue
-        CRGB(0, 150, 200),    // Ocean blue  
-        CRGB(0, 200, 255),    // Bright cyan
-        CRGB(100, 255, 200),  // Aqua green
-        CRGB(0, 255, 255)     // Pure cyan
-    };
-    PatternParams oceanParams;
-    oceanParams.breathing.speed = 25;
-    oceanParams.breathing.palette = oceanPalette;
-    oceanParams.breathing.paletteSize = 5;
-    symphonyPatterns[0] = new PatternInstance(PATTERN_BREATHING, oceanPins, 2, oceanParams);
-
-    // Pattern 2: Rapid spinning rainbow on pins 2-3 with blending
-    int rainbowPins[] = { 2, 3 };
-    static CRGB rainbowPalette[] = { 
-        CRGB::Red, CRGB::Orange, CRGB::Yellow, CRGB::Green, 
-        CRGB::Blue, CRGB::Indigo, CRGB::Violet, CRGB::Magenta 
-    };
-    PatternParams rainbowParams;
-    rainbowParams.spin.speed = 90;
-    rainbowParams.spin.separation = 8;
-    rainbowParams.spin.span = 12;
-    rainbowParams.spin.palette = rainbowPalette;
-    rainbowParams.spin.paletteSize = 8;
-    rainbowParams.spin.loop = true;
-    rainbowParams.spin.continuous = false;
-    rainbowParams.spin.blend = true;
-    symphonyPatterns[1] = new PatternInstance(PATTERN_SPIN, rainbowPins, 2, rainbowParams);
-
-    // Pattern 3: Growing sunset on pins 4-5 with staggered timing
-    int sunsetPins[] = { 4, 5 };
-    static CRGB sunsetPalette[] = { 
-        CRGB(255, 40, 0),     // Deep red
-        CRGB(255, 100, 0),    // Orange-red
-        CRGB(255, 150, 0),    // Orange
-        CRGB(255, 200, 50),   // Yellow-orange
-        CRGB(255, 255, 100)   // Warm yellow
-    };
-    PatternParams sunsetParams;
-    sunsetParams.grow.speed = 45;
-    sunsetParams.grow.n = 3;
-    sunsetParams.grow.fadeDelay = 150;
-    sunsetParams.grow.holdDelay = 3000;
-    sunsetParams.grow.palette = sunsetPalette;
-    sunsetParams.grow.paletteSize = 5;
-    sunsetParams.grow.transitionSpeed = 30;
-    sunsetParams.grow.offsetDelay = 2000;
-    symphonyPatterns[2] = new PatternInstance(PATTERN_GROW, sunsetPins, 2, sunsetParams);
-
-    // Pattern 4: Accelerating neon flash on pins 6-7
-    int neonPins[] = { 6, 7 };
-    static CRGB neonPalette[] = { 
-        CRGB(255, 0, 255),    // Magenta
-        CRGB(0, 255, 255),    // Cyan
-        CRGB(255, 255, 0),    // Yellow
-        CRGB(255, 0, 128),    // Hot pink
-        CRGB(128, 255, 0),    // Lime green
-        CRGB(255, 128, 0)     // Neon orange
-    };
-    PatternParams neonParams;
-    neonParams.pop.speed = 80;
-    neonParams.pop.holdDelay = 200;
-    neonParams.pop.palette = neonPalette;
-    neonParams.pop.paletteSize = 6;
-    neonParams.pop.random = true;
-    neonParams.pop.accelerationTime = 15;
-    symphonyPatterns[3] = new PatternInstance(PATTERN_POP, neonPins, 2, neonParams);
-
-    mainProgram->addSegment(6, new Segment(symphonyPatterns, 4, 25));
-
-    mainProgram->start();
+#endif
+
+    stripCorrection.build(2.2f, CRGB(255, 176, 240));
+    for (int strip = 0; strip < TOTAL_STRIPS; strip++) {
+        setStripCorrection(strip, &stripCorrection);
+    }
+    setCurrentLimit(CURRENT_LIMIT_MA);
+    for (int pin = 0; pin < NUM_PINS; pin++) {
+        setPinCurrentLimit(pin, PIN_CURRENT_LIMIT_MA);
+    }
+
+    // Start every strip from black
+    bool allPins[NUM_PINS];
+    memset(allPins, true, sizeof(allPins));
+    setOutputFrame(ledBuffers[0]);
+    showPins(allPins);
+
+#if STREAM_INPUT || SYNC_ROLE != SYNC_OFF
+    WiFi.mode(WIFI_STA);
+    WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
+#endif
+#if STREAM_INPUT
+    if (!beginStreamInput(E131_PORT)) {
+        Serial.println("stream input init failed");
+    }
+#endif
+#if SYNC_ROLE != SYNC_OFF
+    if (!beginSync(SYNC_ROLE, SYNC_PORT, SYNC_ADDRESS)) {
+        Serial.println("sync init failed");
+    }
+#endif
+
+    // Clips are played straight from flash
+    if (!mapClipPartition()) {
+        Serial.println("no clips partition");
+    }
+
+    mainProgram = loadMainProgram();
+    mainProgram->allocateState();
+    for (int i = 0; i < mainProgram->getNumSegments(); i++) {
+        Serial.print("segment ");
+        Serial.print(i);
+        Serial.print(" state bytes: ");
+        Serial.println((unsigned long)mainProgram->getSegmentStateBytes(i));
+    }
+    Serial.print("pattern arena bytes: ");
+    Serial.println((unsigned long)mainProgram->getArenaBytes());
+    mainProgram->setSeed(SHOW_SEED);
+#if DETERMINISTIC_TRACE
+    traceMainProgram();
+#endif
+    mainProgram->start(millis());
+
+#if RENDER_PIPELINE
+    // Arduino's loop() runs on core 1, so rendering goes to core 0
+    pipeline = new FramePipeline(mainProgram, &scheduler, ledBuffers[0], ledBuffers[1]);
+    pipeline->start(0);
+#endif
 }
 
-void loop() { mainProgram->update(); }
\ No newline at end of file
+void loop()
+{
+    static unsigned long lastReport = 0;
+    static bool firstFrameReported = false;
+
+    // The report below, profile dump included, is left out of the loop time
+    {
+        ProfileScope scope(PROFILE_PROBE_LOOP);
+#if RENDER_PIPELINE
+        pipeline->present();
+#else
+        syncBeforeFrame(scheduler, *mainProgram);
+        FrameTime time = scheduler.beginFrame();
+        mainProgram->update(time);
+        syncAfterFrame(scheduler, *mainProgram, time);
+        scheduler.endFrame();
+        // In the slack before the next frame slot, outside the frame's time
+        mainProgram->prepareNext();
+#endif
+    }
+#if RENDER_PIPELINE
+    float fps = pipeline->getFps();
+    unsigned long framesPresented = pipeline->getFramesPresented();
+#else
+    float fps = mainProgram->getFps();
+    unsigned long framesPresented = mainProgram->getFramesPresented();
+#endif
+
+    // micros() counts from reset, so this is the whole boot
+    if (!firstFrameReported && framesPresented > 0) {
+        firstFrameReported = true;
+        Serial.print("boot to first frame us: ");
+        Serial.println(micros());
+    }
+
+    unsigned long now = millis();
+    if (now - lastReport >= 10000) {
+        lastReport = now;
+        Serial.print("fps: ");
+        Serial.print(fps);
+        Serial.print(" overruns: ");
+        Serial.print(scheduler.getBudgetOverruns());
+        Serial.print(" skipped: ");
+        Serial.print(scheduler.getSkippedSlots());
+        Serial.print(" max frame us: ");
+        Serial.print(scheduler.getMaxFrameMicros());
+        Serial.print(" strips sent: ");
+        Serial.print(getStripsSent());
+        Serial.print(" skipped: ");
+        Serial.print(getStripsSkipped());
+        Serial.print(" mA: ");
+        Serial.print(getFrameMilliamps());
+        Serial.print(" demand mA: ");
+        Serial.print(getFrameDemandMilliamps());
+        Serial.print(" limited frames: ");
+        Serial.println(getLimitedFrames());
+#if STREAM_INPUT
+        const StreamCounters& stream = getStreamCounters();
+        Serial.print("stream frames: ");
+        Serial.print(stream.frames);
+        Serial.print(" incomplete: ");
+        Serial.print(stream.incompleteFrames);
+        Serial.print(" dropped: ");
+        Serial.print(stream.dropped);
+        Serial.print(" lost: ");
+        Serial.print(stream.lost);
+        Serial.print(" max latency us: ");
+        Serial.println(stream.maxLatencyMicros);
+        resetStreamCounters();
+#endif
+#if SYNC_ROLE == SYNC_FOLLOWER
+        const SyncCounters& sync = getSyncCounters();
+        Serial.print("sync beacons: ");
+        Serial.print(sync.beacons);
+        Serial.print(" lost: ");
+        Serial.print(sync.lost);
+        Serial.print(" steps: ");
+        Serial.print(sync.steps);
+        Serial.print(" joins: ");
+        Serial.print(sync.joins);
+        Serial.print(" error us: ");
+        Serial.print(sync.lastErrorMicros);
+        Serial.print(" max: ");
+        Serial.println(sync.maxErrorMicros);
+        resetSyncCounters();
+#endif
+#if FRAME_PROFILER
+        dumpProfile();
+#endif
+        scheduler.resetStats();
+        resetStripCounters();
+        resetPowerCounters();
+    }
+}
\ No newline at end of file
@@ -0,0 +1,405 @@
+#include "output.h"
+#include <FastLED.h>
+
+static bool renderDirty[NUM_PINS];
+static bool pinReversed[NUM_PINS];
+static bool pinHeld[NUM_PINS];
+static uint16_t pinRotation[NUM_PINS];
+static int sideFrames = 0;
+static uint8_t pinBrightness[NUM_PINS];
+static const ColorCorrection* stripCorrection[TOTAL_STRIPS];
+static bool outputStageReady = false;
+
+// Current limits in mA, 0 for none, and the scales that hold them. Per pin,
+// the estimate of what was last sent, what it would draw without limiting,
+// and what it would draw under its own limit alone.
+static uint32_t pinLimit[NUM_PINS];
+static uint32_t globalLimit = 0;
+static uint8_t pinLimitScale[NUM_PINS];
+static uint8_t globalLimitScale = 255;
+static uint32_t pinMilliamps[NUM_PINS];
+static uint32_t pinDemand[NUM_PINS];
+static uint32_t pinCappedDemand[NUM_PINS];
+static uint32_t frameMilliamps = 0;
+static uint32_t frameDemandMilliamps = 0;
+static unsigned long limitedFrames = 0;
+static CRGB* outputFrame = nullptr;
+static ParallelOutput* parallelOutput = nullptr;
+static unsigned long stripsSent = 0;
+static unsigned long stripsSkipped = 0;
+
+void markPinDirty(int pin) { renderDirty[pin] = true; }
+
+void takeDirtyPins(bool dirty[NUM_PINS])
+{
+    memcpy(dirty, renderDirty, sizeof(renderDirty));
+    memset(renderDirty, 0, sizeof(renderDirty));
+}
+
+bool anyPinDirty(const bool dirty[NUM_PINS])
+{
+    for (int pin = 0; pin < NUM_PINS; pin++) {
+        if (dirty[pin]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void setOutputFrame(CRGB* frame)
+{
+    outputFrame = frame;
+    for (int i = 0; i < FastLED.count(); i++) {
+        FastLED[i].setLeds(frame + pinOffset(i), pinLeds(i));
+    }
+}
+
+CRGB* getOutputFrame() { return outputFrame; }
+
+void ColorCorrection::build(float gamma, CRGB whiteBalance)
+{
+    for (int c = 0; c < 3; c++) {
+        for (int v = 0; v < 256; v++) {
+            lut[c][v] = (uint8_t)(powf(v / 255.0f, gamma) * whiteBalance.raw[c] + 0.5f);
+        }
+    }
+}
+
+static void initOutputStage()
+{
+    memset(pinBrightness, 255, sizeof(pinBrightness));
+    memset(pinLimitScale, 255, sizeof(pinLimitScale));
+    outputStageReady = true;
+}
+
+void setPinReversed(int pin, bool reversed)
+{
+    if (pinReversed[pin] != reversed) {
+        pinReversed[pin] = reversed;
+        markPinDirty(pin);
+    }
+}
+
+bool getPinReversed(int pin) { return pinReversed[pin]; }
+
+void setPinRotation(int pin, int rotation)
+{
+    if (pinRotation[pin] != rotation) {
+        pinRotation[pin] = rotation;
+        markPinDirty(pin);
+    }
+}
+
+int getPinRotation(int pin) { return pinRotation[pin]; }
+
+void beginSideFrame() { sideFrames++; }
+
+void endSideFrame() { sideFrames--; }
+
+bool renderingSideFrame() { return sideFrames > 0; }
+
+void setPinHeld(int pin, bool held) { pinHeld[pin] = held; }
+
+void setPinBrightness(int pin, uint8_t brightness)
+{
+    if (!outputStageReady) {
+        initOutputStage();
+    }
+    if (pinBrightness[pin] != brightness) {
+        pinBrightness[pin] = brightness;
+        markPinDirty(pin);
+    }
+}
+
+void setStripCorrection(int strip, const ColorCorrection* correction)
+{
+    stripCorrection[strip] = correction;
+    for (int pin = 0; pin < NUM_PINS; pin++) {
+        if (strip >= pinFirstStrip(pin) && strip < pinFirstStrip(pin) + pinStrips(pin)) {
+            markPinDirty(pin);
+        }
+    }
+}
+
+void setPinCurrentLimit(int pin, uint32_t milliamps)
+{
+    pinLimit[pin] = milliamps;
+    markPinDirty(pin);
+}
+
+void setCurrentLimit(uint32_t milliamps)
+{
+    globalLimit = milliamps;
+    for (int pin = 0; pin < NUM_PINS; pin++) {
+        markPinDirty(pin);
+    }
+}
+
+struct ChannelSums {
+    uint32_t r;
+    uint32_t g;
+    uint32_t b;
+};
+
+// Channel totals of a strip. 16 pixels at a time are added into 48 16-bit
+// lanes, which the compiler turns into vector adds, and the lanes are folded
+// into channels at the end. A lane takes 257 blocks before it can overflow.
+static_assert(MAX_STRIP_LEDS / 16 <= 257, "strip too long for 16-bit channel lanes");
+
+static void sumChannels(const CRGB* pixels, int count, ChannelSums& sums)
+{
+    const uint8_t* bytes = pixels[0].raw;
+    uint16_t lanes[48] = { 0 };
+    int blocks = count / 16;
+    for (int j = 0; j < blocks; j++) {
+        for (int k = 0; k < 48; k++) {
+            lanes[k] += bytes[48 * j + k];
+        }
+    }
+    for (int k = 0; k < 48; k += 3) {
+        sums.r += lanes[k];
+        sums.g += lanes[k + 1];
+        sums.b += lanes[k + 2];
+    }
+    for (int i = blocks * 16; i < count; i++) {
+        sums.r += pixels[i].r;
+        sums.g += pixels[i].g;
+        sums.b += pixels[i].b;
+    }
+}
+
+// One strip of the output pass. src walks the logical pixels by step, which is
+// -1 on reversed pins; the branches are hoisted so each loop is straight. The
+// strip is summed for the current estimate while it is still in cache.
+static void composeStrip(
+    CRGB* dst, const CRGB* src, int step, int count, const ColorCorrection* correction, uint8_t scale, ChannelSums& sums)
+{
+    if (correction != nullptr) {
+        const uint8_t* r = correction->lut[0];
+        const uint8_t* g = correction->lut[1];
+        const uint8_t* b = correction->lut[2];
+        if (scale == 255) {
+            for (int i = 0; i < count; i++, src += step) {
+                dst[i] = CRGB(r[src->r], g[src->g], b[src->b]);
+            }
+        } else {
+            for (int i = 0; i < count; i++, src += step) {
+                dst[i] = CRGB(scale8(r[src->r], scale), scale8(g[src->g], scale), scale8(b[src->b], scale));
+            }
+        }
+    } else if (scale == 255) {
+        if (step == 1) {
+            memcpy(dst, src, count * sizeof(CRGB));
+        } else {
+            for (int i = 0; i < count; i++, src += step) {
+                dst[i] = *src;
+            }
+        }
+    } else {
+        for (int i = 0; i < count; i++, src += step) {
+            dst[i] = CRGB(scale8(src->r, scale), scale8(src->g, scale), scale8(src->b, scale));
+        }
+    }
+
+    sumChannels(dst, count, sums);
+}
+
+// Largest scale that keeps a draw of demand within limit, the idle current
+// of the LEDs being out of reach of any scale
+static uint8_t limitScaleFor(uint32_t demand, uint32_t limit, int numLeds)
+{
+    uint32_t idle = IDLE_MILLIAMPS * numLeds;
+    if (limit == 0 || demand <= limit) {
+        return 255;
+    }
+    if (limit <= idle || demand <= idle) {
+        return 0;
+    }
+    return (uint8_t)((limit - idle) * 255 / (demand - idle));
+}
+
+// What a pin drawing light mA (above idle) at scale would draw at full scale
+static uint32_t unscaledDemand(int pin, uint32_t light, uint8_t scale, uint32_t previous)
+{
+    if (scale == 0) {
+        return previous;
+    }
+    return IDLE_MILLIAMPS * pinLeds(pin) + light * 255 / scale;
+}
+
+static void composePin(CRGB* target, int pin)
+{
+    // A reversed pin reads its logical pixels from the last one back, and a
+    // rotated one from its rotation on, wrapping round the end of the pin
+    const CRGB* src = leds + pinOffset(pin);
+    CRGB* dst = target + pinOffset(pin);
+    int length = pinLeds(pin);
+    int rotation = pinRotation[pin];
+    int step = pinReversed[pin] ? -1 : 1;
+
+    // Brightness and both limits fold into the one scale of the pass
+    uint8_t limitScale = scale8(pinLimitScale[pin], globalLimitScale);
+    uint8_t scale = scale8(pinBrightness[pin], limitScale);
+
+    ChannelSums sums = { 0, 0, 0 };
+    int stripLeds = pinStripLeds(pin);
+    for (int s = 0; s < pinStrips(pin); s++) {
+        // Where the strip's first pixel is read from, and runs up to the
+        // wrap; without a rotation the strip is a single run
+        int first = s * stripLeds;
+        int at = (step == 1 ? first : length - 1 - first) + rotation;
+        if (at >= length) {
+            at -= length;
+        }
+        for (int done = 0; done < stripLeds;) {
+            int run = min(stripLeds - done, step == 1 ? length - at : at + 1);
+            composeStrip(
+                dst + first + done, src + at, step, run, stripCorrection[pinFirstStrip(pin) + s], scale, sums);
+            done += run;
+            at = step == 1 ? 0 : length - 1;
+        }
+    }
+
+    uint32_t light = (RED_MILLIAMPS * sums.r + GREEN_MILLIAMPS * sums.g + BLUE_MILLIAMPS * sums.b) / 255;
+    pinMilliamps[pin] = IDLE_MILLIAMPS * pinLeds(pin) + light;
+    pinDemand[pin] = unscaledDemand(pin, light, limitScale, pinDemand[pin]);
+    pinCappedDemand[pin] = unscaledDemand(pin, light, globalLimitScale, pinCappedDemand[pin]);
+}
+
+void composeFrame(CRGB* target, bool dirty[NUM_PINS])
+{
+    if (target == nullptr) {
+        return;
+    }
+    if (!outputStageReady) {
+        initOutputStage();
+    }
+
+    bool limited = false;
+    for (int pin = 0; pin < NUM_PINS; pin++) {
+        if (pinHeld[pin]) {
+            dirty[pin] = false;
+        }
+        if (!dirty[pin]) {
+            continue;
+        }
+        composePin(target, pin);
+
+        // Limits are predicted from the pin's last demand. A pin that came
+        // out over its limit is composed again at once; one that may go
+        // brighter is raised the next time it is composed.
+        if (pinLimit[pin] != 0) {
+            uint8_t limitScale = limitScaleFor(pinDemand[pin], pinLimit[pin], pinLeds(pin));
+            if (pinMilliamps[pin] > pinLimit[pin]) {
+                pinLimitScale[pin] = limitScale;
+                composePin(target, pin);
+            } else if (limitScale > pinLimitScale[pin]) {
+                pinLimitScale[pin] = limitScale;
+            }
+            limited |= pinLimitScale[pin] < 255;
+        }
+    }
+
+    // Static pins draw what they drew when they were last sent
+    uint32_t total = 0;
+    uint32_t demand = 0;
+    uint32_t capped = 0;
+    for (int pin = 0; pin < NUM_PINS; pin++) {
+        total += pinMilliamps[pin];
+        demand += pinDemand[pin];
+        capped += pinCappedDemand[pin];
+    }
+
+    // The global limit scales every pin, so when it moves all pins are
+    // composed and sent again: at once when the frame is over the limit, on
+    // the next frame when there is room to go brighter
+    if (globalLimit != 0) {
+        uint8_t limitScale = limitScaleFor(capped, globalLimit, TOTAL_LEDS);
+        if (total > globalLimit) {
+            globalLimitScale = limitScale;
+            total = 0;
+            for (int pin = 0; pin < NUM_PINS; pin++) {
+                if (!pinHeld[pin]) {
+                    composePin(target, pin);
+                    dirty[pin] = true;
+                }
+                total += pinMilliamps[pin];
+            }
+        } else if (limitScale >= globalLimitScale + GLOBAL_LIMIT_HYSTERESIS
+            || (limitScale == 255 && globalLimitScale != 255)) {
+            globalLimitScale = limitScale;
+            for (int pin = 0; pin < NUM_PINS; pin++) {
+                markPinDirty(pin);
+            }
+        }
+        limited |= globalLimitScale < 255;
+    }
+
+    frameMilliamps = total;
+    frameDemandMilliamps = demand;
+    if (limited) {
+        limitedFrames++;
+    }
+}
+
+uint32_t getFrameMilliamps() { return frameMilliamps; }
+
+uint32_t getFrameDemandMilliamps() { return frameDemandMilliamps; }
+
+uint32_t getPinMilliamps(int pin) { return pinMilliamps[pin]; }
+
+unsigned long getLimitedFrames() { return limitedFrames; }
+
+void resetPowerCounters() { limitedFrames = 0; }
+
+void useParallelOutput(ParallelOutput* output) { parallelOutput = output; }
+
+bool outputBusy() { return parallelOutput != nullptr && parallelOutput->isBusy(); }
+
+static void showParallel(const bool dirty[NUM_PINS])
+{
+    for (int pin = 0; pin < NUM_PINS; pin++) {
+        if (dirty[pin]) {
+            stripsSent++;
+        } else {
+            stripsSkipped++;
+        }
+    }
+    parallelOutput->show(outputFrame, dirty);
+}
+
+void showPins(const bool dirty[NUM_PINS])
+{
+    if (parallelOutput != nullptr) {
+        showParallel(dirty);
+        return;
+    }
+
+    if (!anyPinDirty(dirty)) {
+        stripsSkipped += FastLED.count();
+        return;
+    }
+
+    // Disabled controllers are passed over by show() and keep what they
+    // last sent
+    for (int i = 0; i < FastLED.count(); i++) {
+        bool send = i < NUM_PINS && dirty[i];
+        FastLED[i].setEnabled(send);
+        if (send) {
+            stripsSent++;
+        } else {
+            stripsSkipped++;
+        }
+    }
+    FastLED.show();
+}
+
+unsigned long getStripsSent() { return stripsSent; }
+
+unsigned long getStripsSkipped() { return stripsSkipped; }
+
+void resetStripCounters()
+{
+    stripsSent = 0;
+    stripsSkipped = 0;
+}
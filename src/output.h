@@ -0,0 +1,93 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include "parallel_output.h"
+#include "patterns.h"
+
+// Patterns mark every pin they write with markPinDirty() while a frame
+// renders. Once the frame is finished the presenter takes that set with
+// takeDirtyPins() and sends it with showPins(), which drives only the
+// controllers of changed pins. Controller i drives pin i.
+void takeDirtyPins(bool dirty[NUM_PINS]);
+bool anyPinDirty(const bool dirty[NUM_PINS]);
+void showPins(const bool dirty[NUM_PINS]);
+
+// Frame that showPins() sends, pin i at frame + pinOffset(i)
+void setOutputFrame(CRGB* frame);
+CRGB* getOutputFrame();
+
+// Gamma and white balance of one strip as a table per channel
+struct ColorCorrection {
+    uint8_t lut[3][256];
+
+    void build(float gamma, CRGB whiteBalance);
+};
+
+// The output stage turns the logical frame in leds[] into what goes on the
+// wire. composeFrame() does it for the given pins in one pass: mirroring
+// reversed pins, each strip's color correction, then the pin's brightness.
+// Strips without a correction are sent as rendered. Changing any of these
+// marks the pin dirty so it is composed and sent again.
+void setPinReversed(int pin, bool reversed);
+bool getPinReversed(int pin);
+void setPinBrightness(int pin, uint8_t brightness);
+// strip counts across pins, from pinFirstStrip() of each
+void setStripCorrection(int strip, const ColorCorrection* correction);
+void composeFrame(CRGB* target, bool dirty[NUM_PINS]);
+
+// A pattern that keeps a pin as a ring can leave it rotated in leds[] and
+// have composeFrame() turn it round, so a step writes one pixel instead of
+// the whole pin: the pin's logical pixel i is read from (i + rotation) %
+// its length. Only the frame composeFrame() reads may be left rotated.
+// While leds[] points at any other, as through a transition or into a
+// layer, the renderer brackets it with beginSideFrame() and endSideFrame(),
+// and patterns write their pins in order.
+void setPinRotation(int pin, int rotation);
+int getPinRotation(int pin);
+void beginSideFrame();
+void endSideFrame();
+bool renderingSideFrame();
+
+// A held pin is left out of composeFrame() and dropped from its dirty set,
+// so the strip keeps what it last showed. Patterns that fill leds[] over
+// several frames hold their pins until the frame is whole.
+void setPinHeld(int pin, bool held);
+
+// WS2812B draw per channel at full drive and per LED at rest, as in FastLED's
+// power model
+#define RED_MILLIAMPS 16
+#define GREEN_MILLIAMPS 11
+#define BLUE_MILLIAMPS 15
+#define IDLE_MILLIAMPS 1
+// Levels the global limit scale has to be able to rise before all pins are
+// sent again at the brighter scale
+#define GLOBAL_LIMIT_HYSTERESIS 8
+
+// Current limits in mA, 0 for none. composeFrame() estimates each pin's draw
+// from the channels it writes and holds it under the limits by folding a
+// limit scale into the pin's brightness. A frame that comes out over a limit
+// is composed again at the lower scale before it is sent, and may add pins
+// to the dirty set when the global limit has to scale all of them.
+void setPinCurrentLimit(int pin, uint32_t milliamps);
+void setCurrentLimit(uint32_t milliamps);
+
+// Estimates of the last composed frame: what the strips draw as sent and
+// what they would draw without limits
+uint32_t getFrameMilliamps();
+uint32_t getFrameDemandMilliamps();
+uint32_t getPinMilliamps(int pin);
+// Frames composed with a limit holding some pin down
+unsigned long getLimitedFrames();
+void resetPowerCounters();
+
+// Sends through a ParallelOutput instead of the FastLED controllers. Its
+// show() returns once the transfer is queued; outputBusy() is its fence.
+void useParallelOutput(ParallelOutput* output);
+bool outputBusy();
+
+// Strips sent and left alone by showPins(), for seeing the wire time saved
+unsigned long getStripsSent();
+unsigned long getStripsSkipped();
+void resetStripCounters();
+
+#endif
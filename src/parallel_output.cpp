@@ -0,0 +1,289 @@
+#include "parallel_output.h"
+#include "output.h"
+#include <Arduino.h>
+
+#ifdef ARDUINO_ARCH_ESP32
+#include <driver/periph_ctrl.h>
+#include <esp32/rom/gpio.h>
+#include <esp32/rom/lldesc.h>
+#include <esp_heap_caps.h>
+#include <esp_intr_alloc.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <soc/gpio_sig_map.h>
+#include <soc/i2s_struct.h>
+
+// A DMA descriptor carries at most 4095 bytes; keep whole 32-bit words
+#define DMA_CHUNK_BYTES 4092
+#define STREAM_BYTES (PARALLEL_STREAM_SLOTS * sizeof(uint16_t))
+#define NUM_DESCRIPTORS ((STREAM_BYTES + DMA_CHUNK_BYTES - 1) / DMA_CHUNK_BYTES)
+
+// In 16-bit LCD mode I2S sends the upper half of every 32-bit word first
+#define SLOT_INDEX(slot) ((slot) ^ 1)
+
+static lldesc_t* descriptors = nullptr;
+static intr_handle_t interruptHandle = nullptr;
+// Given by the interrupt as each transfer ends, for wait() to block on
+static SemaphoreHandle_t transferDone = nullptr;
+#else
+#include <chrono>
+
+#define SLOT_INDEX(slot) (slot)
+#endif
+
+ParallelOutput::ParallelOutput(const int* dataPins, int laneCount)
+    : numLanes(min(laneCount, PARALLEL_LANES))
+    , stream(nullptr)
+    , busy(false)
+    , doneCallback(nullptr)
+    , doneArg(nullptr)
+    , transfers(0)
+    , encodeMicros(0)
+    , waitMicros(0)
+{
+    for (int i = 0; i < numLanes; i++) {
+        pins[i] = dataPins[i];
+    }
+}
+
+ParallelOutput::~ParallelOutput()
+{
+    wait();
+#ifdef ARDUINO_ARCH_ESP32
+    heap_caps_free(stream);
+#else
+    delete[] stream;
+#endif
+}
+
+// Bit b of lane l's byte lands in byte b of the result at bit l, so each
+// result byte is one bit plane across the lanes
+static inline uint64_t transposeLanes(uint64_t x)
+{
+    x = (x & 0xAA55AA55AA55AA55ULL) | ((x & 0x00AA00AA00AA00AAULL) << 7) | ((x >> 7) & 0x00AA00AA00AA00AAULL);
+    x = (x & 0xCCCC3333CCCC3333ULL) | ((x & 0x0000CCCC0000CCCCULL) << 14) | ((x >> 14) & 0x0000CCCC0000CCCCULL);
+    x = (x & 0xF0F0F0F00F0F0F0FULL) | ((x & 0x00000000F0F0F0F0ULL) << 28) | ((x >> 28) & 0x00000000F0F0F0F0ULL);
+    return x;
+}
+
+void ParallelOutput::encode(const CRGB* frame, const bool dirty[NUM_PINS])
+{
+    // WS2812B takes green, red, blue, each most significant bit first
+    static const int channelOrder[3] = { 1, 0, 2 };
+
+    uint16_t laneMask = 0;
+    for (int lane = 0; lane < numLanes && lane < NUM_PINS; lane++) {
+        if (dirty[lane]) {
+            laneMask |= 1 << lane;
+        }
+    }
+
+    int slot = 0;
+    for (int i = 0; i < MAX_LEDS_PER_PIN; i++) {
+        for (int c = 0; c < 3; c++) {
+            uint64_t lanes = 0;
+            for (int lane = 0; lane < numLanes && lane < NUM_PINS; lane++) {
+                if (i < pinLeds(lane)) {
+                    lanes |= (uint64_t)frame[pinOffset(lane) + i].raw[channelOrder[c]] << (8 * lane);
+                }
+            }
+            uint64_t planes = transposeLanes(lanes);
+
+            for (int bit = 7; bit >= 0; bit--) {
+                stream[SLOT_INDEX(slot)] = laneMask;
+                stream[SLOT_INDEX(slot + 1)] = (planes >> (8 * bit)) & laneMask;
+                stream[SLOT_INDEX(slot + 2)] = 0;
+                slot += PARALLEL_SLOTS_PER_BIT;
+            }
+        }
+    }
+}
+
+void ParallelOutput::show(const CRGB* frame, const bool dirty[NUM_PINS])
+{
+    if (stream == nullptr || !anyPinDirty(dirty)) {
+        return;
+    }
+
+    unsigned long begin = micros();
+    wait();
+    unsigned long encodeBegin = micros();
+    waitMicros += encodeBegin - begin;
+
+    encode(frame, dirty);
+    encodeMicros += micros() - encodeBegin;
+
+    busy.store(true, std::memory_order_release);
+    transfers++;
+    startTransfer();
+}
+
+bool ParallelOutput::isBusy() { return busy.load(std::memory_order_acquire); }
+
+void ParallelOutput::onDone(DoneCallback callback, void* arg)
+{
+    doneCallback = callback;
+    doneArg = arg;
+}
+
+// Runs in the interrupt on the ESP32, so it is kept in IRAM
+void IRAM_ATTR ParallelOutput::finishTransfer()
+{
+    busy.store(false, std::memory_order_release);
+    if (doneCallback) {
+        doneCallback(doneArg);
+    }
+}
+
+unsigned long ParallelOutput::getTransfers() { return transfers; }
+
+unsigned long ParallelOutput::getEncodeMicros() { return encodeMicros; }
+
+unsigned long ParallelOutput::getWaitMicros() { return waitMicros; }
+
+void ParallelOutput::resetCounters()
+{
+    transfers = 0;
+    encodeMicros = 0;
+    waitMicros = 0;
+}
+
+#ifdef ARDUINO_ARCH_ESP32
+
+bool ParallelOutput::begin()
+{
+    stream = static_cast<uint16_t*>(heap_caps_calloc(PARALLEL_STREAM_SLOTS, sizeof(uint16_t), MALLOC_CAP_DMA));
+    descriptors = static_cast<lldesc_t*>(heap_caps_calloc(NUM_DESCRIPTORS, sizeof(lldesc_t), MALLOC_CAP_DMA));
+    transferDone = xSemaphoreCreateBinary();
+    if (stream == nullptr || descriptors == nullptr || transferDone == nullptr) {
+        return false;
+    }
+
+    // One chain over the whole stream, raising EOF at its end
+    uint8_t* bytes = reinterpret_cast<uint8_t*>(stream);
+    for (int d = 0; d < NUM_DESCRIPTORS; d++) {
+        size_t length = min((size_t)DMA_CHUNK_BYTES, STREAM_BYTES - d * DMA_CHUNK_BYTES);
+        descriptors[d].size = length;
+        descriptors[d].length = length;
+        descriptors[d].owner = 1;
+        descriptors[d].sosf = 0;
+        descriptors[d].offset = 0;
+        descriptors[d].eof = d == NUM_DESCRIPTORS - 1;
+        descriptors[d].buf = bytes + d * DMA_CHUNK_BYTES;
+        descriptors[d].qe.stqe_next = d == NUM_DESCRIPTORS - 1 ? nullptr : &descriptors[d + 1];
+    }
+
+    periph_module_enable(PERIPH_I2S0_MODULE);
+
+    I2S0.conf.tx_reset = 1;
+    I2S0.conf.tx_reset = 0;
+    I2S0.conf.tx_fifo_reset = 1;
+    I2S0.conf.tx_fifo_reset = 0;
+    I2S0.lc_conf.out_rst = 1;
+    I2S0.lc_conf.out_rst = 0;
+    I2S0.lc_conf.ahbm_rst = 1;
+    I2S0.lc_conf.ahbm_rst = 0;
+
+    // LCD mode, 16-bit samples, one sample per slot
+    I2S0.conf2.val = 0;
+    I2S0.conf2.lcd_en = 1;
+    I2S0.sample_rate_conf.val = 0;
+    I2S0.sample_rate_conf.tx_bits_mod = 16;
+    I2S0.fifo_conf.val = 0;
+    I2S0.fifo_conf.tx_fifo_mod_force_en = 1;
+    I2S0.fifo_conf.tx_fifo_mod = 1;
+    I2S0.fifo_conf.tx_data_num = 32;
+    I2S0.fifo_conf.dscr_en = 1;
+    I2S0.conf1.val = 0;
+    I2S0.conf1.tx_pcm_bypass = 1;
+    I2S0.conf_chan.val = 0;
+    I2S0.conf_chan.tx_chan_mod = 1;
+    I2S0.timing.val = 0;
+    I2S0.lc_conf.out_eof_mode = 1;
+
+    // 160MHz / (33 + 1/3) / 2 gives 2.4MHz slots, three to a 1.25us bit
+    I2S0.clkm_conf.val = 0;
+    I2S0.clkm_conf.clka_en = 0;
+    I2S0.clkm_conf.clkm_div_num = 33;
+    I2S0.clkm_conf.clkm_div_b = 1;
+    I2S0.clkm_conf.clkm_div_a = 3;
+    I2S0.sample_rate_conf.tx_bck_div_num = 1;
+
+    // 16-bit samples come out on DATA_OUT8 upwards
+    for (int lane = 0; lane < numLanes; lane++) {
+        pinMode(pins[lane], OUTPUT);
+        gpio_matrix_out(pins[lane], I2S0O_DATA_OUT8_IDX + lane, false, false);
+    }
+
+    I2S0.int_clr.val = 0xFFFFFFFF;
+    I2S0.int_ena.val = 0;
+    I2S0.int_ena.out_total_eof = 1;
+    // In IRAM so the interrupt can still run while flash is being written
+    return esp_intr_alloc(ETS_I2S0_INTR_SOURCE, ESP_INTR_FLAG_LEVEL1 | ESP_INTR_FLAG_IRAM, interruptHandler, this,
+               &interruptHandle)
+        == ESP_OK;
+}
+
+void ParallelOutput::startTransfer()
+{
+    I2S0.lc_conf.out_rst = 1;
+    I2S0.lc_conf.out_rst = 0;
+    I2S0.conf.tx_fifo_reset = 1;
+    I2S0.conf.tx_fifo_reset = 0;
+    I2S0.out_link.addr = reinterpret_cast<uint32_t>(&descriptors[0]);
+    I2S0.out_link.start = 1;
+    I2S0.conf.tx_start = 1;
+}
+
+void IRAM_ATTR ParallelOutput::interruptHandler(void* arg)
+{
+    ParallelOutput* output = static_cast<ParallelOutput*>(arg);
+    BaseType_t woken = pdFALSE;
+    if (I2S0.int_st.out_total_eof) {
+        I2S0.conf.tx_start = 0;
+        output->finishTransfer();
+        xSemaphoreGiveFromISR(transferDone, &woken);
+    }
+    I2S0.int_clr.val = I2S0.int_st.val;
+    if (woken) {
+        portYIELD_FROM_ISR();
+    }
+}
+
+// Blocks the calling task until the interrupt gives transferDone. A give left
+// from a transfer nobody waited on is taken on the way and the wait goes on.
+void ParallelOutput::wait()
+{
+    while (isBusy()) {
+        xSemaphoreTake(transferDone, portMAX_DELAY);
+    }
+}
+
+#else
+
+bool ParallelOutput::begin()
+{
+    stream = new uint16_t[PARALLEL_STREAM_SLOTS]();
+    return true;
+}
+
+// The mock transfer holds the wire for as long as the longest pin's chain
+// takes to clock out, which is the whole stream's time since the lanes run
+// together
+void ParallelOutput::startTransfer()
+{
+    unsigned long wireMicros = hostIsModellingWireTime() ? MAX_LEDS_PER_PIN * WS2812B_MICROS_PER_LED : 0;
+    transferThread = std::thread([this, wireMicros]() {
+        std::this_thread::sleep_for(std::chrono::microseconds(wireMicros));
+        finishTransfer();
+    });
+}
+
+void ParallelOutput::wait()
+{
+    if (transferThread.joinable()) {
+        transferThread.join();
+    }
+}
+
+#endif
@@ -0,0 +1,77 @@
+#ifndef PARALLEL_OUTPUT_H
+#define PARALLEL_OUTPUT_H
+
+#include "patterns.h"
+#include <atomic>
+
+#ifndef ARDUINO_ARCH_ESP32
+#include <thread>
+#endif
+
+// Up to 8 pins clocked out together as one parallel stream, lane i carrying
+// pin i. The stream is as long as the longest pin; shorter pins are sent
+// black past their end, which nothing latches. Every WS2812B bit becomes three stream slots (high, data, low), so
+// one sample per slot holds that slot for all lanes at once. On the ESP32
+// the stream goes out through I2S0 in LCD mode by DMA; on the host a mock
+// transfer takes the WS2812B wire time of one pin and then completes.
+#define PARALLEL_LANES 8
+#define PARALLEL_SLOTS_PER_BIT 3
+#define PARALLEL_SLOTS_PER_LED (24 * PARALLEL_SLOTS_PER_BIT)
+// Low slots after the data so the strips latch, 300us at 2.4MHz
+#define PARALLEL_RESET_SLOTS 720
+#define PARALLEL_STREAM_SLOTS (MAX_LEDS_PER_PIN * PARALLEL_SLOTS_PER_LED + PARALLEL_RESET_SLOTS)
+
+// show() encodes the frame into the stream buffer before it returns, so the
+// frame it was given is free again straight away. The fence is the transfer
+// itself: isBusy() and wait() tell when the wire is free, and the done
+// callback fires as it finishes. On the ESP32 wait() blocks the task until
+// the DMA interrupt says so, and the callback runs in that interrupt, so it
+// must be IRAM_ATTR and must not block. A show() issued while a transfer is
+// running waits for it first.
+//
+// Lanes of pins left out of the dirty set stay low for the whole transfer,
+// which leaves those strips on what they last latched.
+class ParallelOutput {
+public:
+    typedef void (*DoneCallback)(void* arg);
+
+    ParallelOutput(const int* dataPins, int laneCount);
+    ~ParallelOutput();
+
+    bool begin();
+    void show(const CRGB* frame, const bool dirty[NUM_PINS]);
+    bool isBusy();
+    void wait();
+    void onDone(DoneCallback callback, void* arg);
+
+    unsigned long getTransfers();
+    // Time show() spent encoding, and waiting on an earlier transfer
+    unsigned long getEncodeMicros();
+    unsigned long getWaitMicros();
+    void resetCounters();
+
+private:
+    int pins[PARALLEL_LANES];
+    int numLanes;
+    uint16_t* stream;
+    std::atomic<bool> busy;
+    DoneCallback doneCallback;
+    void* doneArg;
+    unsigned long transfers;
+    unsigned long encodeMicros;
+    unsigned long waitMicros;
+
+#ifndef ARDUINO_ARCH_ESP32
+    std::thread transferThread;
+#endif
+
+    void encode(const CRGB* frame, const bool dirty[NUM_PINS]);
+    void startTransfer();
+    void finishTransfer();
+
+#ifdef ARDUINO_ARCH_ESP32
+    static void interruptHandler(void* arg);
+#endif
+};
+
+#endif
@@ -1,24 +1,298 @@
 #ifndef PATTERNS_H
 #define PATTERNS_H
 
+#include "arena.h"
+#include "geometry.h"
+#include "rng.h"
+#include "scheduler.h"
 #include <FastLED.h>
+#include <stddef.h>
+#include <string.h>
 
-#define NUM_LEDS_PER_STRIP 122
-#define NUM_STRIPS_PER_PIN 2
+// Render target for the frame being built. It points into one of the frame
+// buffers owned by whoever drives the Program, and may change between frames.
+extern CRGB* leds;
 
-extern CRGB leds[];
+// Records that a pin's pixels changed in the frame being built, so that only
+// changed strips are sent. Patterns call it for every pin they write.
+void markPinDirty(int pin);
 
-void breathingPattern(int pins[], int numPins, int speed, CRGB palette[], int paletteSize, bool reverse = false);
-void flamepattern(int pins[], int numPins, int speed, int cooling, int sparking, bool reverse = false);
-void growPattern(int pins[], int numPins, int speed, int n, int fadeDelay, int holdDelay, CRGB palette[],
-    int paletteSize, int transitionSpeed, int offsetDelay, bool reverse = false);
-void popPattern(int pins[], int numPins, int speed, int holdDelay, CRGB palette[], int paletteSize, bool random, int accelerationTime, bool reverse = false);
-void spinPattern(int pins[], int numPins, int speed, int separation, int span, CRGB palette[], int paletteSize, bool loop, bool continuous, bool blend, bool reverse = false);
+// Patterns only write into leds[], in logical order from the start of each
+// pin. Mirroring reversed pins, color correction and brightness are done by
+// the output stage, so reverse only matters to patterns that order things
+// across pins. Pushing the frame out is left to the Program. Each returns
+// true when it changed the pixels of its pins. Time comes in through
+// FrameTime and never from millis(), and speeds are turned into steps per
+// second so the motion does not depend on the frame rate.
+//
+// Each PatternInstance owns a state block of stateSize(numPins) bytes from
+// the Program's arena. State is kept per pin slot of the instance, not per
+// output pin, and reset() clears only that block. prepare() is reset() plus
+// any setup that needs the pins or params, and is how a Program readies a
+// segment ahead of its start; it must not depend on the time. Patterns that
+// use random numbers draw them from a PatternRandom in their state, seeded
+// from prepare()'s seed, never from random8() or rand().
 
-void resetBreathingPattern();
-void resetFlamePattern();
-void resetGrowPattern();
-void resetPopPattern();
-void resetSpinPattern();
+// One member of a params struct, by name, for building params from a show
+// file. A palette covers both the CRGB* and its size member. An int has the
+// range a show may give it, checked when the show is loaded, so patterns can
+// trust params that came from an image.
+enum ParamType { PARAM_INT, PARAM_BOOL, PARAM_PALETTE };
 
-#endif
\ No newline at end of file
+struct ParamField {
+    const char* name;
+    uint8_t type;
+    uint16_t offset;
+    uint16_t sizeOffset;
+    int32_t min;
+    int32_t max;
+};
+
+#define PARAM_INT_FIELD(P, member, min, max) { #member, PARAM_INT, offsetof(P, member), 0, min, max }
+#define PARAM_BOOL_FIELD(P, member) { #member, PARAM_BOOL, offsetof(P, member), 0, 0, 0 }
+#define PARAM_PALETTE_FIELD(P, member, size) { #member, PARAM_PALETTE, offsetof(P, member), offsetof(P, size), 0, 0 }
+#define PARAM_FIELDS_END { nullptr, 0, 0, 0, 0, 0 }
+
+// Ranges shared by several patterns' params. Speeds run from 1, slowest, to
+// 100, and 0 stops the patterns that take it; delays are in milliseconds.
+#define PARAM_MAX_SPEED 100
+#define PARAM_MAX_MILLIS 3600000
+#define PARAM_MAX_SECONDS 3600
+
+// What a PatternInstance calls through. There is one table per pattern type,
+// built at compile time by PatternBase, so dispatch is a single indirect call
+// with the params passed as they are stored.
+struct PatternOps {
+    const char* name;
+    size_t paramsSize;
+    // Ends with PARAM_FIELDS_END
+    const ParamField* fields;
+    size_t (*stateSize)(int numPins);
+    void (*reset)(void* state, int numPins);
+    void (*prepare)(void* state, int pins[], int numPins, const void* params, bool reverse, uint32_t seed);
+    bool (*render)(
+        const FrameTime& time, void* state, int pins[], int numPins, const void* params, bool reverse);
+};
+
+// A pattern derives from PatternBase<Itself, ItsParams> and provides static
+// name(), fields[], stateSize(), reset() and render(), and prepare() if it has
+// setup beyond reset(). Its params struct names the pattern as Pattern so a
+// PatternInstance can be built from the params alone.
+template <typename Derived, typename P> struct PatternBase {
+    typedef P Params;
+    static const PatternOps ops;
+
+    static void prepare(void* state, int pins[], int numPins, const P& params, bool reverse, uint32_t seed)
+    {
+        Derived::reset(state, numPins);
+    }
+
+private:
+    static void prepareParams(void* state, int pins[], int numPins, const void* params, bool reverse, uint32_t seed)
+    {
+        Derived::prepare(state, pins, numPins, *static_cast<const P*>(params), reverse, seed);
+    }
+    static bool renderParams(
+        const FrameTime& time, void* state, int pins[], int numPins, const void* params, bool reverse)
+    {
+        return Derived::render(time, state, pins, numPins, *static_cast<const P*>(params), reverse);
+    }
+};
+
+template <typename Derived, typename P>
+const PatternOps PatternBase<Derived, P>::ops
+    = { Derived::name(), sizeof(P), Derived::fields, Derived::stateSize, Derived::reset,
+          PatternBase<Derived, P>::prepareParams, PatternBase<Derived, P>::renderParams };
+
+struct BreathingPattern;
+struct BreathingParams {
+    typedef BreathingPattern Pattern;
+    int speed;
+    CRGB* palette;
+    int paletteSize;
+};
+struct BreathingPattern : PatternBase<BreathingPattern, BreathingParams> {
+    static const ParamField fields[];
+    static constexpr const char* name() { return "breathing"; }
+    static size_t stateSize(int numPins);
+    static void reset(void* state, int numPins);
+    static bool render(const FrameTime& time, void* state, int pins[], int numPins,
+        const BreathingParams& params, bool reverse = false);
+};
+
+struct FlamePattern;
+struct FlameParams {
+    typedef FlamePattern Pattern;
+    int speed;
+    int cooling;
+    int sparking;
+};
+struct FlamePattern : PatternBase<FlamePattern, FlameParams> {
+    static const ParamField fields[];
+    static constexpr const char* name() { return "flame"; }
+    static size_t stateSize(int numPins);
+    static void reset(void* state, int numPins);
+    // Also seeds the flicker and cooling noise
+    static void prepare(void* state, int pins[], int numPins, const FlameParams& params, bool reverse, uint32_t seed);
+    static bool render(const FrameTime& time, void* state, int pins[], int numPins,
+        const FlameParams& params, bool reverse = false);
+};
+
+struct GrowPattern;
+struct GrowParams {
+    typedef GrowPattern Pattern;
+    int speed;
+    int n;
+    int fadeDelay;
+    int holdDelay;
+    CRGB* palette;
+    int paletteSize;
+    int transitionSpeed;
+    int offsetDelay;
+};
+struct GrowPattern : PatternBase<GrowPattern, GrowParams> {
+    static const ParamField fields[];
+    static constexpr const char* name() { return "grow"; }
+    static size_t stateSize(int numPins);
+    static void reset(void* state, int numPins);
+    static bool render(const FrameTime& time, void* state, int pins[], int numPins,
+        const GrowParams& params, bool reverse = false);
+};
+
+// Runs of palette color that move along each pin, the head color blending
+// through the palette as in grow
+struct ChasePattern;
+struct ChaseParams {
+    typedef ChasePattern Pattern;
+    int speed;
+    CRGB* palette;
+    int paletteSize;
+    int transitionSpeed;
+    int holdDelay;
+    int offsetDelay;
+};
+struct ChasePattern : PatternBase<ChasePattern, ChaseParams> {
+    static const ParamField fields[];
+    static constexpr const char* name() { return "chase"; }
+    static size_t stateSize(int numPins);
+    static void reset(void* state, int numPins);
+    static bool render(const FrameTime& time, void* state, int pins[], int numPins,
+        const ChaseParams& params, bool reverse = false);
+};
+
+struct PopPattern;
+struct PopParams {
+    typedef PopPattern Pattern;
+    int speed;
+    int holdDelay;
+    CRGB* palette;
+    int paletteSize;
+    bool random;
+    int accelerationTime;
+};
+struct PopPattern : PatternBase<PopPattern, PopParams> {
+    static const ParamField fields[];
+    static constexpr const char* name() { return "pop"; }
+    static size_t stateSize(int numPins);
+    static void reset(void* state, int numPins);
+    // Also seeds the shuffles and builds the first pin sequence
+    static void prepare(void* state, int pins[], int numPins, const PopParams& params, bool reverse, uint32_t seed);
+    static bool render(const FrameTime& time, void* state, int pins[], int numPins,
+        const PopParams& params, bool reverse = false);
+};
+
+struct SpinPattern;
+struct SpinParams {
+    typedef SpinPattern Pattern;
+    int speed;
+    int separation;
+    int span;
+    CRGB* palette;
+    int paletteSize;
+    bool loop;
+    bool continuous;
+    bool blend;
+};
+struct SpinPattern : PatternBase<SpinPattern, SpinParams> {
+    static const ParamField fields[];
+    static constexpr const char* name() { return "spin"; }
+    static size_t stateSize(int numPins);
+    static void reset(void* state, int numPins);
+    // Also builds the gradient LUT of the continuous and loop modes
+    static void prepare(void* state, int pins[], int numPins, const SpinParams& params, bool reverse, uint32_t seed);
+    static bool render(const FrameTime& time, void* state, int pins[], int numPins,
+        const SpinParams& params, bool reverse = false);
+};
+
+// Plays a pre-rendered clip from the clip region (see clip.h), clip pin k on
+// the instance's k-th pin
+struct PlaybackPattern;
+struct PlaybackParams {
+    typedef PlaybackPattern Pattern;
+    // Index of the clip in the region
+    int clip;
+    bool loop;
+};
+struct PlaybackPattern : PatternBase<PlaybackPattern, PlaybackParams> {
+    static const ParamField fields[];
+    static constexpr const char* name() { return "playback"; }
+    static size_t stateSize(int numPins);
+    static void reset(void* state, int numPins);
+    // Also finds the clip in the region
+    static void prepare(
+        void* state, int pins[], int numPins, const PlaybackParams& params, bool reverse, uint32_t seed);
+    static bool render(const FrameTime& time, void* state, int pins[], int numPins,
+        const PlaybackParams& params, bool reverse = false);
+};
+
+// Plays pixels streamed over E1.31 (see stream_input.h), starting at the
+// given universe
+struct StreamPattern;
+struct StreamParams {
+    typedef StreamPattern Pattern;
+    int universe;
+};
+struct StreamPattern : PatternBase<StreamPattern, StreamParams> {
+    static const ParamField fields[];
+    static constexpr const char* name() { return "stream"; }
+    static size_t stateSize(int numPins);
+    static void reset(void* state, int numPins);
+    static bool render(const FrameTime& time, void* state, int pins[], int numPins,
+        const StreamParams& params, bool reverse = false);
+};
+
+// Each pattern's ops table is instantiated in its own .cpp, where render() is
+// visible and gets inlined into the table's entry
+extern template struct PatternBase<BreathingPattern, BreathingParams>;
+extern template struct PatternBase<FlamePattern, FlameParams>;
+extern template struct PatternBase<GrowPattern, GrowParams>;
+extern template struct PatternBase<ChasePattern, ChaseParams>;
+extern template struct PatternBase<PopPattern, PopParams>;
+extern template struct PatternBase<SpinPattern, SpinParams>;
+extern template struct PatternBase<PlaybackPattern, PlaybackParams>;
+extern template struct PatternBase<StreamPattern, StreamParams>;
+
+// Every pattern the show can use, for lookup by name and for sizing
+template <typename... Patterns> struct PatternRegistry {
+    static const int count = sizeof...(Patterns);
+    static const PatternOps* const table[sizeof...(Patterns)];
+
+    static const PatternOps* find(const char* name)
+    {
+        for (int i = 0; i < count; i++) {
+            if (strcmp(table[i]->name, name) == 0) {
+                return table[i];
+            }
+        }
+        return nullptr;
+    }
+};
+
+template <typename... Patterns>
+const PatternOps* const PatternRegistry<Patterns...>::table[sizeof...(Patterns)] = { &Patterns::ops... };
+
+typedef PatternRegistry<BreathingPattern, FlamePattern, GrowPattern, ChasePattern, PopPattern, SpinPattern,
+    PlaybackPattern, StreamPattern>
+    Patterns;
+
+#endif
@@ -0,0 +1,177 @@
+#include "pipeline.h"
+#include "output.h"
+#include "patterns.h"
+#include "profiler.h"
+#include "sync.h"
+#include <Arduino.h>
+
+static void pipelineYield()
+{
+#ifdef ARDUINO_ARCH_ESP32
+    // A full tick so the idle task on the render core can feed the watchdog
+    vTaskDelay(1);
+#else
+    std::this_thread::yield();
+#endif
+}
+
+FramePipeline::FramePipeline(
+    Program* programToRender, FrameScheduler* frameScheduler, CRGB* frontBuffer, CRGB* backBuffer)
+    : program(programToRender)
+    , scheduler(frameScheduler)
+    , front(frontBuffer)
+    , back(backBuffer)
+    , framePending(false)
+    , running(false)
+    , renderActive(false)
+    , showing(false)
+    , framesRendered(0)
+    , renderMicros(0)
+    , overlapMicros(0)
+    , outputMicros(0)
+{
+#ifdef ARDUINO_ARCH_ESP32
+    renderTaskHandle = nullptr;
+#endif
+}
+
+FramePipeline::~FramePipeline() { stop(); }
+
+void FramePipeline::start(int core)
+{
+    if (running.load()) {
+        return;
+    }
+
+    running.store(true);
+    renderActive.store(true);
+    frameRate.reset(millis());
+
+#ifdef ARDUINO_ARCH_ESP32
+    xTaskCreatePinnedToCore(renderTask, "render", 8192, this, 1, &renderTaskHandle, core);
+#else
+    (void)core;
+    renderThread = std::thread(renderTask, this);
+#endif
+}
+
+void FramePipeline::stop()
+{
+    running.store(false);
+
+#ifdef ARDUINO_ARCH_ESP32
+    while (renderActive.load()) {
+        vTaskDelay(1);
+    }
+    renderTaskHandle = nullptr;
+#else
+    if (renderThread.joinable()) {
+        renderThread.join();
+    }
+#endif
+}
+
+void FramePipeline::renderTask(void* arg)
+{
+    FramePipeline* pipeline = static_cast<FramePipeline*>(arg);
+    pipeline->renderLoop();
+    pipeline->renderActive.store(false);
+
+#ifdef ARDUINO_ARCH_ESP32
+    vTaskDelete(nullptr);
+#endif
+}
+
+void FramePipeline::renderLoop()
+{
+    bool needsSync = true;
+
+    while (running.load(std::memory_order_relaxed)) {
+        // Wait for present() to take the finished frame and hand back a buffer
+        if (framePending.load(std::memory_order_acquire)) {
+            pipelineYield();
+            continue;
+        }
+
+        if (needsSync) {
+            // Only changed pins are composed into the back buffer, so it has
+            // to start from the frame that is currently on the wire
+            memcpy(back, front, sizeof(CRGB) * TOTAL_LEDS);
+            needsSync = false;
+        }
+
+        syncBeforeFrame(*scheduler, *program);
+        FrameTime time = scheduler->beginFrame();
+
+        bool showingAtBegin = showing.load(std::memory_order_relaxed) || outputBusy();
+        unsigned long begin = micros();
+        bool changed = program->render(time);
+
+        if (changed) {
+            takeDirtyPins(pendingDirty);
+            {
+                ProfileScope scope(PROFILE_PROBE_COMPOSE);
+                composeFrame(back, pendingDirty);
+            }
+
+            // Polls that produced nothing are not render work
+            unsigned long elapsed = micros() - begin;
+            renderMicros += elapsed;
+            if (showingAtBegin && (showing.load(std::memory_order_relaxed) || outputBusy())) {
+                overlapMicros += elapsed;
+            }
+            framesRendered++;
+            framePending.store(true, std::memory_order_release);
+            needsSync = true;
+        }
+        syncAfterFrame(*scheduler, *program, time);
+
+        scheduler->endFrame();
+        // In the slack before the next frame slot, outside the frame's time
+        program->prepareNext();
+    }
+}
+
+bool FramePipeline::present()
+{
+    bool presented = false;
+
+    // With an asynchronous output a frame waits until the last transfer is
+    // done, so present() never blocks on the wire
+    if (framePending.load(std::memory_order_acquire) && !outputBusy()) {
+        CRGB* ready = back;
+        back = front;
+        front = ready;
+        setOutputFrame(front);
+        bool dirty[NUM_PINS];
+        memcpy(dirty, pendingDirty, sizeof(dirty));
+
+        // The renderer may start on the next frame while this one goes out
+        framePending.store(false, std::memory_order_release);
+
+        showing.store(true, std::memory_order_relaxed);
+        unsigned long begin = micros();
+        {
+            ProfileScope scope(PROFILE_PROBE_SHOW);
+            showPins(dirty);
+        }
+        outputMicros += micros() - begin;
+        showing.store(false, std::memory_order_relaxed);
+        presented = true;
+    }
+
+    frameRate.update(millis(), presented);
+    return presented;
+}
+
+float FramePipeline::getFps() { return frameRate.getFps(); }
+
+unsigned long FramePipeline::getFramesRendered() { return framesRendered; }
+
+unsigned long FramePipeline::getFramesPresented() { return frameRate.getTotalFrames(); }
+
+unsigned long FramePipeline::getRenderMicros() { return renderMicros; }
+
+unsigned long FramePipeline::getOverlapMicros() { return overlapMicros; }
+
+unsigned long FramePipeline::getOutputMicros() { return outputMicros; }
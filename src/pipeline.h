@@ -0,0 +1,78 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include "framerate.h"
+#include "patterns.h"
+#include "program.h"
+#include "scheduler.h"
+#include <FastLED.h>
+#include <atomic>
+
+#ifdef ARDUINO_ARCH_ESP32
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#else
+#include <thread>
+#endif
+
+// Double-buffered render/output pipeline. A render task fills the back
+// buffer with frame N+1 while the caller of present() transmits frame N
+// from the front buffer. The render task is paced by the FrameScheduler.
+//
+// Ownership moves through one atomic flag. The renderer raises it when the
+// back buffer holds a finished frame and does not touch either buffer until
+// present() has swapped them and lowered it again. When the output is a
+// ParallelOutput, present() leaves a finished frame pending until the last
+// transfer is done instead of waiting for it.
+class FramePipeline {
+private:
+    Program* program;
+    FrameScheduler* scheduler;
+    CRGB* front;
+    CRGB* back;
+    std::atomic<bool> framePending;
+    std::atomic<bool> running;
+    std::atomic<bool> renderActive;
+    std::atomic<bool> showing;
+    // Pins changed by the pending frame, handed over with framePending
+    bool pendingDirty[NUM_PINS];
+    FrameRateCounter frameRate;
+
+    // Each counter is only written by one side; read them after stop() for
+    // exact figures
+    unsigned long framesRendered;
+    unsigned long renderMicros;
+    unsigned long overlapMicros;
+    unsigned long outputMicros;
+
+#ifdef ARDUINO_ARCH_ESP32
+    TaskHandle_t renderTaskHandle;
+#else
+    std::thread renderThread;
+#endif
+
+    void renderLoop();
+    static void renderTask(void* arg);
+
+public:
+    FramePipeline(Program* programToRender, FrameScheduler* frameScheduler, CRGB* frontBuffer, CRGB* backBuffer);
+    ~FramePipeline();
+
+    // Launches the render task, pinned to the given core on the ESP32
+    void start(int core);
+    void stop();
+
+    // Output side: if a new frame is ready, swap buffers and show the pins
+    // it changed
+    bool present();
+
+    float getFps();
+    unsigned long getFramesRendered();
+    unsigned long getFramesPresented();
+    unsigned long getRenderMicros();
+    // Render time spent while a show() was in flight on the other side
+    unsigned long getOverlapMicros();
+    unsigned long getOutputMicros();
+};
+
+#endif
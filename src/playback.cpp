@@ -0,0 +1,83 @@
+#include "clip.h"
+#include "patterns.h"
+
+// Where the instance is in its clip. The clip is found when the instance is
+// prepared, so the clip region can be set after the show is built.
+struct PlaybackState {
+    float stepAccumulator;
+    const uint8_t* clip;
+    const uint8_t* nextFrame;
+    uint32_t frame;
+    ClipHeader header;
+    bool finished;
+};
+
+size_t PlaybackPattern::stateSize(int numPins) { return sizeof(PlaybackState); }
+
+void PlaybackPattern::reset(void* state, int numPins)
+{
+    memset(state, 0, sizeof(PlaybackState));
+
+    // Start with one step due so the key frame shows on the first frame, and
+    // half a step in hand so that frames land on the nearest step: a clip
+    // recorded at the frame rate then plays one clip frame per frame even
+    // though dt comes out a hair under 1/fps
+    static_cast<PlaybackState*>(state)->stepAccumulator = 1.5;
+    // Nothing to play until prepare() finds the clip
+    static_cast<PlaybackState*>(state)->finished = true;
+}
+
+void PlaybackPattern::prepare(
+    void* state, int pins[], int numPins, const PlaybackParams& params, bool reverse, uint32_t seed)
+{
+    reset(state, numPins);
+
+    PlaybackState* s = static_cast<PlaybackState*>(state);
+    s->clip = findClip(params.clip, s->header);
+    s->nextFrame = s->clip + sizeof(ClipHeader);
+    s->finished = s->clip == nullptr;
+}
+
+bool PlaybackPattern::render(
+    const FrameTime& time, void* state, int pins[], int numPins, const PlaybackParams& params, bool reverse)
+{
+    PlaybackState* s = static_cast<PlaybackState*>(state);
+    if (s->finished) {
+        return false;
+    }
+
+    // Frames are decoded at the clip's rate. Frames that fall between two of
+    // ours are still decoded, as each is a delta on the one before.
+    const uint8_t* end = s->clip + s->header.totalBytes;
+    int steps = takeSteps(s->stepAccumulator, s->header.fps, time.dt);
+    bool changed = false;
+    for (int step = 0; step < steps; step++) {
+        if (s->frame == s->header.numFrames) {
+            if (!params.loop) {
+                s->finished = true;
+                break;
+            }
+            s->frame = 0;
+            s->nextFrame = s->clip + sizeof(ClipHeader);
+        }
+
+        bool frameChanged;
+        s->nextFrame = decodeClipFrame(s->nextFrame, end, s->header, pins, numPins, &frameChanged);
+        if (s->nextFrame == nullptr) {
+            s->finished = true;
+            break;
+        }
+        s->frame++;
+        changed |= frameChanged;
+    }
+
+    return changed;
+}
+
+const ParamField PlaybackPattern::fields[] = {
+    PARAM_INT_FIELD(PlaybackParams, clip, 0, 0xFFFF),
+    PARAM_BOOL_FIELD(PlaybackParams, loop),
+    PARAM_FIELDS_END,
+};
+
+template struct PatternBase<PlaybackPattern, PlaybackParams>;
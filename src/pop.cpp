@@ -2,68 +2,110 @@
 #include <Arduino.h>
 #include <FastLED.h>
 
-static unsigned long lastUpdateTime = 0;
-static int currentPin = 0;
-static int currentColorIndex = 0;
-static bool pinFilled = false;
-static unsigned long fillStartTime = 0;
-static unsigned long patternStartTime = 0;
-static int* pinSequence = nullptr;
-static int sequenceLength = 0;
+struct PopState {
+    float stepAccumulator;
+    int currentPin;
+    int currentColorIndex;
+    bool pinFilled;
+    unsigned long fillStartTime;
+    unsigned long patternStartTime;
+    bool patternInitialized;
+    bool sequenceReady;
+    PatternRandom random;
+};
 
-void resetPopPattern() {
-    lastUpdateTime = 0;
-    currentPin = 0;
-    currentColorIndex = 0;
-    pinFilled = false;
-    fillStartTime = 0;
-    patternStartTime = 0;
-    if (pinSequence != nullptr) {
-        delete[] pinSequence;
-        pinSequence = nullptr;
+// The pin sequence follows the state in the same block, so there is no
+// allocation while the show plays
+static PopState* layoutPopState(void* block, int numPins, int** pinSequence, size_t* size = nullptr) {
+    StateLayout layout(block);
+    PopState* state = layout.take<PopState>(1);
+    *pinSequence = layout.take<int>(numPins);
+    if (size)
+        *size = layout.size();
+    return state;
+}
+
+size_t PopPattern::stateSize(int numPins) {
+    int* pinSequence;
+    size_t size;
+    layoutPopState(nullptr, numPins, &pinSequence, &size);
+    return size;
+}
+
+void PopPattern::reset(void* state, int numPins) {
+    memset(state, 0, stateSize(numPins));
+
+    // Start with one step due so the first pin pops on the first frame
+    PopState* s = static_cast<PopState*>(state);
+    s->stepAccumulator = 1.0;
+    s->random.seed(0);
+}
+
+static void shuffle(int* pinSequence, int numPins, PatternRandom& random) {
+    // Fisher-Yates shuffle algorithm
+    for (int i = numPins - 1; i > 0; i--) {
+        int j = random.below(i + 1);
+        int temp = pinSequence[i];
+        pinSequence[i] = pinSequence[j];
+        pinSequence[j] = temp;
+    }
+}
+
+static void buildPinSequence(PopState* s, int* pinSequence, int pins[], int numPins, bool random, bool reverse) {
+    if (random) {
+        // Create randomized pin sequence
+        for (int i = 0; i < numPins; i++) {
+            pinSequence[i] = pins[i];
+        }
+        shuffle(pinSequence, numPins, s->random);
+    } else {
+        // Create sequential pin order
+        for (int i = 0; i < numPins; i++) {
+            pinSequence[i] = reverse ? pins[numPins - 1 - i] : pins[i];
+        }
     }
-    sequenceLength = 0;
 }
 
-void popPattern(int pins[], int numPins, int speed, int holdDelay, CRGB palette[], int paletteSize, bool random, int accelerationTime, bool reverse) {
-    if (numPins == 0 || paletteSize == 0) return;
+void PopPattern::prepare(void* state, int pins[], int numPins, const PopParams& params, bool reverse, uint32_t seed) {
+    reset(state, numPins);
+
+    int* pinSequence;
+    PopState* s = layoutPopState(state, numPins, &pinSequence);
+    s->random.seed(seed);
+    buildPinSequence(s, pinSequence, pins, numPins, params.random, reverse);
+    s->sequenceReady = true;
+}
+
+bool PopPattern::render(const FrameTime& time, void* state, int pins[], int numPins, const PopParams& params, bool reverse) {
+    int speed = params.speed;
+    int holdDelay = params.holdDelay;
+    CRGB* palette = params.palette;
+    int paletteSize = params.paletteSize;
+    bool random = params.random;
+    int accelerationTime = params.accelerationTime;
+
+    if (numPins == 0 || paletteSize == 0) return false;
     
-    unsigned long currentTime = millis();
+    int* pinSequence;
+    PopState* s = layoutPopState(state, numPins, &pinSequence);
+    unsigned long currentTime = time.now;
     
-    // Initialize pattern start time and pin sequence on first call
-    if (patternStartTime == 0) {
-        patternStartTime = currentTime;
+    // Initialize pattern start time on first call, and the pin sequence
+    // unless prepare() has built it already
+    if (!s->patternInitialized) {
+        s->patternStartTime = currentTime;
+        s->patternInitialized = true;
         
-        // Create pin sequence based on random parameter
-        if (pinSequence == nullptr) {
-            sequenceLength = numPins;
-            pinSequence = new int[sequenceLength];
-            
-            if (random) {
-                // Create randomized pin sequence
-                for (int i = 0; i < numPins; i++) {
-                    pinSequence[i] = pins[i];
-                }
-                // Fisher-Yates shuffle algorithm
-                for (int i = numPins - 1; i > 0; i--) {
-                    int j = rand() % (i + 1);
-                    int temp = pinSequence[i];
-                    pinSequence[i] = pinSequence[j];
-                    pinSequence[j] = temp;
-                }
-            } else {
-                // Create sequential pin order
-                for (int i = 0; i < numPins; i++) {
-                    pinSequence[i] = reverse ? pins[numPins - 1 - i] : pins[i];
-                }
-            }
+        if (!s->sequenceReady) {
+            buildPinSequence(s, pinSequence, pins, numPins, random, reverse);
+            s->sequenceReady = true;
         }
     }
     
     // Calculate current speed based on acceleration
     int currentSpeed = speed;
     if (accelerationTime > 0) {
-        unsigned long elapsed = currentTime - patternStartTime;
+        unsigned long elapsed = currentTime - s->patternStartTime;
         unsigned long accelTimeMs = accelerationTime * 1000;
         
         if (elapsed < accelTimeMs) {
@@ -76,54 +118,63 @@ void popPattern(int pins[], int numPins, int speed, int holdDelay, CRGB palette[
     
     // Calculate delay between updates based on current speed
     unsigned long updateDelay = map(currentSpeed, 0, 100, 200, 10);
+    int steps = takeSteps(s->stepAccumulator, stepsPerSecond(updateDelay), time.dt);
+    bool changed = false;
     
-    if (currentTime - lastUpdateTime >= updateDelay) {
-        lastUpdateTime = currentTime;
-        
+    for (int step = 0; step < steps; step++) {
         // If we haven't filled the current pin yet, fill it
-        if (!pinFilled) {
-            int pin = pinSequence[currentPin];
-            int startIndex = pin * NUM_LEDS_PER_STRIP * NUM_STRIPS_PER_PIN;
-            int totalLeds = NUM_LEDS_PER_STRIP * NUM_STRIPS_PER_PIN;
+        if (!s->pinFilled) {
+            int pin = pinSequence[s->currentPin];
+            int startIndex = pinOffset(pin);
+            int totalLeds = pinLeds(pin);
             
-            CRGB color = palette[currentColorIndex % paletteSize];
+            CRGB color = palette[s->currentColorIndex % paletteSize];
             
             // Fill all LEDs on this pin with the current color
             for (int i = 0; i < totalLeds; i++) {
                 leds[startIndex + i] = color;
             }
             
-            pinFilled = true;
-            fillStartTime = currentTime;
+            markPinDirty(pin);
+            s->pinFilled = true;
+            s->fillStartTime = currentTime;
+            changed = true;
         }
         // If we've filled the pin and enough time has passed, move to next pin
-        else if (currentTime - fillStartTime >= holdDelay) {
+        else if (currentTime - s->fillStartTime >= holdDelay) {
             // Turn off current pin
-            int pin = pinSequence[currentPin];
-            int startIndex = pin * NUM_LEDS_PER_STRIP * NUM_STRIPS_PER_PIN;
-            int totalLeds = NUM_LEDS_PER_STRIP * NUM_STRIPS_PER_PIN;
+            int pin = pinSequence[s->currentPin];
+            int startIndex = pinOffset(pin);
+            int totalLeds = pinLeds(pin);
             
             for (int i = 0; i < totalLeds; i++) {
                 leds[startIndex + i] = CRGB::Black;
             }
+            markPinDirty(pin);
             
             // Move to next pin and color
-            currentPin = (currentPin + 1) % sequenceLength;
-            currentColorIndex = (currentColorIndex + 1) % paletteSize;
-            pinFilled = false;
+            s->currentPin = (s->currentPin + 1) % numPins;
+            s->currentColorIndex = (s->currentColorIndex + 1) % paletteSize;
+            s->pinFilled = false;
+            changed = true;
             
             // If random mode and we've completed a full cycle, reshuffle
-            if (random && currentPin == 0) {
-                // Fisher-Yates shuffle algorithm
-                for (int i = sequenceLength - 1; i > 0; i--) {
-                    int j = rand() % (i + 1);
-                    int temp = pinSequence[i];
-                    pinSequence[i] = pinSequence[j];
-                    pinSequence[j] = temp;
-                }
+            if (random && s->currentPin == 0) {
+                shuffle(pinSequence, numPins, s->random);
             }
         }
-        
-        FastLED.show();
     }
-}
\ No newline at end of file
+
+    return changed;
+}
+
+const ParamField PopPattern::fields[] = {
+    PARAM_INT_FIELD(PopParams, speed, 1, PARAM_MAX_SPEED),
+    PARAM_INT_FIELD(PopParams, holdDelay, 0, PARAM_MAX_MILLIS),
+    PARAM_PALETTE_FIELD(PopParams, palette, paletteSize),
+    PARAM_BOOL_FIELD(PopParams, random),
+    PARAM_INT_FIELD(PopParams, accelerationTime, 0, PARAM_MAX_SECONDS),
+    PARAM_FIELDS_END,
+};
+
+template struct PatternBase<PopPattern, PopParams>;
@@ -0,0 +1,150 @@
+#include "profiler.h"
+
+#if FRAME_PROFILER
+
+#include "show_format.h"
+#include <Arduino.h>
+
+#ifndef ARDUINO_ARCH_ESP32
+#include <chrono>
+#endif
+
+struct ProfileProbe {
+    uint8_t kind;
+    uint8_t segment;
+    uint8_t instance;
+    char name[PROFILE_NAME_BYTES];
+    uint32_t count;
+    uint32_t minCycles;
+    uint32_t maxCycles;
+    uint32_t buckets[PROFILE_BUCKETS];
+};
+
+// Worst case of one probe in a record, every bucket used
+#define PROFILE_PROBE_RECORD_BYTES (4 + PROFILE_NAME_BYTES + 13 + PROFILE_BUCKETS * 5)
+#define PROFILE_HEADER_BYTES 12
+
+static ProfileProbe probes[PROFILE_MAX_PROBES] = {
+    { PROFILE_LOOP, 0, 0, "loop" },
+    { PROFILE_COMPOSE, 0, 0, "compose" },
+    { PROFILE_SHOW, 0, 0, "show" },
+};
+static int numProbes = 3;
+static unsigned long windowStart = 0;
+
+#ifndef ARDUINO_ARCH_ESP32
+// The host counts nanoseconds as cycles of a 1 GHz clock
+uint32_t profileCycles()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+static uint16_t cyclesPerMicro() { return 1000; }
+#else
+static uint16_t cyclesPerMicro() { return getCpuFrequencyMhz(); }
+#endif
+
+static void clearProbe(ProfileProbe& probe)
+{
+    probe.count = 0;
+    probe.minCycles = 0;
+    probe.maxCycles = 0;
+    memset(probe.buckets, 0, sizeof(probe.buckets));
+}
+
+int addProfileProbe(uint8_t kind, uint8_t segment, uint8_t instance, const char* name)
+{
+    if (numProbes >= PROFILE_MAX_PROBES) {
+        return -1;
+    }
+    ProfileProbe& probe = probes[numProbes];
+    probe.kind = kind;
+    probe.segment = segment;
+    probe.instance = instance;
+    size_t length = min(strlen(name), sizeof(probe.name) - 1);
+    memset(probe.name, 0, sizeof(probe.name));
+    memcpy(probe.name, name, length);
+    clearProbe(probe);
+    return numProbes++;
+}
+
+static int bucketFor(uint32_t cycles)
+{
+    if (cycles < 64) {
+        return 0;
+    }
+    int octave = 31 - __builtin_clz(cycles);
+    int bucket = 1 + (octave - 6) * 4 + ((cycles >> (octave - 2)) & 3);
+    return bucket < PROFILE_BUCKETS ? bucket : PROFILE_BUCKETS - 1;
+}
+
+void profileRecord(int probe, uint32_t cycles)
+{
+    if (probe < 0) {
+        return;
+    }
+    ProfileProbe& p = probes[probe];
+    if (p.count == 0 || cycles < p.minCycles) {
+        p.minCycles = cycles;
+    }
+    if (cycles > p.maxCycles) {
+        p.maxCycles = cycles;
+    }
+    p.count++;
+    p.buckets[bucketFor(cycles)]++;
+}
+
+template <typename T> static uint8_t* put(uint8_t* out, T value)
+{
+    memcpy(out, &value, sizeof(value));
+    return out + sizeof(value);
+}
+
+void dumpProfile()
+{
+    static uint8_t record[PROFILE_HEADER_BYTES + 7 + PROFILE_MAX_PROBES * PROFILE_PROBE_RECORD_BYTES];
+    unsigned long now = millis();
+
+    uint8_t* out = record + PROFILE_HEADER_BYTES;
+    out = put<uint16_t>(out, cyclesPerMicro());
+    out = put<uint32_t>(out, now - windowStart);
+    out = put<uint8_t>(out, numProbes);
+    for (int i = 0; i < numProbes; i++) {
+        ProfileProbe& probe = probes[i];
+        uint8_t nameBytes = strnlen(probe.name, sizeof(probe.name));
+        out = put<uint8_t>(out, probe.kind);
+        out = put<uint8_t>(out, probe.segment);
+        out = put<uint8_t>(out, probe.instance);
+        out = put<uint8_t>(out, nameBytes);
+        memcpy(out, probe.name, nameBytes);
+        out += nameBytes;
+        out = put<uint32_t>(out, probe.count);
+        out = put<uint32_t>(out, probe.minCycles);
+        out = put<uint32_t>(out, probe.maxCycles);
+
+        uint8_t* used = out++;
+        *used = 0;
+        for (int b = 0; b < PROFILE_BUCKETS; b++) {
+            if (probe.buckets[b] != 0) {
+                out = put<uint8_t>(out, b);
+                out = put<uint32_t>(out, probe.buckets[b]);
+                (*used)++;
+            }
+        }
+        clearProbe(probe);
+    }
+
+    size_t payloadBytes = out - record - PROFILE_HEADER_BYTES;
+    uint8_t* header = record;
+    memcpy(header, PROFILE_MAGIC, 4);
+    header = put<uint16_t>(header + 4, PROFILE_VERSION);
+    header = put<uint16_t>(header, payloadBytes);
+    put<uint32_t>(header, showChecksum(record + PROFILE_HEADER_BYTES, payloadBytes));
+
+    Serial.write(record, out - record);
+    windowStart = now;
+}
+
+#endif
@@ -0,0 +1,93 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Frame-time profiler. Each probe times a piece of the frame in CPU cycles
+// and keeps a histogram of the times with their min and max. The histogram
+// has four buckets per power of two, so percentiles read from it are within
+// a quarter octave; everything under 64 cycles shares the first bucket.
+//
+// Probes are the loop() iteration, composing the frame, showing it, and one
+// for each PatternInstance, added when the Program lays out its arena. With
+// the render pipeline, compose and the patterns are timed on the render core
+// while loop and show are timed on the output core, and a dump taken during a
+// frame may miss that frame's last samples.
+//
+// Built with FRAME_PROFILER 0 (the default) the probes compile to nothing.
+#ifndef FRAME_PROFILER
+#define FRAME_PROFILER 0
+#endif
+
+#define PROFILE_MAX_PROBES 24
+#define PROFILE_BUCKETS 96
+#define PROFILE_NAME_BYTES 12
+
+enum ProfileKind { PROFILE_LOOP, PROFILE_COMPOSE, PROFILE_SHOW, PROFILE_PATTERN };
+
+// The fixed probes take the first ids
+#define PROFILE_PROBE_LOOP 0
+#define PROFILE_PROBE_COMPOSE 1
+#define PROFILE_PROBE_SHOW 2
+
+// dumpProfile() writes one record over Serial, little-endian and framed so
+// the decoder (host/profile/decode_profile.py) can find it between the text
+// lines around it:
+//
+//   "FLPR"  u16 version  u16 payload bytes  u32 FNV-1a of the payload
+//   payload:
+//     u16 cycles per microsecond  u32 window ms  u8 probes
+//     per probe:
+//       u8 kind  u8 segment  u8 instance  u8 name bytes  name
+//       u32 count  u32 min  u32 max  u8 used buckets
+//       per used bucket: u8 index  u32 count
+//
+// Bucket 0 holds times under 64 cycles. Bucket b >= 1 holds times from
+// (4 + s) << (o - 2) up to (5 + s) << (o - 2) cycles, where o = 6 + (b - 1) / 4
+// and s = (b - 1) % 4; the last bucket also takes everything above.
+#define PROFILE_MAGIC "FLPR"
+#define PROFILE_VERSION 1
+
+#if FRAME_PROFILER
+
+#ifdef ARDUINO_ARCH_ESP32
+#include <Arduino.h>
+inline uint32_t profileCycles() { return ESP.getCycleCount(); }
+#else
+uint32_t profileCycles();
+#endif
+
+// Id of a new probe, or -1 when all are taken; times for -1 are dropped
+int addProfileProbe(uint8_t kind, uint8_t segment, uint8_t instance, const char* name);
+void profileRecord(int probe, uint32_t cycles);
+// Sends the record of everything since the last dump and starts a new window
+void dumpProfile();
+
+// Times the rest of the scope it is declared in
+class ProfileScope {
+private:
+    int probe;
+    uint32_t start;
+
+public:
+    ProfileScope(int probeId)
+        : probe(probeId)
+        , start(profileCycles())
+    {
+    }
+    ~ProfileScope() { profileRecord(probe, profileCycles() - start); }
+};
+
+#else
+
+inline int addProfileProbe(uint8_t kind, uint8_t segment, uint8_t instance, const char* name) { return -1; }
+
+class ProfileScope {
+public:
+    ProfileScope(int probeId) { }
+};
+
+#endif
+
+#endif
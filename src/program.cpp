@@ -1,34 +1,86 @@
 #include "program.h"
+#include "output.h"
 #include "patterns.h"
+#include "profiler.h"
 #include <Arduino.h>
 
 PatternInstance::PatternInstance(
-    PatternType type, int* pinArray, int pinCount, PatternParams parameters, bool reverseDirection)
+    const PatternOps* patternOps, int* pinArray, int pinCount, const void* parameters, bool reverseDirection)
 {
-    patternType = type;
+    ops = patternOps;
     pins = new int[pinCount];
     for (int i = 0; i < pinCount; i++) {
         pins[i] = pinArray[i];
     }
     numPins = pinCount;
+    params = new uint8_t[ops->paramsSize];
+    memcpy(params, parameters, ops->paramsSize);
+    reverse = reverseDirection;
+    blend = BLEND_REPLACE;
+    opacity = 255;
+    state = nullptr;
+    stateSize = ops->stateSize(pinCount);
+    visible = true;
+    layer = nullptr;
+    ownsArrays = true;
+    profileProbe = -1;
+}
+
+PatternInstance::PatternInstance(
+    InPlace, const PatternOps* patternOps, int* pinArray, int pinCount, void* parameters, bool reverseDirection)
+{
+    ops = patternOps;
+    pins = pinArray;
+    numPins = pinCount;
     params = parameters;
     reverse = reverseDirection;
+    blend = BLEND_REPLACE;
+    opacity = 255;
+    state = nullptr;
+    stateSize = ops->stateSize(pinCount);
+    visible = true;
+    layer = nullptr;
+    ownsArrays = false;
+    profileProbe = -1;
+}
+
+PatternInstance::~PatternInstance()
+{
+    if (ownsArrays) {
+        delete[] pins;
+        delete[] static_cast<uint8_t*>(params);
+    }
 }
 
-PatternInstance::~PatternInstance() { delete[] pins; }
+void PatternInstance::setBlend(BlendMode mode, uint8_t layerOpacity)
+{
+    blend = mode;
+    opacity = layerOpacity;
+}
 
-Segment::Segment(PatternType type, int* pinArray, int pinCount, unsigned long durationSeconds, PatternParams parameters,
-    bool reverseDirection)
+Segment::Segment(PatternInstance** patternArray, int patternCount, unsigned long durationSeconds)
 {
-    patterns = new PatternInstance*[1];
-    patterns[0] = new PatternInstance(type, pinArray, pinCount, parameters, reverseDirection);
-    numPatterns = 1;
+    init(patternArray, patternCount, durationSeconds);
+}
+
+Segment::Segment(InPlace, PatternInstance** patternArray, int patternCount, unsigned long durationSeconds)
+{
+    patterns = patternArray;
+    numPatterns = patternCount;
     duration = durationSeconds * 1000;
     startTime = 0;
     isActive = false;
+    isPrepared = false;
+    ownsPatterns = false;
+    transition = TRANSITION_CUT;
+    transitionMillis = 0;
+    stackDepth = nullptr;
+    stackLayers = nullptr;
+    stackFlips = nullptr;
+    layered = false;
 }
 
-Segment::Segment(PatternInstance** patternArray, int patternCount, unsigned long durationSeconds)
+void Segment::init(PatternInstance** patternArray, int patternCount, unsigned long durationSeconds)
 {
     patterns = new PatternInstance*[patternCount];
     for (int i = 0; i < patternCount; i++) {
@@ -38,44 +90,79 @@ Segment::Segment(PatternInstance** patternArray, int patternCount, unsigned long
     duration = durationSeconds * 1000;
     startTime = 0;
     isActive = false;
+    isPrepared = false;
+    ownsPatterns = true;
+    transition = TRANSITION_CUT;
+    transitionMillis = 0;
+    stackDepth = nullptr;
+    stackLayers = nullptr;
+    stackFlips = nullptr;
+    layered = false;
 }
 
 Segment::~Segment()
 {
+    if (!ownsPatterns) {
+        return;
+    }
     for (int i = 0; i < numPatterns; i++) {
         delete patterns[i];
     }
     delete[] patterns;
 }
 
-void Segment::start()
+// The pixels from an instance's first pin to the end of its last
+static void layerSpan(const PatternInstance* pattern, int& first, int& count)
+{
+    int start = TOTAL_LEDS;
+    int end = 0;
+    for (int p = 0; p < pattern->numPins; p++) {
+        int pin = pattern->pins[p];
+        start = min(start, pinOffset(pin));
+        end = max(end, pinOffset(pin) + pinLeds(pin));
+    }
+    first = start;
+    count = end - start;
+}
+
+void Segment::prepare(uint32_t seed)
+{
+    for (int i = 0; i < numPatterns; i++) {
+        PatternInstance* pattern = patterns[i];
+        pattern->ops->prepare(
+            pattern->state, pattern->pins, pattern->numPins, pattern->params, pattern->reverse, mixSeed(seed, i));
+        // Layers start black, as leds[] does after a stop
+        if (pattern->layer != nullptr) {
+            int first, count;
+            layerSpan(pattern, first, count);
+            memset(pattern->layer + first, 0, sizeof(CRGB) * count);
+        }
+    }
+    isPrepared = true;
+}
+
+void Segment::start(unsigned long now)
 {
-    startTime = millis();
+    startTime = now;
     isActive = true;
+    if (!isPrepared) {
+        prepare(now);
+    }
+    isPrepared = false;
 
-    // Reset pattern state for all patterns when starting
+    // Point the pins the way the patterns run, the last visible one on a
+    // pin deciding
     for (int i = 0; i < numPatterns; i++) {
-        switch (patterns[i]->patternType) {
-        case PATTERN_BREATHING:
-            resetBreathingPattern();
-            break;
-        case PATTERN_FLAME:
-            resetFlamePattern();
-            break;
-        case PATTERN_GROW:
-            resetGrowPattern();
-            break;
-        case PATTERN_POP:
-            resetPopPattern();
-            break;
-        case PATTERN_SPIN:
-            resetSpinPattern();
-            break;
+        if (!patterns[i]->visible) {
+            continue;
+        }
+        for (int p = 0; p < patterns[i]->numPins; p++) {
+            setPinReversed(patterns[i]->pins[p], patterns[i]->reverse);
         }
     }
 }
 
-void Segment::stop()
+void Segment::stop(bool blackout)
 {
     isActive = false;
 
@@ -84,59 +171,100 @@ void Segment::stop()
         PatternInstance* pattern = patterns[patternIdx];
         for (int p = 0; p < pattern->numPins; p++) {
             int pin = pattern->pins[p];
-            int startIndex = pin * NUM_LEDS_PER_STRIP * NUM_STRIPS_PER_PIN;
-            int totalLeds = NUM_LEDS_PER_STRIP * NUM_STRIPS_PER_PIN;
+            setPinHeld(pin, false);
+            setPinRotation(pin, 0);
+            if (!blackout) {
+                continue;
+            }
 
+            int startIndex = pinOffset(pin);
+            int totalLeds = pinLeds(pin);
             for (int i = 0; i < totalLeds; i++) {
                 leds[startIndex + i] = CRGB::Black;
             }
+            markPinDirty(pin);
         }
     }
-
-    FastLED.show();
 }
 
-bool Segment::isFinished()
+bool Segment::isFinished(unsigned long now)
 {
     if (!isActive)
         return false;
-    return (millis() - startTime) >= duration;
+    return (now - startTime) >= duration;
 }
 
-void Segment::update()
+unsigned long Segment::getDurationMillis() { return duration; }
+
+unsigned long Segment::getStartTime() { return startTime; }
+
+bool Segment::update(const FrameTime& time)
 {
     if (!isActive)
-        return;
+        return false;
 
-    // Update all patterns in this segment
+    // Render all patterns in this segment; the Program presents the result
+    bool changed = false;
+    bool recompose[NUM_PINS] = {};
     for (int i = 0; i < numPatterns; i++) {
         PatternInstance* pattern = patterns[i];
-        switch (pattern->patternType) {
-        case PATTERN_BREATHING:
-            breathingPattern(pattern->pins, pattern->numPins, pattern->params.breathing.speed,
-                pattern->params.breathing.palette, pattern->params.breathing.paletteSize, pattern->reverse);
-            break;
-        case PATTERN_FLAME:
-            flamepattern(pattern->pins, pattern->numPins, pattern->params.flame.speed, pattern->params.flame.cooling,
-                pattern->params.flame.sparking, pattern->reverse);
-            break;
-        case PATTERN_GROW:
-            growPattern(pattern->pins, pattern->numPins, pattern->params.grow.speed, pattern->params.grow.n,
-                pattern->params.grow.fadeDelay, pattern->params.grow.holdDelay, pattern->params.grow.palette,
-                pattern->params.grow.paletteSize, pattern->params.grow.transitionSpeed,
-                pattern->params.grow.offsetDelay, pattern->reverse);
-            break;
-        case PATTERN_POP:
-            popPattern(pattern->pins, pattern->numPins, pattern->params.pop.speed, pattern->params.pop.holdDelay,
-                pattern->params.pop.palette, pattern->params.pop.paletteSize, pattern->params.pop.random, 
-                pattern->params.pop.accelerationTime, pattern->reverse);
-            break;
-        case PATTERN_SPIN:
-            spinPattern(pattern->pins, pattern->numPins, pattern->params.spin.speed, pattern->params.spin.separation,
-                pattern->params.spin.span, pattern->params.spin.palette, pattern->params.spin.paletteSize, 
-                pattern->params.spin.loop, pattern->params.spin.continuous, pattern->params.spin.blend, pattern->reverse);
-            break;
+        if (!pattern->visible) {
+            continue;
+        }
+        ProfileScope scope(pattern->profileProbe);
+        if (pattern->layer == nullptr) {
+            changed |= pattern->ops->render(
+                time, pattern->state, pattern->pins, pattern->numPins, pattern->params, pattern->reverse);
+            continue;
         }
+
+        CRGB* target = leds;
+        leds = pattern->layer;
+        beginSideFrame();
+        bool drew = pattern->ops->render(
+            time, pattern->state, pattern->pins, pattern->numPins, pattern->params, pattern->reverse);
+        endSideFrame();
+        leds = target;
+        if (drew) {
+            for (int p = 0; p < pattern->numPins; p++) {
+                recompose[pattern->pins[p]] = true;
+            }
+        }
+        changed |= drew;
+    }
+
+    if (layered) {
+        composeLayers(recompose);
+    }
+    return changed;
+}
+
+// Each pin whose layers changed is built again from all of them, so a layer
+// that did not render this frame still shows
+void Segment::composeLayers(const bool pins[NUM_PINS])
+{
+    for (int pin = 0; pin < NUM_PINS; pin++) {
+        int depth = stackDepth[pin];
+        if (!pins[pin] || depth == 0) {
+            continue;
+        }
+        int start = pinOffset(pin);
+        int count = pinLeds(pin);
+        CRGB* out = leds + start;
+        const uint16_t* stack = stackLayers + pin * numPatterns;
+        const bool* flips = stackFlips + pin * numPatterns;
+
+        // An opaque first layer is copied over what is there; any other
+        // goes over black
+        PatternInstance* bottom = patterns[stack[0]];
+        if (!blendIsOpaque(bottom->blend, bottom->opacity)) {
+            memset(out, 0, sizeof(CRGB) * count);
+        }
+        for (int k = 0; k < depth; k++) {
+            PatternInstance* pattern = patterns[stack[k]];
+            blendPixels(pattern->blend, pattern->opacity, out, pattern->layer + start, count, flips[k]);
+        }
+        markPinDirty(pin);
     }
 }
 
@@ -146,20 +274,200 @@ void Segment::addPattern(PatternInstance* pattern)
     // In practice, you might want to implement dynamic resizing or use a vector-like approach
 }
 
+size_t Segment::getStateBytes()
+{
+    size_t bytes = 0;
+    for (int i = 0; i < numPatterns; i++) {
+        bytes += alignUp(patterns[i]->stateSize, STATE_ALIGNMENT);
+    }
+    return bytes + planLayers(nullptr);
+}
+
+void Segment::bindState(uint8_t* block)
+{
+    size_t offset = 0;
+    for (int i = 0; i < numPatterns; i++) {
+        patterns[i]->state = block + offset;
+        offset += alignUp(patterns[i]->stateSize, STATE_ALIGNMENT);
+    }
+    planLayers(block + offset);
+    isPrepared = false;
+}
+
+size_t Segment::planLayers(uint8_t* block)
+{
+    // The last opaque instance on a pin covers all the ones before it there
+    int lowest[NUM_PINS] = {};
+    for (int i = 0; i < numPatterns; i++) {
+        if (blendIsOpaque(patterns[i]->blend, patterns[i]->opacity)) {
+            for (int p = 0; p < patterns[i]->numPins; p++) {
+                lowest[patterns[i]->pins[p]] = i;
+            }
+        }
+    }
+    // How many instances show on each pin, and the last of them, which the
+    // pin runs the way of
+    int depth[NUM_PINS] = {};
+    int top[NUM_PINS] = {};
+    for (int i = 0; i < numPatterns; i++) {
+        for (int p = 0; p < patterns[i]->numPins; p++) {
+            int pin = patterns[i]->pins[p];
+            if (patterns[i]->opacity > 0 && i >= lowest[pin]) {
+                depth[pin]++;
+                top[pin] = i;
+            }
+        }
+    }
+
+    // Alone on every pin it shows on and covered on none, an instance that
+    // draws over black as it is needs no layer. Only a real block changes
+    // the instances and the segment; measuring leaves them as they are.
+    StateLayout layout(block);
+    bool anyLayer = false;
+    for (int i = 0; i < numPatterns; i++) {
+        PatternInstance* pattern = patterns[i];
+        bool shown = false;
+        bool alone = true;
+        for (int p = 0; p < pattern->numPins; p++) {
+            int pin = pattern->pins[p];
+            shown |= i >= lowest[pin];
+            alone &= i >= lowest[pin] && depth[pin] == 1;
+        }
+        bool asIs = pattern->opacity == 255
+            && (pattern->blend == BLEND_REPLACE || pattern->blend == BLEND_ADD || pattern->blend == BLEND_MAX);
+        bool visible = pattern->opacity > 0 && shown;
+        CRGB* layer = nullptr;
+        if (visible && !(alone && asIs)) {
+            int first, count;
+            layerSpan(pattern, first, count);
+            CRGB* pixels = layout.take<CRGB>(count);
+            if (block != nullptr) {
+                layer = pixels - first;
+            }
+            anyLayer = true;
+        }
+        if (block != nullptr) {
+            pattern->visible = visible;
+            pattern->layer = layer;
+        }
+    }
+
+    uint16_t* depths = nullptr;
+    uint16_t* layers = nullptr;
+    bool* flips = nullptr;
+    if (anyLayer) {
+        depths = layout.take<uint16_t>(NUM_PINS);
+        layers = layout.take<uint16_t>(NUM_PINS * numPatterns);
+        flips = layout.take<bool>(NUM_PINS * numPatterns);
+    }
+    if (block == nullptr) {
+        return layout.size();
+    }
+    layered = anyLayer;
+    stackDepth = depths;
+    stackLayers = layers;
+    stackFlips = flips;
+    if (!layered) {
+        return layout.size();
+    }
+    memset(stackDepth, 0, sizeof(uint16_t) * NUM_PINS);
+    for (int i = 0; i < numPatterns; i++) {
+        PatternInstance* pattern = patterns[i];
+        if (pattern->layer == nullptr) {
+            continue;
+        }
+        for (int p = 0; p < pattern->numPins; p++) {
+            int pin = pattern->pins[p];
+            if (i < lowest[pin]) {
+                continue;
+            }
+            int k = pin * numPatterns + stackDepth[pin]++;
+            stackLayers[k] = i;
+            stackFlips[k] = pattern->reverse != patterns[top[pin]]->reverse;
+        }
+    }
+    return layout.size();
+}
+
+void Segment::addProfileProbes(int segmentIndex)
+{
+    for (int i = 0; i < numPatterns; i++) {
+        patterns[i]->profileProbe = addProfileProbe(PROFILE_PATTERN, segmentIndex, i, patterns[i]->ops->name);
+    }
+}
+
+void Segment::usePins(bool used[NUM_PINS])
+{
+    for (int i = 0; i < numPatterns; i++) {
+        for (int p = 0; p < patterns[i]->numPins; p++) {
+            used[patterns[i]->pins[p]] = true;
+        }
+    }
+}
+
+void Segment::setTransition(TransitionType type, unsigned long millis)
+{
+    transition = millis > 0 ? type : TRANSITION_CUT;
+    transitionMillis = millis;
+}
+
+TransitionType Segment::getTransition() { return transition; }
+
+unsigned long Segment::getTransitionMillis() { return transitionMillis; }
+
 Program::Program(int segmentCount)
 {
     segments = new Segment*[segmentCount];
     numSegments = segmentCount;
     currentSegment = 0;
     isRunning = false;
+    frameDirty = false;
+    stateAllocated = false;
+    ownsSegments = true;
+    slotBytes = 0;
+    stateSlot = 0;
+    nextPrepared = false;
+    outgoingFrame = nullptr;
+    incomingFrame = nullptr;
+    transitioning = false;
+    previousSegment = 0;
+    transitionStart = 0;
+    seed = 0;
+    segmentStarts = 0;
+    currentSeedIndex = 0;
 
     for (int i = 0; i < numSegments; i++) {
         segments[i] = nullptr;
     }
 }
 
+Program::Program(InPlace, Segment** segmentArray, int segmentCount)
+{
+    segments = segmentArray;
+    numSegments = segmentCount;
+    currentSegment = 0;
+    isRunning = false;
+    frameDirty = false;
+    stateAllocated = false;
+    ownsSegments = false;
+    slotBytes = 0;
+    stateSlot = 0;
+    nextPrepared = false;
+    outgoingFrame = nullptr;
+    incomingFrame = nullptr;
+    transitioning = false;
+    previousSegment = 0;
+    transitionStart = 0;
+    seed = 0;
+    segmentStarts = 0;
+    currentSeedIndex = 0;
+}
+
 Program::~Program()
 {
+    if (!ownsSegments) {
+        return;
+    }
     for (int i = 0; i < numSegments; i++) {
         delete segments[i];
     }
@@ -173,42 +481,300 @@ void Program::addSegment(int index, Segment* segment)
     }
 }
 
-void Program::start()
+bool Program::allocateState()
 {
+    size_t bytes = 0;
+    bool transitions = false;
+    for (int i = 0; i < numSegments; i++) {
+        if (segments[i] != nullptr && segments[i]->getStateBytes() > bytes) {
+            bytes = segments[i]->getStateBytes();
+        }
+        transitions |= segments[i] != nullptr && segments[i]->getTransition() != TRANSITION_CUT;
+    }
+
+    slotBytes = alignUp(bytes, STATE_ALIGNMENT);
+    size_t slotsBytes = (numSegments > 1 ? 2 : 1) * slotBytes;
+    size_t frameBytes = alignUp(sizeof(CRGB) * TOTAL_LEDS, STATE_ALIGNMENT);
+    if (!arena.allocate(transitions ? slotsBytes + 2 * frameBytes : slotsBytes)) {
+        return false;
+    }
+    for (int i = 0; i < numSegments; i++) {
+        if (segments[i] != nullptr) {
+            segments[i]->bindState(arena.at(0));
+            segments[i]->addProfileProbes(i);
+        }
+    }
+    if (transitions) {
+        outgoingFrame = reinterpret_cast<CRGB*>(arena.at(slotsBytes));
+        incomingFrame = reinterpret_cast<CRGB*>(arena.at(slotsBytes + frameBytes));
+    }
+    stateAllocated = true;
+    return true;
+}
+
+size_t Program::getArenaBytes() { return arena.getCapacity(); }
+
+int Program::getNumSegments() { return numSegments; }
+
+int Program::getCurrentSegment() { return currentSegment; }
+
+unsigned long Program::getSegmentStart()
+{
+    if (currentSegment >= numSegments || segments[currentSegment] == nullptr) {
+        return 0;
+    }
+    return segments[currentSegment]->getStartTime();
+}
+
+uint32_t Program::getSegmentSeedIndex() { return currentSeedIndex; }
+
+unsigned long Program::getDurationMillis()
+{
+    unsigned long total = 0;
+    for (int i = 0; i < numSegments; i++) {
+        if (segments[i] != nullptr) {
+            total += segments[i]->getDurationMillis();
+        }
+    }
+    return total;
+}
+
+void Program::setSeed(uint32_t value) { seed = value; }
+
+uint32_t Program::nextSegmentSeed() { return mixSeed(seed, segmentStarts++); }
+
+size_t Program::getSegmentStateBytes(int index)
+{
+    if (index < 0 || index >= numSegments || segments[index] == nullptr) {
+        return 0;
+    }
+    return segments[index]->getStateBytes();
+}
+
+unsigned long Program::getSegmentDurationMillis(int index)
+{
+    if (index < 0 || index >= numSegments || segments[index] == nullptr) {
+        return 0;
+    }
+    return segments[index]->getDurationMillis();
+}
+
+void Program::start(unsigned long now)
+{
+    if (!stateAllocated && !allocateState()) {
+        return;
+    }
+
     if (numSegments > 0 && segments[0] != nullptr) {
         currentSegment = 0;
-        segments[currentSegment]->start();
+        stateSlot = 0;
+        nextPrepared = false;
+        transitioning = false;
+        segmentStarts = 0;
+        currentSeedIndex = 0;
+        segments[currentSegment]->bindState(arena.at(0));
+        segments[currentSegment]->prepare(nextSegmentSeed());
+        segments[currentSegment]->start(now);
         isRunning = true;
+        frameRate.reset(now);
     }
 }
 
+void Program::join(int index, unsigned long segmentStart, uint32_t seedIndex)
+{
+    if (!isRunning || index < 0 || index >= numSegments || segments[index] == nullptr) {
+        return;
+    }
+
+    if (transitioning) {
+        segments[previousSegment]->stop();
+        transitioning = false;
+    }
+    segments[currentSegment]->stop();
+    frameDirty = true;
+    currentSegment = index;
+    stateSlot = 0;
+    nextPrepared = false;
+    segmentStarts = seedIndex;
+    currentSeedIndex = seedIndex;
+    segments[currentSegment]->bindState(arena.at(0));
+    segments[currentSegment]->prepare(nextSegmentSeed());
+    segments[currentSegment]->start(segmentStart);
+}
+
 void Program::stop()
 {
     if (isRunning && currentSegment < numSegments && segments[currentSegment] != nullptr) {
+        if (transitioning) {
+            segments[previousSegment]->stop();
+            transitioning = false;
+        }
+        nextPrepared = false;
         segments[currentSegment]->stop();
+        frameDirty = true;
+        present(millis());
     }
     isRunning = false;
 }
 
-void Program::update()
+void Program::update(const FrameTime& time)
+{
+    if (render(time)) {
+        frameDirty = true;
+    }
+
+    present(time.now);
+}
+
+bool Program::render(const FrameTime& time)
 {
     if (!isRunning || currentSegment >= numSegments || segments[currentSegment] == nullptr) {
+        return false;
+    }
+
+    if (transitioning) {
+        return renderTransition(time);
+    }
+
+    Segment* segment = segments[currentSegment];
+    bool changed = segment->update(time);
+
+    // The next segment starts where this one was due to end, not on the
+    // frame that noticed, so the show keeps to its timeline
+    if (segment->isFinished(time.now)) {
+        nextSegment(segment->getStartTime() + segment->getDurationMillis());
+        changed = true;
+    }
+
+    return changed;
+}
+
+void Program::nextSegment(unsigned long boundary)
+{
+    Segment* outgoing = segments[currentSegment];
+    int next = (currentSegment + 1) % numSegments;
+    Segment* incoming = segments[next];
+
+    // The incoming segment takes the other state slot, where prepareNext()
+    // has usually readied it already
+    if (!nextPrepared) {
+        if (numSegments > 1) {
+            incoming->bindState(arena.at((1 - stateSlot) * slotBytes));
+        }
+        incoming->prepare(nextSegmentSeed());
+    }
+    if (numSegments > 1) {
+        stateSlot = 1 - stateSlot;
+    }
+    nextPrepared = false;
+    // Prepared from the latest seed, here or in prepareNext()
+    currentSeedIndex = segmentStarts - 1;
+
+    if (incoming->getTransition() == TRANSITION_CUT || outgoingFrame == nullptr || incoming == outgoing) {
+        // The blackout is folded into this frame's present instead of being
+        // shown on its own
+        outgoing->stop();
+        currentSegment = next;
+        incoming->start(boundary);
         return;
     }
 
-    segments[currentSegment]->update();
+    // The outgoing segment carries on from the frame it left in leds[] and
+    // the incoming one starts from black, each in a frame of its own. Pins the incoming segment turns around are noted so the
+    // outgoing frame is still shown the way it was rendered.
+    memcpy(outgoingFrame, leds, sizeof(CRGB) * TOTAL_LEDS);
+    memset(incomingFrame, 0, sizeof(CRGB) * TOTAL_LEDS);
+    bool wasReversed[NUM_PINS];
+    for (int pin = 0; pin < NUM_PINS; pin++) {
+        wasReversed[pin] = getPinReversed(pin);
+        transitionPins[pin] = false;
+    }
+    outgoing->usePins(transitionPins);
+    incoming->usePins(transitionPins);
 
-    if (segments[currentSegment]->isFinished()) {
-        segments[currentSegment]->stop();
-        currentSegment++;
+    previousSegment = currentSegment;
+    currentSegment = next;
+    incoming->start(boundary);
+    for (int pin = 0; pin < NUM_PINS; pin++) {
+        flipOutgoing[pin] = wasReversed[pin] != getPinReversed(pin);
+    }
+    transitionStart = boundary;
+    transitioning = true;
+}
+
+void Program::prepareNext()
+{
+    if (!isRunning || transitioning || nextPrepared || numSegments < 2) {
+        return;
+    }
+    Segment* next = segments[(currentSegment + 1) % numSegments];
+    next->bindState(arena.at((1 - stateSlot) * slotBytes));
+    next->prepare(nextSegmentSeed());
+    nextPrepared = true;
+}
+
+// Both segments render into their own frames and the transition combines
+// them into leds[]. Every frame of a transition is a new one.
+bool Program::renderTransition(const FrameTime& time)
+{
+    Segment* outgoing = segments[previousSegment];
+    Segment* incoming = segments[currentSegment];
+    CRGB* target = leds;
+    beginSideFrame();
+    leds = outgoingFrame;
+    outgoing->update(time);
+    leds = incomingFrame;
+    incoming->update(time);
+    leds = target;
+    endSideFrame();
 
-        if (currentSegment >= numSegments) {
-            currentSegment = 0;
-            segments[currentSegment]->start();
-        } else {
-            segments[currentSegment]->start();
+    float progress = (float)(time.now - transitionStart) / incoming->getTransitionMillis();
+    if (progress < 1) {
+        composeTransition(
+            incoming->getTransition(), progress, outgoingFrame, incomingFrame, target, transitionPins, flipOutgoing);
+    } else {
+        // The incoming segment renders into leds[] from here on
+        for (int pin = 0; pin < NUM_PINS; pin++) {
+            if (transitionPins[pin]) {
+                memcpy(target + pinOffset(pin), incomingFrame + pinOffset(pin), sizeof(CRGB) * pinLeds(pin));
+            }
+        }
+        outgoing->stop(false);
+        transitioning = false;
+    }
+
+    for (int pin = 0; pin < NUM_PINS; pin++) {
+        if (transitionPins[pin]) {
+            markPinDirty(pin);
         }
     }
+    return true;
 }
 
-bool Program::getIsRunning() { return isRunning; }
\ No newline at end of file
+void Program::present(unsigned long now)
+{
+    // Only push pixels out when some pattern produced a new frame, and then
+    // only on the pins it changed
+    bool presented = frameDirty;
+    if (frameDirty) {
+        bool dirty[NUM_PINS];
+        takeDirtyPins(dirty);
+        {
+            ProfileScope scope(PROFILE_PROBE_COMPOSE);
+            composeFrame(getOutputFrame(), dirty);
+        }
+        {
+            ProfileScope scope(PROFILE_PROBE_SHOW);
+            showPins(dirty);
+        }
+        frameDirty = false;
+    }
+
+    frameRate.update(now, presented);
+}
+
+bool Program::getIsRunning() { return isRunning; }
+
+unsigned long Program::getFramesPresented() { return frameRate.getTotalFrames(); }
+
+float Program::getFps() { return frameRate.getFps(); }
\ No newline at end of file
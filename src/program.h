@@ -1,77 +1,61 @@
 #ifndef PROGRAM_H
 #define PROGRAM_H
 
+#include "arena.h"
+#include "framerate.h"
+#include "layers.h"
+#include "patterns.h"
+#include "scheduler.h"
+#include "transition.h"
 #include <FastLED.h>
 
-enum PatternType {
-    PATTERN_BREATHING,
-    PATTERN_FLAME,
-    PATTERN_GROW,
-    PATTERN_CHASE,
-    PATTERN_POP,
-    PATTERN_SPIN
-};
-
-struct PatternParams {
-    union {
-        struct {
-            int speed;
-            CRGB* palette;
-            int paletteSize;
-        } breathing;
-        struct {
-            int speed;
-            int cooling;
-            int sparking;
-        } flame;
-        struct {
-            int speed;
-            int n;
-            int fadeDelay;
-            int holdDelay;
-            CRGB* palette;
-            int paletteSize;
-            int transitionSpeed;
-            int offsetDelay;
-        } grow;
-        struct {
-            int speed;
-            CRGB* palette;
-            int paletteSize;
-            int transitionSpeed;
-            int holdDelay;
-            int offsetDelay;
-        } chase;
-        struct {
-            int speed;
-            int holdDelay;
-            CRGB* palette;
-            int paletteSize;
-            bool random;
-            int accelerationTime;
-        } pop;
-        struct {
-            int speed;
-            int separation;
-            int span;
-            CRGB* palette;
-            int paletteSize;
-            bool loop;
-            bool continuous;
-            bool blend;
-        } spin;
-    };
-};
+// Objects built by the show loader sit in one block of memory that belongs to
+// the loader. Built with InPlace they use the arrays they are given instead
+// of copying them, and free nothing.
+struct InPlace { };
 
+// One pattern on a group of pins. It is built from the pattern's params
+// struct, which picks the pattern, and renders through that pattern's ops
+// table so nothing here needs to know the pattern types.
+//
+// Instances later in a segment are layers over the earlier ones on the pins
+// they share, blended as blend and opacity say. An instance that ends up
+// alone on all its pins and draws over black as it is renders straight into
+// leds[]; the others render into a layer of their own, which the segment
+// blends into leds[] on the pins where it shows.
 struct PatternInstance {
-    PatternType patternType;
+    const PatternOps* ops;
     int* pins;
     int numPins;
-    PatternParams params;
+    void* params;
     bool reverse;
-    
-    PatternInstance(PatternType type, int* pinArray, int pinCount, PatternParams parameters, bool reverseDirection = false);
+    BlendMode blend;
+    uint8_t opacity;
+    // Bound into the Program's arena before playback
+    void* state;
+    size_t stateSize;
+    // Set by the segment as it binds state: false when the instance is
+    // transparent or covered on all its pins, so it is not rendered, and the
+    // layer it renders into, indexed as leds[] is but backed only from its
+    // first pin to its last, or nullptr for leds[] itself
+    bool visible;
+    CRGB* layer;
+    bool ownsArrays;
+    // Profiler probe timing its render, -1 for none
+    int profileProbe;
+
+    template <typename P>
+    PatternInstance(int* pinArray, int pinCount, const P& parameters, bool reverseDirection = false)
+        : PatternInstance(&P::Pattern::ops, pinArray, pinCount, &parameters, reverseDirection)
+    {
+    }
+    PatternInstance(
+        const PatternOps* patternOps, int* pinArray, int pinCount, const void* parameters, bool reverseDirection = false);
+    PatternInstance(InPlace, const PatternOps* patternOps, int* pinArray, int pinCount, void* parameters,
+        bool reverseDirection);
     ~PatternInstance();
+    // Before the segment's state is bound
+    void setBlend(BlendMode mode, uint8_t layerOpacity = 255);
 };
 
 class Segment {
@@ -81,33 +65,139 @@ private:
     unsigned long duration;
     unsigned long startTime;
     bool isActive;
+    bool isPrepared;
+    bool ownsPatterns;
+    TransitionType transition;
+    unsigned long transitionMillis;
+    // For every pin, the layers blended into it, first to last, and whether
+    // each is read the other way round. Pins an instance draws straight
+    // into have none.
+    uint16_t* stackDepth;
+    uint16_t* stackLayers;
+    bool* stackFlips;
+    bool layered;
+
+    void init(PatternInstance** patternArray, int patternCount, unsigned long durationSeconds);
+    // Works out which instances are visible and which need layers, and lays
+    // the layers and stacks out in block; without one it only measures them
+    // and changes nothing
+    size_t planLayers(uint8_t* block);
+    void composeLayers(const bool pins[NUM_PINS]);
 
 public:
-    Segment(PatternType type, int* pinArray, int pinCount, unsigned long durationSeconds, PatternParams parameters, bool reverseDirection = false);
+    template <typename P>
+    Segment(int* pinArray, int pinCount, unsigned long durationSeconds, const P& parameters, bool reverseDirection = false)
+    {
+        PatternInstance* pattern = new PatternInstance(pinArray, pinCount, parameters, reverseDirection);
+        init(&pattern, 1, durationSeconds);
+    }
     Segment(PatternInstance** patternArray, int patternCount, unsigned long durationSeconds);
+    Segment(InPlace, PatternInstance** patternArray, int patternCount, unsigned long durationSeconds);
     ~Segment();
-    void start();
-    void stop();
-    bool isFinished();
-    void update();
+    // Resets the patterns' state ahead of start(), which then only has to
+    // note the time; start() prepares a segment that was not. Each instance
+    // is seeded from seed and its index.
+    void prepare(uint32_t seed);
+    void start(unsigned long now);
+    // Without blackout the pins keep what the segment left in leds[]
+    void stop(bool blackout = true);
+    bool isFinished(unsigned long now);
+    unsigned long getDurationMillis();
+    unsigned long getStartTime();
+    bool update(const FrameTime& time);
     void addPattern(PatternInstance* pattern);
+    // Bytes of arena this segment's patterns need, each block aligned
+    size_t getStateBytes();
+    // Moving the state undoes prepare()
+    void bindState(uint8_t* block);
+    // Gives each pattern a profiler probe, if the profiler is built in
+    void addProfileProbes(int segmentIndex);
+    // Sets the pins this segment's patterns draw on
+    void usePins(bool used[NUM_PINS]);
+    // How this segment comes in over the one before it
+    void setTransition(TransitionType type, unsigned long millis);
+    TransitionType getTransition();
+    unsigned long getTransitionMillis();
 };
 
 class Program {
 private:
     Segment** segments;
     int numSegments;
+    bool ownsSegments;
     int currentSegment;
     bool isRunning;
+    bool frameDirty;
+    FrameRateCounter frameRate;
+    StateArena arena;
+    bool stateAllocated;
+
+    // With more than one segment the arena holds two slots of segment state,
+    // so the next segment can be prepared while the current one plays and
+    // both can render through a transition. With transitions it also holds
+    // the two frames they render into.
+    size_t slotBytes;
+    int stateSlot;
+    bool nextPrepared;
+    CRGB* outgoingFrame;
+    CRGB* incomingFrame;
+    bool transitioning;
+    int previousSegment;
+    unsigned long transitionStart;
+    bool transitionPins[NUM_PINS];
+    bool flipOutgoing[NUM_PINS];
+
+    // Segments are seeded in the order they start, so a show plays the same
+    // for the same seed however early each was prepared
+    uint32_t seed;
+    uint32_t segmentStarts;
+    // Which of those the current segment was seeded as
+    uint32_t currentSeedIndex;
+    uint32_t nextSegmentSeed();
+
+    void present(unsigned long now);
+    // Switches to the next segment, which starts at boundary
+    void nextSegment(unsigned long boundary);
+    bool renderTransition(const FrameTime& time);
 
 public:
     Program(int segmentCount);
+    Program(InPlace, Segment** segmentArray, int segmentCount);
     ~Program();
     void addSegment(int index, Segment* segment);
-    void start();
+    // Sizes the arena for the largest segment and binds every segment into
+    // it. Segments take turns in two slots of the same bytes. Called from
+    // start() if it has not been done yet.
+    bool allocateState();
+    size_t getArenaBytes();
+    int getNumSegments();
+    int getCurrentSegment();
+    // Frame time the current segment started at
+    unsigned long getSegmentStart();
+    uint32_t getSegmentSeedIndex();
+    // One pass through every segment
+    unsigned long getDurationMillis();
+    // Seed for the patterns' random numbers from the next start() on
+    void setSeed(uint32_t value);
+    size_t getSegmentStateBytes(int index);
+    unsigned long getSegmentDurationMillis(int index);
+    void start(unsigned long now);
+    // Switches to segment index as if it had started at segmentStart and been
+    // seeded as segment start seedIndex, for a board joining a show that
+    // another board is playing.
+    void join(int index, unsigned long segmentStart, uint32_t seedIndex);
     void stop();
-    void update();
+    // Renders and presents one frame; the single-core loop() path
+    void update(const FrameTime& time);
+    // Renders one frame into leds[] without showing it; true if it changed
+    bool render(const FrameTime& time);
+    // Prepares the next segment in the other state slot so that switching to
+    // it costs nothing. Meant for the spare time after a frame; does nothing
+    // once done, during a transition or with a single segment.
+    void prepareNext();
     bool getIsRunning();
+    unsigned long getFramesPresented();
+    float getFps();
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,33 @@
+#include "replay.h"
+#include "output.h"
+#include "show_format.h"
+
+uint32_t frameChecksum(const CRGB* frame)
+{
+    // A rotated pin is hashed from its rotation on and then round from its
+    // start, as composeFrame() reads it
+    uint32_t hash = showChecksum(nullptr, 0);
+    for (int pin = 0; pin < NUM_PINS; pin++) {
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(frame + pinOffset(pin));
+        size_t at = sizeof(CRGB) * getPinRotation(pin);
+        size_t length = sizeof(CRGB) * pinLeds(pin);
+        hash = showChecksum(bytes + at, length - at, hash);
+        hash = showChecksum(bytes, at, hash);
+    }
+    return hash;
+}
+
+void traceProgram(Program& program, int fps, unsigned long frames, TraceCallback onFrame, void* context)
+{
+    bool dirty[NUM_PINS];
+    program.start(0);
+    for (unsigned long frame = 0; frame < frames; frame++) {
+        program.render(fixedFrameTime(frame, fps));
+        // Preparing early must not change the output, so the trace does it
+        // as the firmware does
+        program.prepareNext();
+        onFrame(frame, frameChecksum(leds), context);
+    }
+    program.stop();
+    takeDirtyPins(dirty);
+}
@@ -0,0 +1,27 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include "program.h"
+
+// Deterministic replay of a Program, for checking that a rewritten kernel
+// draws exactly what the old one did. traceProgram() plays the Program from
+// its start on fixedFrameTime() and hashes leds[] after every frame. The
+// patterns take their random numbers from the Program's seed, so the same
+// show, seed and frame count give the same trace on every run, and the first
+// frame whose hash differs is where the output changed. Frames are rendered
+// into leds[] only, nothing is shown, and the Program is stopped again after.
+//
+// Kernels use float, so a trace is only comparable with one recorded on the
+// same kind of target: the host replays host traces, the board its own.
+//
+// Trace files are text: a "# seed S fps F frames N" line, then one hash per
+// frame in hex.
+
+typedef void (*TraceCallback)(unsigned long frame, uint32_t hash, void* context);
+
+// Hash of the logical frame: pins that a pattern left rotated (output.h) are
+// hashed in order, so stepping in place hashes as writing the whole pin would
+uint32_t frameChecksum(const CRGB* frame);
+void traceProgram(Program& program, int fps, unsigned long frames, TraceCallback onFrame, void* context);
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <stdint.h>
+
+// Random numbers for patterns, kept in each instance's state and seeded when
+// the instance is prepared, so a show plays the same for the same seed
+// whatever else draws random numbers and however long its frames take.
+// xorshift32, with FastLED's random8 ranges.
+struct PatternRandom {
+    uint32_t state;
+
+    void seed(uint32_t value) { state = value != 0 ? value : 0x9E3779B9u; }
+
+    uint32_t next()
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+
+    uint8_t next8() { return next() >> 24; }
+    // 0 to lim - 1
+    uint8_t next8(uint8_t lim) { return (next8() * lim) >> 8; }
+    // min to lim - 1
+    uint8_t next8(uint8_t min, uint8_t lim) { return min + next8(lim - min); }
+    // 0 to n - 1, for shuffles
+    int below(int n) { return next() % n; }
+};
+
+// One seed from two, for deriving an instance's seed from the show's
+inline uint32_t mixSeed(uint32_t seed, uint32_t value)
+{
+    uint32_t x = seed ^ (value * 0x9E3779B9u);
+    x ^= x >> 16;
+    x *= 0x85EBCA6Bu;
+    x ^= x >> 13;
+    x *= 0xC2B2AE35u;
+    x ^= x >> 16;
+    return x;
+}
+
+#endif
@@ -0,0 +1,165 @@
+#include "scheduler.h"
+#include <Arduino.h>
+
+float stepsPerSecond(long intervalMs)
+{
+    if (intervalMs < 1) {
+        intervalMs = 1;
+    }
+    return 1000.0f / intervalMs;
+}
+
+int takeSteps(float& accumulator, float rate, float dt)
+{
+    accumulator += rate * dt;
+    int steps = (int)accumulator;
+    accumulator -= steps;
+    return steps;
+}
+
+FrameTime fixedFrameTime(unsigned long frame, int fps)
+{
+    FrameTime time;
+    time.now = (uint64_t)frame * 1000 / fps;
+    time.dt = frame > 0 ? 1.0f / fps : 0;
+    time.frame = frame;
+    return time;
+}
+
+FrameScheduler::FrameScheduler(int targetFps)
+{
+    setTargetFps(targetFps);
+    lastSampleMicros = 0;
+    clockMicros = 0;
+    nextFrameMicros = 0;
+    lastFrameMicros = 0;
+    frameBeginMicros = 0;
+    frameCount = 0;
+    slewMicros = 0;
+    started = false;
+    resetStats();
+}
+
+void FrameScheduler::setTargetFps(int targetFps)
+{
+    if (targetFps < 1) {
+        targetFps = 1;
+    }
+    framePeriodMicros = 1000000UL / targetFps;
+}
+
+int FrameScheduler::getTargetFps() { return 1000000UL / framePeriodMicros; }
+
+// micros() wraps after about 71 minutes; keep a 64-bit clock from its deltas
+uint64_t FrameScheduler::sampleClock()
+{
+    unsigned long current = micros();
+    clockMicros += (unsigned long)(current - lastSampleMicros);
+    lastSampleMicros = current;
+    return clockMicros;
+}
+
+void FrameScheduler::startClock()
+{
+    lastSampleMicros = micros();
+    clockMicros = (uint64_t)millis() * 1000;
+    nextFrameMicros = clockMicros;
+    lastFrameMicros = clockMicros;
+    started = true;
+}
+
+FrameTime FrameScheduler::beginFrame()
+{
+    if (!started) {
+        startClock();
+    }
+
+    if (slewMicros != 0) {
+        long limit = framePeriodMicros / 8;
+        long step = slewMicros > limit ? limit : slewMicros < -limit ? -limit : slewMicros;
+        clockMicros += step;
+        slewMicros -= step;
+    }
+
+    uint64_t current = sampleClock();
+
+    if (current < nextFrameMicros) {
+        // Sleep off most of the wait so other tasks get the core, then land
+        // on the slot with a short busy wait
+        unsigned long wait = nextFrameMicros - current;
+        if (wait > 2000) {
+            delay(wait / 1000 - 1);
+        }
+        while (sampleClock() < nextFrameMicros) {
+            delayMicroseconds(nextFrameMicros - clockMicros);
+        }
+    } else if (current - nextFrameMicros >= framePeriodMicros) {
+        unsigned long missed = (current - nextFrameMicros) / framePeriodMicros;
+        nextFrameMicros += (uint64_t)missed * framePeriodMicros;
+        skippedSlots += missed;
+    }
+
+    FrameTime time;
+    time.now = (unsigned long)(nextFrameMicros / 1000);
+    time.dt = (nextFrameMicros - lastFrameMicros) / 1000000.0f;
+    time.frame = frameCount++;
+
+    lastFrameMicros = nextFrameMicros;
+    nextFrameMicros += framePeriodMicros;
+    frameBeginMicros = micros();
+
+    return time;
+}
+
+void FrameScheduler::endFrame()
+{
+    unsigned long frameMicros = micros() - frameBeginMicros;
+
+    if (frameMicros > maxFrameMicros) {
+        maxFrameMicros = frameMicros;
+    }
+    if (frameMicros > framePeriodMicros) {
+        budgetOverruns++;
+    }
+}
+
+uint64_t FrameScheduler::getClockMicros()
+{
+    if (!started) {
+        startClock();
+    }
+    return sampleClock();
+}
+
+void FrameScheduler::lockClock(uint64_t clock, uint64_t slotMicros, unsigned long frame)
+{
+    getClockMicros();
+    clockMicros = clock;
+    slewMicros = 0;
+
+    // The first slot of the grid that has not passed, with a whole period
+    // before it so that its dt is a regular one
+    uint64_t slots = clock > slotMicros ? (clock - slotMicros + framePeriodMicros - 1) / framePeriodMicros : 0;
+    nextFrameMicros = slotMicros + slots * framePeriodMicros;
+    lastFrameMicros = nextFrameMicros - framePeriodMicros;
+    frameCount = frame + slots;
+}
+
+void FrameScheduler::slewClock(long micros) { slewMicros = micros; }
+
+uint64_t FrameScheduler::getSlotMicros() { return lastFrameMicros; }
+
+unsigned long FrameScheduler::getFrameCount() { return frameCount; }
+
+unsigned long FrameScheduler::getBudgetOverruns() { return budgetOverruns; }
+
+unsigned long FrameScheduler::getSkippedSlots() { return skippedSlots; }
+
+unsigned long FrameScheduler::getMaxFrameMicros() { return maxFrameMicros; }
+
+void FrameScheduler::resetStats()
+{
+    budgetOverruns = 0;
+    skippedSlots = 0;
+    maxFrameMicros = 0;
+}
@@ -0,0 +1,80 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdint.h>
+
+// Timing of one frame as seen by everything rendered in it. The clock is
+// sampled once per frame by the FrameScheduler, so all patterns of a
+// segment step from the same instant.
+struct FrameTime {
+    unsigned long now; // ms, same timebase as millis()
+    float dt; // seconds since the previous frame
+    unsigned long frame; // frames since the scheduler started
+};
+
+// Converts one of the patterns' step intervals into a rate per second
+float stepsPerSecond(long intervalMs);
+
+// Adds rate * dt to a fractional step accumulator and returns how many whole
+// steps fall into this frame. Patterns move by steps, not by frames, so they
+// look the same at any frame rate.
+int takeSteps(float& accumulator, float rate, float dt);
+
+// Time of a frame on a clock that moves exactly one period per frame, for
+// runs that must not depend on how long frames take
+FrameTime fixedFrameTime(unsigned long frame, int fps);
+
+// Paces frames at a fixed rate. beginFrame() waits for the next frame slot
+// and hands out that slot's time. A frame that starts a whole slot or more
+// late skips the missed slots and gets a longer dt, so motion keeps up with
+// wall time instead of slowing down.
+//
+// The frame clock starts from millis() and then counts micros(). A sync
+// follower (sync.h) steers it onto its leader's clock, so that both boards
+// render the same frames at the same moments.
+class FrameScheduler {
+private:
+    unsigned long framePeriodMicros;
+    unsigned long lastSampleMicros;
+    uint64_t clockMicros;
+    uint64_t nextFrameMicros;
+    uint64_t lastFrameMicros;
+    unsigned long frameBeginMicros;
+    unsigned long frameCount;
+    unsigned long budgetOverruns;
+    unsigned long skippedSlots;
+    unsigned long maxFrameMicros;
+    long slewMicros;
+    bool started;
+
+    void startClock();
+    uint64_t sampleClock();
+
+public:
+    FrameScheduler(int targetFps);
+    void setTargetFps(int targetFps);
+    int getTargetFps();
+
+    FrameTime beginFrame();
+    void endFrame();
+
+    uint64_t getClockMicros();
+    // Sets the frame clock to clock and moves the frame slots onto the grid
+    // of the slot at slotMicros, numbered frame
+    void lockClock(uint64_t clock, uint64_t slotMicros, unsigned long frame);
+    // Moves the frame clock by micros over the coming frames, by at most an
+    // eighth of a frame period per frame, in place of any slew under way
+    void slewClock(long micros);
+    // Frame clock at the slot of the frame begun last
+    uint64_t getSlotMicros();
+
+    unsigned long getFrameCount();
+    // Frames whose work took longer than one frame period
+    unsigned long getBudgetOverruns();
+    // Frame slots dropped because a frame started too late
+    unsigned long getSkippedSlots();
+    unsigned long getMaxFrameMicros();
+    void resetStats();
+};
+
+#endif
@@ -0,0 +1,184 @@
+#include "show.h"
+
+Program* buildMainProgram()
+{
+    // Create a program with 7 segments
+    Program* program = new Program(7);
+
+    // Segment 1: Spin pattern test on all pins for 15 seconds
+    int allPins[] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+    static CRGB spinPalette[] = { CRGB::Red, CRGB::Blue, CRGB::Green, CRGB::Yellow };
+    SpinParams spinParams;
+    spinParams.speed = 75; // Medium-fast speed
+    spinParams.separation = 20; // 20 LEDs of black space between colors
+    spinParams.span = 15; // Each color fills 15 LEDs
+    spinParams.palette = spinPalette;
+    spinParams.paletteSize = 4;
+    spinParams.loop = true; // Fill entire strip with repeating pattern
+    spinParams.continuous = true; // Use span/separation pattern instead of all LEDs
+    spinParams.blend = true; // Smooth color transitions using FastLED lerp8
+    program->addSegment(0, new Segment(allPins, 8, 15, spinParams));
+
+    // Segment 2: Multi-color breathing on all pins for 10 seconds
+    static CRGB breathingPalette[] = { CRGB::Purple, CRGB::Magenta, CRGB::Blue, CRGB::Cyan };
+    BreathingParams breathingParams;
+    breathingParams.speed = 50;
+    breathingParams.palette = breathingPalette;
+    breathingParams.paletteSize = 4;
+    Segment* breathingSegment = new Segment(allPins, 8, 10, breathingParams);
+    breathingSegment->setTransition(TRANSITION_CROSSFADE, 1500);
+    program->addSegment(1, breathingSegment);
+
+    // Segment 3: Flame pattern on all pins for 15 seconds
+    FlameParams flameParams;
+    flameParams.speed = 80;
+    flameParams.cooling = 55;
+    flameParams.sparking = 120;
+    Segment* flameSegment = new Segment(allPins, 8, 10, flameParams, 1);
+    flameSegment->setTransition(TRANSITION_CROSSFADE, 1000);
+    program->addSegment(2, flameSegment);
+
+    // Segment 4: Grow pattern on all pins for 20 seconds
+    static CRGB growPalette[] = { CRGB::Cyan, CRGB::Blue, CRGB::Purple, CRGB::Magenta, CRGB::Red, CRGB::Orange };
+    GrowParams growParams;
+    growParams.speed = 60;
+    growParams.n = 1;
+    growParams.fadeDelay = 100;
+    growParams.holdDelay = 2000;
+    growParams.palette = growPalette;
+    growParams.paletteSize = 6;
+    growParams.transitionSpeed = 40;
+    growParams.offsetDelay = 1000;
+    Segment* growSegment = new Segment(allPins, 8, 10, growParams, 1);
+    growSegment->setTransition(TRANSITION_WIPE, 1000);
+    program->addSegment(3, growSegment);
+
+    // Segment 5: Multi-pattern segment - different patterns on different pins
+    // Create pattern instances for different pin groups
+    PatternInstance* patterns[3];
+
+    // Breathing on pins 0-2
+    int breathingPins[] = { 0, 1, 2 };
+    static CRGB multiBreathingPalette[] = { CRGB(0, 255, 128), CRGB::Green, CRGB::Teal };
+    BreathingParams multiBreathingParams;
+    multiBreathingParams.speed = 60;
+    multiBreathingParams.palette = multiBreathingPalette;
+    multiBreathingParams.paletteSize = 3;
+    patterns[0] = new PatternInstance(breathingPins, 3, multiBreathingParams);
+
+    // Flame on pins 3-5
+    int flamePins[] = { 3, 4, 5 };
+    FlameParams multiFlameParams;
+    multiFlameParams.speed = 90;
+    multiFlameParams.cooling = 60;
+    multiFlameParams.sparking = 130;
+    patterns[1] = new PatternInstance(flamePins, 3, multiFlameParams);
+
+    int growPins[] = { 6, 7 };
+    GrowParams growParams2;
+    growParams2.speed = 60;
+    growParams2.n = 1;
+    growParams2.fadeDelay = 100;
+    growParams2.holdDelay = 2000;
+    growParams2.palette = growPalette;
+    growParams2.paletteSize = 6;
+    growParams2.transitionSpeed = 40;
+    growParams2.offsetDelay = 1000;
+    patterns[2] = new PatternInstance(growPins, 2, growParams2);
+
+    program->addSegment(4, new Segment(patterns, 3, 5));
+
+    // Segment 6: Pop pattern with random pins and acceleration
+    static CRGB popPalette[]
+        = { CRGB::Red, CRGB::Orange, CRGB::Yellow, CRGB::Green, CRGB::Blue, CRGB::Purple, CRGB::Pink, CRGB::White };
+    PopParams popParams;
+    popParams.speed = 10; // Maximum speed after acceleration
+    popParams.holdDelay = 300; // Hold each color for 300ms
+    popParams.palette = popPalette;
+    popParams.paletteSize = 8;
+    popParams.random = true; // Randomize pin order
+    popParams.accelerationTime = 8; // Accelerate over 8 seconds
+    Segment* popSegment = new Segment(allPins, 8, 20, popParams);
+    popSegment->setTransition(TRANSITION_STAGGER, 2000);
+    program->addSegment(5, popSegment);
+
+    // Segment 7: Complex multi-pattern symphony - showcase of all features
+    PatternInstance* symphonyPatterns[4];
+
+    // Pattern 1: Pulsing ocean colors on pins 0-1 with smooth breathing
+    int oceanPins[] = { 0, 1 };
+    static CRGB oceanPalette[] = { 
+        CRGB(0, 100, 150),    // Deep blue
+        CRGB(0, 150, 200),    // Ocean blue  
+        CRGB(0, 200, 255),    // Bright cyan
+        CRGB(100, 255, 200),  // Aqua green
+        CRGB(0, 255, 255)     // Pure cyan
+    };
+    BreathingParams oceanParams;
+    oceanParams.speed = 25;
+    oceanParams.palette = oceanPalette;
+    oceanParams.paletteSize = 5;
+    symphonyPatterns[0] = new PatternInstance(oceanPins, 2, oceanParams);
+
+    // Pattern 2: Rapid spinning rainbow on pins 2-3 with blending
+    int rainbowPins[] = { 2, 3 };
+    static CRGB rainbowPalette[] = { 
+        CRGB::Red, CRGB::Orange, CRGB::Yellow, CRGB::Green, 
+        CRGB::Blue, CRGB::Indigo, CRGB::Violet, CRGB::Magenta 
+    };
+    SpinParams rainbowParams;
+    rainbowParams.speed = 90;
+    rainbowParams.separation = 8;
+    rainbowParams.span = 12;
+    rainbowParams.palette = rainbowPalette;
+    rainbowParams.paletteSize = 8;
+    rainbowParams.loop = true;
+    rainbowParams.continuous = false;
+    rainbowParams.blend = true;
+    symphonyPatterns[1] = new PatternInstance(rainbowPins, 2, rainbowParams);
+
+    // Pattern 3: Growing sunset on pins 4-5 with staggered timing
+    int sunsetPins[] = { 4, 5 };
+    static CRGB sunsetPalette[] = { 
+        CRGB(255, 40, 0),     // Deep red
+        CRGB(255, 100, 0),    // Orange-red
+        CRGB(255, 150, 0),    // Orange
+        CRGB(255, 200, 50),   // Yellow-orange
+        CRGB(255, 255, 100)   // Warm yellow
+    };
+    GrowParams sunsetParams;
+    sunsetParams.speed = 45;
+    sunsetParams.n = 3;
+    sunsetParams.fadeDelay = 150;
+    sunsetParams.holdDelay = 3000;
+    sunsetParams.palette = sunsetPalette;
+    sunsetParams.paletteSize = 5;
+    sunsetParams.transitionSpeed = 30;
+    sunsetParams.offsetDelay = 2000;
+    symphonyPatterns[2] = new PatternInstance(sunsetPins, 2, sunsetParams);
+
+    // Pattern 4: Accelerating neon flash on pins 6-7
+    int neonPins[] = { 6, 7 };
+    static CRGB neonPalette[] = { 
+        CRGB(255, 0, 255),    // Magenta
+        CRGB(0, 255, 255),    // Cyan
+        CRGB(255, 255, 0),    // Yellow
+        CRGB(255, 0, 128),    // Hot pink
+        CRGB(128, 255, 0),    // Lime green
+        CRGB(255, 128, 0)     // Neon orange
+    };
+    PopParams neonParams;
+    neonParams.speed = 80;
+    neonParams.holdDelay = 200;
+    neonParams.palette = neonPalette;
+    neonParams.paletteSize = 6;
+    neonParams.random = true;
+    neonParams.accelerationTime = 15;
+    symphonyPatterns[3] = new PatternInstance(neonPins, 2, neonParams);
+
+    Segment* symphonySegment = new Segment(symphonyPatterns, 4, 25);
+    symphonySegment->setTransition(TRANSITION_CROSSFADE, 1500);
+    program->addSegment(6, symphonySegment);
+
+    return program;
+}
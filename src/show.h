@@ -0,0 +1,10 @@
+#ifndef SHOW_H
+#define SHOW_H
+
+#include "program.h"
+
+// Builds the installation's 7-segment show. Shared by the firmware and the
+// host tools so both run the same Program.
+Program* buildMainProgram();
+
+#endif
\ No newline at end of file
@@ -0,0 +1,83 @@
+#ifndef SHOW_FORMAT_H
+#define SHOW_FORMAT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Binary show image, as written by host/showc and read by loadShow(). All
+// records are fixed width and little-endian, which both the ESP32 and the
+// host are, and are read with memcpy so the image needs no alignment.
+//
+//   ShowHeader
+//   ShowSegment[numSegments]
+//   ShowInstance[numInstances]   each segment's instances are contiguous
+//   int32_t values[numValues]    each instance's params in field order
+//   ShowColor colors[numColors]
+//   uint8_t pins[numPins]
+//
+// Params are stored field by field, as the pattern's ParamField table lists
+// them, rather than as the params struct, so the image does not depend on
+// the struct layout of the target. An int or bool field takes one value, a
+// palette two: its first color and its size.
+#define SHOW_MAGIC "FLSH"
+#define SHOW_VERSION 3
+#define SHOW_PATTERN_NAME_BYTES 12
+
+struct ShowHeader {
+    char magic[4];
+    uint16_t version;
+    uint16_t numSegments;
+    uint16_t numInstances;
+    uint16_t numPins;
+    uint16_t numValues;
+    uint16_t numColors;
+    // Whole image, header included
+    uint32_t totalBytes;
+    // FNV-1a over everything after the header
+    uint32_t checksum;
+};
+
+struct ShowSegment {
+    uint32_t durationSeconds;
+    uint16_t firstInstance;
+    uint16_t numInstances;
+    // TransitionType the segment comes in with, and its length
+    uint16_t transitionMillis;
+    uint8_t transition;
+    uint8_t reserved;
+};
+
+struct ShowInstance {
+    char pattern[SHOW_PATTERN_NAME_BYTES];
+    uint16_t firstPin;
+    uint8_t numPins;
+    uint8_t reverse;
+    uint16_t firstValue;
+    uint16_t numValues;
+    // BlendMode of the instance's layer, and its opacity
+    uint8_t blend;
+    uint8_t opacity;
+};
+
+struct ShowColor {
+    uint8_t r;
+    uint8_t g;
+    uint8_t b;
+};
+
+static_assert(sizeof(ShowHeader) == 24, "show header must not be padded");
+static_assert(sizeof(ShowSegment) == 12, "show segment must not be padded");
+static_assert(sizeof(ShowInstance) == 22, "show instance must not be padded");
+static_assert(sizeof(ShowColor) == 3, "show color must not be padded");
+
+// FNV-1a. A checksum over several pieces passes the hash of the ones before
+// on, and comes out as over the pieces end to end.
+inline uint32_t showChecksum(const uint8_t* bytes, size_t size, uint32_t hash = 2166136261u)
+{
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+#endif
@@ -0,0 +1,235 @@
+#include "show_loader.h"
+#include <new>
+
+#ifdef ARDUINO_ARCH_ESP32
+#include <LittleFS.h>
+#else
+#include <stdio.h>
+#endif
+
+// Start of each table in the image
+struct ShowSections {
+    const uint8_t* segments;
+    const uint8_t* instances;
+    const uint8_t* values;
+    const uint8_t* colors;
+    const uint8_t* pins;
+};
+
+template <typename T> static T readRecord(const uint8_t* table, size_t index)
+{
+    T record;
+    memcpy(&record, table + index * sizeof(T), sizeof(T));
+    return record;
+}
+
+static bool readHeader(const uint8_t* image, size_t size, ShowHeader& header, ShowSections& sections)
+{
+    if (image == nullptr || size < sizeof(ShowHeader)) {
+        return false;
+    }
+    memcpy(&header, image, sizeof(header));
+    if (memcmp(header.magic, SHOW_MAGIC, sizeof(header.magic)) != 0 || header.version != SHOW_VERSION) {
+        return false;
+    }
+
+    sections.segments = image + sizeof(ShowHeader);
+    sections.instances = sections.segments + header.numSegments * sizeof(ShowSegment);
+    sections.values = sections.instances + header.numInstances * sizeof(ShowInstance);
+    sections.colors = sections.values + header.numValues * sizeof(int32_t);
+    sections.pins = sections.colors + header.numColors * sizeof(ShowColor);
+    size_t expected = sections.pins + header.numPins - image;
+    if (header.totalBytes != size || expected != size || header.numSegments == 0) {
+        return false;
+    }
+    return showChecksum(image + sizeof(ShowHeader), size - sizeof(ShowHeader)) == header.checksum;
+}
+
+static const PatternOps* findPattern(const ShowInstance& instance)
+{
+    char name[SHOW_PATTERN_NAME_BYTES + 1];
+    memcpy(name, instance.pattern, SHOW_PATTERN_NAME_BYTES);
+    name[SHOW_PATTERN_NAME_BYTES] = '\0';
+    return Patterns::find(name);
+}
+
+static int valuesForFields(const ParamField* fields)
+{
+    int count = 0;
+    for (const ParamField* field = fields; field->name != nullptr; field++) {
+        count += field->type == PARAM_PALETTE ? 2 : 1;
+    }
+    return count;
+}
+
+// Every index in the image, and every int param against its field's range,
+// is checked once here so that building and the patterns can trust them
+static bool validateShow(const ShowHeader& header, const ShowSections& sections)
+{
+    for (int i = 0; i < header.numSegments; i++) {
+        ShowSegment segment = readRecord<ShowSegment>(sections.segments, i);
+        if (segment.firstInstance + segment.numInstances > header.numInstances
+            || segment.transition > TRANSITION_STAGGER) {
+            return false;
+        }
+    }
+
+    for (int i = 0; i < header.numInstances; i++) {
+        ShowInstance instance = readRecord<ShowInstance>(sections.instances, i);
+        const PatternOps* ops = findPattern(instance);
+        if (ops == nullptr || instance.firstPin + instance.numPins > header.numPins
+            || instance.firstValue + instance.numValues > header.numValues
+            || instance.numValues != valuesForFields(ops->fields) || instance.blend > BLEND_ALPHA) {
+            return false;
+        }
+        for (int p = 0; p < instance.numPins; p++) {
+            if (sections.pins[instance.firstPin + p] >= NUM_PINS) {
+                return false;
+            }
+        }
+
+        int value = instance.firstValue;
+        for (const ParamField* field = ops->fields; field->name != nullptr; field++) {
+            if (field->type == PARAM_PALETTE) {
+                int32_t first = readRecord<int32_t>(sections.values, value);
+                int32_t count = readRecord<int32_t>(sections.values, value + 1);
+                // Compared without adding, which could overflow
+                if (first < 0 || count < 0 || first > header.numColors || count > header.numColors - first) {
+                    return false;
+                }
+            } else if (field->type == PARAM_INT) {
+                int32_t setting = readRecord<int32_t>(sections.values, value);
+                if (setting < field->min || setting > field->max) {
+                    return false;
+                }
+            }
+            value += field->type == PARAM_PALETTE ? 2 : 1;
+        }
+    }
+    return true;
+}
+
+static void buildParams(uint8_t* params, const PatternOps* ops, const ShowSections& sections, int value, CRGB* colors)
+{
+    memset(params, 0, ops->paramsSize);
+    for (const ParamField* field = ops->fields; field->name != nullptr; field++) {
+        int32_t first = readRecord<int32_t>(sections.values, value++);
+        if (field->type == PARAM_INT) {
+            *reinterpret_cast<int*>(params + field->offset) = first;
+        } else if (field->type == PARAM_BOOL) {
+            *reinterpret_cast<bool*>(params + field->offset) = first != 0;
+        } else {
+            *reinterpret_cast<CRGB**>(params + field->offset) = colors + first;
+            *reinterpret_cast<int*>(params + field->sizeOffset) = readRecord<int32_t>(sections.values, value++);
+        }
+    }
+}
+
+// Carves the Program and everything it points to out of one block, in the
+// way pattern state is laid out. On a null block it only measures.
+static Program* layoutShow(const ShowHeader& header, const ShowSections& sections, void* block, size_t* size)
+{
+    StateLayout layout(block);
+    Program* program = layout.take<Program>(1);
+    Segment** segmentArray = layout.take<Segment*>(header.numSegments);
+    Segment* segments = layout.take<Segment>(header.numSegments);
+    PatternInstance** instanceArray = layout.take<PatternInstance*>(header.numInstances);
+    PatternInstance* instances = layout.take<PatternInstance>(header.numInstances);
+    int* pins = layout.take<int>(header.numPins);
+    CRGB* colors = layout.take<CRGB>(header.numColors);
+
+    if (block != nullptr) {
+        for (int i = 0; i < header.numPins; i++) {
+            pins[i] = sections.pins[i];
+        }
+        for (int i = 0; i < header.numColors; i++) {
+            ShowColor color = readRecord<ShowColor>(sections.colors, i);
+            colors[i] = CRGB(color.r, color.g, color.b);
+        }
+    }
+
+    for (int i = 0; i < header.numInstances; i++) {
+        ShowInstance instance = readRecord<ShowInstance>(sections.instances, i);
+        const PatternOps* ops = findPattern(instance);
+        uint8_t* params = reinterpret_cast<uint8_t*>(
+            layout.take<max_align_t>((ops->paramsSize + sizeof(max_align_t) - 1) / sizeof(max_align_t)));
+        if (block != nullptr) {
+            buildParams(params, ops, sections, instance.firstValue, colors);
+            instanceArray[i] = new (&instances[i])
+                PatternInstance(InPlace(), ops, pins + instance.firstPin, instance.numPins, params, instance.reverse);
+            instanceArray[i]->setBlend((BlendMode)instance.blend, instance.opacity);
+        }
+    }
+
+    if (size != nullptr) {
+        *size = layout.size();
+    }
+    if (block == nullptr) {
+        return nullptr;
+    }
+
+    for (int i = 0; i < header.numSegments; i++) {
+        ShowSegment segment = readRecord<ShowSegment>(sections.segments, i);
+        segmentArray[i] = new (&segments[i])
+            Segment(InPlace(), instanceArray + segment.firstInstance, segment.numInstances, segment.durationSeconds);
+        segmentArray[i]->setTransition((TransitionType)segment.transition, segment.transitionMillis);
+    }
+    return new (program) Program(InPlace(), segmentArray, header.numSegments);
+}
+
+size_t showMemoryBytes(const uint8_t* image, size_t size)
+{
+    ShowHeader header;
+    ShowSections sections;
+    if (!readHeader(image, size, header, sections) || !validateShow(header, sections)) {
+        return 0;
+    }
+    size_t bytes;
+    layoutShow(header, sections, nullptr, &bytes);
+    // Room to align the block
+    return bytes + alignof(max_align_t);
+}
+
+Program* loadShow(const uint8_t* image, size_t size, void* memory, size_t memoryBytes)
+{
+    size_t needed = showMemoryBytes(image, size);
+    if (needed == 0 || memory == nullptr || memoryBytes < needed) {
+        return nullptr;
+    }
+    ShowHeader header;
+    ShowSections sections;
+    readHeader(image, size, header, sections);
+    void* block = reinterpret_cast<void*>(alignUp(reinterpret_cast<uintptr_t>(memory), alignof(max_align_t)));
+    return layoutShow(header, sections, block, nullptr);
+}
+
+#ifdef ARDUINO_ARCH_ESP32
+
+bool readShowFile(const char* path, uint8_t* buffer, size_t capacity, size_t* size)
+{
+    File file = LittleFS.open(path, "r");
+    if (!file) {
+        return false;
+    }
+    *size = file.size();
+    bool complete = *size <= capacity && file.read(buffer, *size) == *size;
+    file.close();
+    return complete;
+}
+
+#else
+
+bool readShowFile(const char* path, uint8_t* buffer, size_t capacity, size_t* size)
+{
+    FILE* file = fopen(path, "rb");
+    if (file == nullptr) {
+        return false;
+    }
+    *size = fread(buffer, 1, capacity, file);
+    // Anything left over means the image did not fit
+    bool complete = fgetc(file) == EOF && !ferror(file);
+    fclose(file);
+    return complete;
+}
+
+#endif
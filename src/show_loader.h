@@ -0,0 +1,21 @@
+#ifndef SHOW_LOADER_H
+#define SHOW_LOADER_H
+
+#include "program.h"
+#include "show_format.h"
+
+// Builds a Program from a show image in one pass. Everything the Program
+// needs, down to pin arrays, params and palettes, is placed in the memory
+// given, so loading allocates nothing; only the state arena is allocated
+// later, as for any Program. showMemoryBytes() says how much memory that
+// takes, or 0 if the image is not valid. loadShow() returns nullptr when the
+// image is not valid or the memory is too small. The image can be freed
+// after loading. The Program is destroyed with ~Program(), not delete.
+size_t showMemoryBytes(const uint8_t* image, size_t size);
+Program* loadShow(const uint8_t* image, size_t size, void* memory, size_t memoryBytes);
+
+// Reads a show image from LittleFS on the ESP32 or from a file on the host.
+// False if it is missing or larger than capacity.
+bool readShowFile(const char* path, uint8_t* buffer, size_t capacity, size_t* size);
+
+#endif
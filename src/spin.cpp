@@ -2,120 +2,236 @@
 #include <Arduino.h>
 #include <FastLED.h>
 
-static unsigned long lastUpdateTime = 0;
-static int currentPosition[8] = { 0 };
+// One step clock for the instance and a rotation per pin slot. Continuous and
+// loop modes draw the same cycle on every pin, only rotated, so the cycle is
+// rendered once into the gradient LUT when the instance is prepared and each
+// pin is then a rotated copy of it. A continuous cycle is as long as its pin, so each pin
+// length gets a cycle of its own in the LUT, which has room for every length
+// of the layout; gradientAt is where a pin slot's cycle starts.
+struct SpinState {
+    float* stepAccumulator;
+    int* currentPosition;
+    int* gradientLength; // 0 if not built, -1 if the cycle is longer than the LUT
+    int* gradientAt;
+    CRGB* gradient;
+};
 
-void resetSpinPattern() {
-    lastUpdateTime = 0;
-    for (int i = 0; i < 8; i++) {
-        currentPosition[i] = 0;
+static SpinState layoutSpinState(void* block, int numPins, size_t* size = nullptr) {
+    StateLayout layout(block);
+    SpinState state;
+    state.stepAccumulator = layout.take<float>(1);
+    state.currentPosition = layout.take<int>(numPins);
+    state.gradientLength = layout.take<int>(1);
+    state.gradientAt = layout.take<int>(numPins);
+    state.gradient = layout.take<CRGB>(DISTINCT_PIN_LEDS);
+    if (size)
+        *size = layout.size();
+    return state;
+}
+
+size_t SpinPattern::stateSize(int numPins) {
+    size_t size;
+    layoutSpinState(nullptr, numPins, &size);
+    return size;
+}
+
+void SpinPattern::reset(void* state, int numPins) {
+    memset(state, 0, stateSize(numPins));
+
+    // Start with one step due so the first frame of a segment renders
+    *layoutSpinState(state, numPins).stepAccumulator = 1.0;
+}
+
+// Continuous mode: all LEDs transitioning through palette colors
+static CRGB continuousColor(int cyclePosition, int totalLeds, const SpinParams& params) {
+    // Calculate position in the pattern cycle
+    float cyclePos = (float)cyclePosition / totalLeds;
+
+    // Scale to palette range and get fractional part for blending
+    float palettePos = cyclePos * params.paletteSize;
+    int colorIndex1 = (int)palettePos % params.paletteSize;
+    int colorIndex2 = (colorIndex1 + 1) % params.paletteSize;
+    float blendAmount = palettePos - (int)palettePos;
+
+    if (params.blend) {
+        // Use FastLED's lerp8 for smooth blending
+        return params.palette[colorIndex1].lerp8(params.palette[colorIndex2], (uint8_t)(blendAmount * 255));
+    }
+    // Use discrete colors without blending
+    return params.palette[colorIndex1];
+}
+
+// Loop mode: spans of color separated by black, repeating along the strip
+static CRGB loopColor(int patternPos, const SpinParams& params) {
+    int span = params.span;
+    int colorIndex = patternPos / (span + params.separation);
+    int posInColor = patternPos % (span + params.separation);
+
+    if (posInColor >= span) {
+        // Separation areas stay black
+        return CRGB::Black;
+    }
+    if (params.blend && span > 1) {
+        // Blend within each span
+        float spanProgress = (float)posInColor / (span - 1);
+        int nextColorIndex = (colorIndex + 1) % params.paletteSize;
+        return params.palette[colorIndex % params.paletteSize].lerp8(params.palette[nextColorIndex], (uint8_t)(spanProgress * 255));
     }
+    return params.palette[colorIndex % params.paletteSize];
 }
 
-void spinPattern(int pins[], int numPins, int speed, int separation, int span, CRGB palette[], int paletteSize, bool loop, bool continuous, bool blend, bool reverse) {
-    if (numPins == 0 || paletteSize == 0 || span <= 0 || separation < 0) return;
-    
-    unsigned long currentTime = millis();
+static int cycleLength(const SpinParams& params, int totalLeds) {
+    if (params.continuous) {
+        return totalLeds;
+    }
+    return (params.paletteSize * params.span) + (params.paletteSize * params.separation);
+}
+
+// Renders the cycles of every pin slot into the LUT. Returns the loop's cycle
+// length, the LUT length used in continuous mode, or -1 if the loop does not
+// fit.
+static int buildGradients(const SpinState& s, const SpinParams& params, int pins[], int numPins) {
+    if (!params.continuous) {
+        int length = cycleLength(params, 0);
+        if (length > MAX_LEDS_PER_PIN) {
+            return -1;
+        }
+        for (int k = 0; k < length; k++) {
+            s.gradient[k] = loopColor(k, params);
+        }
+        for (int p = 0; p < numPins; p++) {
+            s.gradientAt[p] = 0;
+        }
+        return length;
+    }
+
+    int used = 0;
+    for (int p = 0; p < numPins; p++) {
+        int totalLeds = pinLeds(pins[p]);
+        s.gradientAt[p] = -1;
+        for (int q = 0; q < p && s.gradientAt[p] < 0; q++) {
+            if (pinLeds(pins[q]) == totalLeds) {
+                s.gradientAt[p] = s.gradientAt[q];
+            }
+        }
+        if (s.gradientAt[p] < 0) {
+            s.gradientAt[p] = used;
+            for (int k = 0; k < totalLeds; k++) {
+                s.gradient[used + k] = continuousColor(k, totalLeds, params);
+            }
+            used += totalLeds;
+        }
+    }
+    return used;
+}
+
+// LED i shows cycle position (i + position) % length, which is the LUT read
+// from position onwards: at most a couple of block copies.
+static void copyGradient(CRGB* out, int totalLeds, const CRGB* gradient, int length, int position) {
+    int offset = position % length;
+    int written = 0;
+    while (written < totalLeds) {
+        int chunk = min(length - offset, totalLeds - written);
+        memcpy(out + written, gradient + offset, chunk * sizeof(CRGB));
+        written += chunk;
+        offset = 0;
+    }
+}
+
+void SpinPattern::prepare(void* state, int pins[], int numPins, const SpinParams& params, bool reverse, uint32_t seed) {
+    reset(state, numPins);
+
+    bool rotates = params.continuous || params.loop;
+    if (!rotates || numPins == 0 || params.paletteSize == 0 || params.span <= 0 || params.separation < 0) return;
+    SpinState s = layoutSpinState(state, numPins);
+    *s.gradientLength = buildGradients(s, params, pins, numPins);
+}
+
+bool SpinPattern::render(const FrameTime& time, void* state, int pins[], int numPins, const SpinParams& params, bool reverse) {
+    int speed = params.speed;
+    int separation = params.separation;
+    int span = params.span;
+    CRGB* palette = params.palette;
+    int paletteSize = params.paletteSize;
+    bool loop = params.loop;
+    bool continuous = params.continuous;
+    bool blend = params.blend;
+
+    if (numPins == 0 || paletteSize == 0 || span <= 0 || separation < 0) return false;
+
+    SpinState s = layoutSpinState(state, numPins);
     unsigned long updateDelay = map(speed, 1, 100, 200, 10);
-    
-    if (currentTime - lastUpdateTime >= updateDelay) {
-        lastUpdateTime = currentTime;
-        
+    int steps = takeSteps(*s.stepAccumulator, stepsPerSecond(updateDelay), time.dt);
+
+    bool rotates = continuous || loop;
+
+    if (steps > 0) {
         for (int p = 0; p < numPins; p++) {
             int pin = pins[p];
-            int startIndex = pin * NUM_LEDS_PER_STRIP * NUM_STRIPS_PER_PIN;
-            int totalLeds = NUM_LEDS_PER_STRIP * NUM_STRIPS_PER_PIN;
-            
-            if (continuous) {
-                // Continuous mode: light all LEDs transitioning through palette colors
+            int startIndex = pinOffset(pin);
+            int totalLeds = pinLeds(pin);
+            markPinDirty(pin);
+
+            if (rotates && *s.gradientLength > 0) {
+                int length = continuous ? totalLeds : *s.gradientLength;
+                copyGradient(
+                    leds + startIndex, totalLeds, s.gradient + s.gradientAt[p], length, s.currentPosition[p]);
+            } else if (rotates) {
+                // Loop longer than the strip: no LUT, work it out per LED
+                int patternLength = cycleLength(params, totalLeds);
                 for (int i = 0; i < totalLeds; i++) {
-                    // Calculate position in the pattern cycle
-                    float cyclePos = (float)((i + currentPosition[pin]) % totalLeds) / totalLeds;
-                    
-                    // Scale to palette range and get fractional part for blending
-                    float palettePos = cyclePos * paletteSize;
-                    int colorIndex1 = (int)palettePos % paletteSize;
-                    int colorIndex2 = (colorIndex1 + 1) % paletteSize;
-                    float blendAmount = palettePos - (int)palettePos;
-                    
-                    CRGB color;
-                    if (blend) {
-                        // Use FastLED's lerp8 for smooth blending
-                        color = palette[colorIndex1].lerp8(palette[colorIndex2], (uint8_t)(blendAmount * 255));
-                    } else {
-                        // Use discrete colors without blending
-                        color = palette[colorIndex1];
-                    }
-                    
-                    int ledPos = reverse ? (totalLeds - 1 - i) : i;
-                    leds[startIndex + ledPos] = color;
+                    leds[startIndex + i] = loopColor((i + s.currentPosition[p]) % patternLength, params);
                 }
             } else {
                 // Clear all LEDs for this pin first
                 for (int i = 0; i < totalLeds; i++) {
                     leds[startIndex + i] = CRGB::Black;
                 }
-                
-                if (loop) {
-                    // Loop mode: fill the entire strip with repeating pattern
-                    int patternLength = (paletteSize * span) + (paletteSize * separation);
-                    
-                    for (int i = 0; i < totalLeds; i++) {
-                        int patternPos = (i + currentPosition[pin]) % patternLength;
-                        int colorIndex = patternPos / (span + separation);
-                        int posInColor = patternPos % (span + separation);
-                        
-                        if (posInColor < span) {
-                            CRGB color;
-                            if (blend && span > 1) {
-                                // Blend within each span
-                                float spanProgress = (float)posInColor / (span - 1);
-                                int nextColorIndex = (colorIndex + 1) % paletteSize;
-                                color = palette[colorIndex % paletteSize].lerp8(palette[nextColorIndex], (uint8_t)(spanProgress * 255));
-                            } else {
-                                color = palette[colorIndex % paletteSize];
-                            }
-                            
-                            int ledPos = reverse ? (totalLeds - 1 - i) : i;
-                            leds[startIndex + ledPos] = color;
-                        }
-                        // Separation areas remain black (already cleared above)
-                    }
-                } else {
-                    // Single cycle mode: show each color once per cycle
-                    for (int colorIndex = 0; colorIndex < paletteSize; colorIndex++) {
-                        
-                        // Calculate the starting position for this color
-                        int colorStartPos = colorIndex * (span + separation);
-                        
-                        // Draw the span for this color
-                        for (int spanIndex = 0; spanIndex < span; spanIndex++) {
-                            int ledPos = (currentPosition[pin] + colorStartPos + spanIndex) % totalLeds;
-                            
-                            if (reverse) {
-                                ledPos = totalLeds - 1 - ledPos;
-                            }
-                            
-                            CRGB color;
-                            if (blend && span > 1) {
-                                // Blend within each color span for smooth transitions
-                                float spanProgress = (float)spanIndex / (span - 1);
-                                int nextColorIndex = (colorIndex + 1) % paletteSize;
-                                color = palette[colorIndex].lerp8(palette[nextColorIndex], (uint8_t)(spanProgress * 255));
-                            } else {
-                                color = palette[colorIndex];
-                            }
-                            
-                            leds[startIndex + ledPos] = color;
+
+                // Single cycle mode: show each color once per cycle
+                for (int colorIndex = 0; colorIndex < paletteSize; colorIndex++) {
+
+                    // Calculate the starting position for this color
+                    int colorStartPos = colorIndex * (span + separation);
+
+                    // Draw the span for this color
+                    for (int spanIndex = 0; spanIndex < span; spanIndex++) {
+                        int ledPos = (s.currentPosition[p] + colorStartPos + spanIndex) % totalLeds;
+
+                        CRGB color;
+                        if (blend && span > 1) {
+                            // Blend within each color span for smooth transitions
+                            float spanProgress = (float)spanIndex / (span - 1);
+                            int nextColorIndex = (colorIndex + 1) % paletteSize;
+                            color = palette[colorIndex].lerp8(palette[nextColorIndex], (uint8_t)(spanProgress * 255));
+                        } else {
+                            color = palette[colorIndex];
                         }
+
+                        leds[startIndex + ledPos] = color;
                     }
                 }
             }
-            
-            // Move to next position
-            currentPosition[pin] = (currentPosition[pin] + 1) % totalLeds;
+
+            // Move on by one LED per step
+            s.currentPosition[p] = (s.currentPosition[p] + steps) % totalLeds;
         }
-        
-        FastLED.show();
+
+        return true;
     }
-}
\ No newline at end of file
+
+    return false;
+}
+
+const ParamField SpinPattern::fields[] = {
+    PARAM_INT_FIELD(SpinParams, speed, 1, PARAM_MAX_SPEED),
+    PARAM_INT_FIELD(SpinParams, separation, 0, MAX_LEDS_PER_PIN),
+    PARAM_INT_FIELD(SpinParams, span, 1, MAX_LEDS_PER_PIN),
+    PARAM_PALETTE_FIELD(SpinParams, palette, paletteSize),
+    PARAM_BOOL_FIELD(SpinParams, loop),
+    PARAM_BOOL_FIELD(SpinParams, continuous),
+    PARAM_BOOL_FIELD(SpinParams, blend),
+    PARAM_FIELDS_END,
+};
+
+template struct PatternBase<SpinPattern, SpinParams>;
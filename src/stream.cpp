@@ -0,0 +1,164 @@
+#include "output.h"
+#include "patterns.h"
+#include "stream_input.h"
+#include <Arduino.h>
+
+// Sequence numbers this far behind the last one are taken as stale rather
+// than as the counter having wrapped, as E1.31 recommends
+#define STALE_SEQUENCE_WINDOW 20
+
+// The frame being collected and, per universe of the instance, whether it
+// has arrived for that frame and the last sequence number seen
+struct StreamState {
+    bool collecting;
+    uint8_t frameSequence;
+    uint16_t syncAddress;
+    int universesReceived;
+    unsigned long frameStartMicros;
+};
+
+static StreamState* layoutStreamState(
+    void* block, int numPins, bool** received, uint8_t** sequences, bool** seen, size_t* size = nullptr)
+{
+    int universes = numPins * STREAM_UNIVERSES_PER_PIN;
+    StateLayout layout(block);
+    StreamState* state = layout.take<StreamState>(1);
+    *received = layout.take<bool>(universes);
+    *sequences = layout.take<uint8_t>(universes);
+    *seen = layout.take<bool>(universes);
+    if (size)
+        *size = layout.size();
+    return state;
+}
+
+size_t StreamPattern::stateSize(int numPins)
+{
+    bool* received;
+    uint8_t* sequences;
+    bool* seen;
+    size_t size;
+    layoutStreamState(nullptr, numPins, &received, &sequences, &seen, &size);
+    return size;
+}
+
+void StreamPattern::reset(void* state, int numPins) { memset(state, 0, stateSize(numPins)); }
+
+static void holdPins(int pins[], int numPins, bool held)
+{
+    for (int p = 0; p < numPins; p++) {
+        setPinHeld(pins[p], held);
+    }
+}
+
+// Packets are taken until one frame is complete, leaving the next frame's
+// packets on the socket, so leds[] never mixes two frames once it is
+// composed. While a frame is being filled in its pins are held out of the
+// output, which keeps partial frames from being shown.
+//
+// A frame is complete when a sync packet for its sync address comes in or,
+// without sync, when every universe has arrived with the frame's sequence
+// number. That relies on the sender numbering whole frames, as media servers
+// do.
+bool StreamPattern::render(
+    const FrameTime& time, void* state, int pins[], int numPins, const StreamParams& params, bool reverse)
+{
+    bool* received;
+    uint8_t* sequences;
+    bool* seen;
+    StreamState* s = layoutStreamState(state, numPins, &received, &sequences, &seen);
+    StreamCounters& counters = getStreamCounters();
+    int universes = numPins * STREAM_UNIVERSES_PER_PIN;
+    int frameUniverses = 0;
+    for (int p = 0; p < numPins; p++) {
+        frameUniverses += pinUniverses(pins[p]);
+    }
+
+    bool complete = false;
+    StreamPacket packet;
+    while (!complete && peekStreamPacket(packet)) {
+        if (packet.sync) {
+            takeStreamPacket(nullptr, 0);
+            complete = s->collecting && s->syncAddress != 0 && packet.universe == s->syncAddress;
+            continue;
+        }
+
+        int slot = packet.universe - params.universe;
+        if (slot < 0 || slot >= universes
+            || slot % STREAM_UNIVERSES_PER_PIN >= pinUniverses(pins[slot / STREAM_UNIVERSES_PER_PIN])) {
+            takeStreamPacket(nullptr, 0);
+            continue;
+        }
+
+        // Per universe: drop what is stale or repeated, count what was skipped
+        int8_t step = packet.sequence - sequences[slot];
+        if (seen[slot] && step <= 0 && step > -STALE_SEQUENCE_WINDOW) {
+            takeStreamPacket(nullptr, 0);
+            counters.dropped++;
+            continue;
+        }
+        if (seen[slot] && step > 1) {
+            counters.lost += step - 1;
+        }
+        seen[slot] = true;
+        sequences[slot] = packet.sequence;
+
+        // Per frame: a newer frame takes over from one still missing
+        // universes, and a late packet of an abandoned frame is dropped
+        if (s->collecting && packet.syncAddress == 0) {
+            int8_t frameStep = packet.sequence - s->frameSequence;
+            if (frameStep < 0) {
+                takeStreamPacket(nullptr, 0);
+                counters.dropped++;
+                continue;
+            }
+            if (frameStep > 0) {
+                counters.incompleteFrames++;
+                s->collecting = false;
+            }
+        }
+        if (!s->collecting) {
+            s->collecting = true;
+            s->frameSequence = packet.sequence;
+            s->universesReceived = 0;
+            s->frameStartMicros = micros();
+            memset(received, 0, universes);
+            holdPins(pins, numPins, true);
+        }
+        s->syncAddress = packet.syncAddress;
+
+        int pin = pins[slot / STREAM_UNIVERSES_PER_PIN];
+        int first = (slot % STREAM_UNIVERSES_PER_PIN) * STREAM_PIXELS_PER_UNIVERSE;
+        int count = min(STREAM_PIXELS_PER_UNIVERSE, pinLeds(pin) - first);
+        takeStreamPacket(leds[pinOffset(pin) + first].raw, count * 3);
+
+        if (!received[slot]) {
+            received[slot] = true;
+            s->universesReceived++;
+        }
+        complete = s->syncAddress == 0 && s->universesReceived == frameUniverses;
+    }
+
+    if (!complete) {
+        return false;
+    }
+
+    s->collecting = false;
+    holdPins(pins, numPins, false);
+    for (int p = 0; p < numPins; p++) {
+        markPinDirty(pins[p]);
+    }
+
+    unsigned long latency = micros() - s->frameStartMicros;
+    counters.frames++;
+    counters.latencyMicros += latency;
+    counters.maxLatencyMicros = max(counters.maxLatencyMicros, latency);
+    counters.lastSequence = s->frameSequence;
+    return true;
+}
+
+const ParamField StreamPattern::fields[] = {
+    PARAM_INT_FIELD(StreamParams, universe, 1, 63999),
+    PARAM_FIELDS_END,
+};
+
+template struct PatternBase<StreamPattern, StreamParams>;
@@ -0,0 +1,133 @@
+#include "stream_input.h"
+#include <Arduino.h>
+
+#ifdef ARDUINO_ARCH_ESP32
+#include <lwip/sockets.h>
+#else
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+#define ROOT_VECTOR_DATA 0x00000004
+#define ROOT_VECTOR_EXTENDED 0x00000008
+#define FRAMING_VECTOR_DATA 0x00000002
+#define FRAMING_VECTOR_SYNC 0x00000001
+#define OPTION_PREVIEW 0x80
+
+static const uint8_t packetIdentifier[12] = { 'A', 'S', 'C', '-', 'E', '1', '.', '1', '7', 0, 0, 0 };
+
+static int streamSocket = -1;
+static uint8_t header[E131_HEADER_BYTES];
+static int headerBytes = 0;
+static StreamCounters counters;
+
+bool beginStreamInput(uint16_t port)
+{
+    endStreamInput();
+    streamSocket = socket(AF_INET, SOCK_DGRAM, 0);
+    if (streamSocket < 0) {
+        return false;
+    }
+
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(streamSocket, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) < 0) {
+        endStreamInput();
+        return false;
+    }
+    return true;
+}
+
+void endStreamInput()
+{
+    if (streamSocket >= 0) {
+        close(streamSocket);
+        streamSocket = -1;
+    }
+}
+
+static uint16_t read16(const uint8_t* bytes) { return bytes[0] << 8 | bytes[1]; }
+
+static uint32_t read32(const uint8_t* bytes) { return (uint32_t)read16(bytes) << 16 | read16(bytes + 2); }
+
+// Fields are at their E1.31 offsets: root layer, then the framing layer, then
+// for data the DMP layer with the start code at 125
+static bool parsePacket(StreamPacket& packet)
+{
+    if (headerBytes < E131_SYNC_BYTES || memcmp(header + 4, packetIdentifier, sizeof(packetIdentifier)) != 0) {
+        return false;
+    }
+
+    uint32_t rootVector = read32(header + 18);
+    uint32_t framingVector = read32(header + 40);
+    if (rootVector == ROOT_VECTOR_EXTENDED && framingVector == FRAMING_VECTOR_SYNC) {
+        packet.sync = true;
+        packet.sequence = header[44];
+        packet.universe = read16(header + 45);
+        packet.syncAddress = 0;
+        packet.channels = 0;
+        return true;
+    }
+
+    if (headerBytes < E131_HEADER_BYTES || rootVector != ROOT_VECTOR_DATA || framingVector != FRAMING_VECTOR_DATA
+        || (header[112] & OPTION_PREVIEW) || header[125] != 0) {
+        return false;
+    }
+    packet.sync = false;
+    packet.syncAddress = read16(header + 109);
+    packet.sequence = header[111];
+    packet.universe = read16(header + 113);
+    // The property count includes the start code
+    packet.channels = min((int)read16(header + 123) - 1, E131_MAX_CHANNELS);
+    return packet.channels >= 0;
+}
+
+bool peekStreamPacket(StreamPacket& packet)
+{
+    while (streamSocket >= 0) {
+        headerBytes = recv(streamSocket, header, sizeof(header), MSG_PEEK | MSG_DONTWAIT);
+        if (headerBytes < 0) {
+            return false;
+        }
+        if (parsePacket(packet)) {
+            return true;
+        }
+        takeStreamPacket(nullptr, 0);
+    }
+    return false;
+}
+
+void takeStreamPacket(uint8_t* target, int capacity)
+{
+    // The header goes back into its buffer, the pixels to target and any
+    // channels past capacity to scratch
+    static uint8_t scratch[E131_MAX_CHANNELS];
+    struct iovec parts[3];
+    parts[0].iov_base = header;
+    parts[0].iov_len = sizeof(header);
+    parts[1].iov_base = target;
+    parts[1].iov_len = target != nullptr ? capacity : 0;
+    parts[2].iov_base = scratch;
+    parts[2].iov_len = sizeof(scratch);
+
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = parts;
+    message.msg_iovlen = 3;
+    recvmsg(streamSocket, &message, MSG_DONTWAIT);
+    counters.packets++;
+}
+
+StreamCounters& getStreamCounters() { return counters; }
+
+void resetStreamCounters()
+{
+    uint8_t lastSequence = counters.lastSequence;
+    memset(&counters, 0, sizeof(counters));
+    counters.lastSequence = lastSequence;
+}
@@ -0,0 +1,68 @@
+#ifndef STREAM_INPUT_H
+#define STREAM_INPUT_H
+
+#include "patterns.h"
+#include <stdint.h>
+
+// E1.31 (sACN) input for the stream pattern. Each universe carries up to 170
+// RGB pixels, and pin slots are STREAM_UNIVERSES_PER_PIN universes apart,
+// enough for the longest pin: pin slot k of an instance starting at universe
+// U starts at universe U + k * that, pixels 0 to 169 in the first, and so
+// on. A shorter pin uses only the first pinUniverses() of its universes.
+//
+// Packets are read without copying. The header of the waiting packet is
+// peeked first, and once it is known where its pixels belong they are
+// received straight into leds[].
+#define E131_PORT 5568
+#define E131_HEADER_BYTES 126
+#define E131_SYNC_BYTES 49
+#define E131_MAX_CHANNELS 512
+#define STREAM_PIXELS_PER_UNIVERSE 170
+#define STREAM_UNIVERSES_PER_PIN ((MAX_LEDS_PER_PIN + STREAM_PIXELS_PER_UNIVERSE - 1) / STREAM_PIXELS_PER_UNIVERSE)
+
+inline int pinUniverses(int pin) { return (pinLeds(pin) + STREAM_PIXELS_PER_UNIVERSE - 1) / STREAM_PIXELS_PER_UNIVERSE; }
+
+// Listens for unicast E1.31 on port. There is one listening socket, so one
+// stream instance should play at a time.
+bool beginStreamInput(uint16_t port);
+void endStreamInput();
+
+// The waiting packet, either universe data or a synchronization packet
+struct StreamPacket {
+    bool sync;
+    // Universe of data, or the universe the sync packet is for
+    uint16_t universe;
+    // Data held until a sync packet for this universe, 0 for none
+    uint16_t syncAddress;
+    uint8_t sequence;
+    int channels;
+};
+
+// Fills packet from the next valid packet on the socket without taking it.
+// Anything that is not E1.31 data or sync, and preview data, is discarded
+// on the way. False once the socket is empty.
+bool peekStreamPacket(StreamPacket& packet);
+// Takes the peeked packet, up to capacity bytes of its channel data landing
+// at target; a null target drops it
+void takeStreamPacket(uint8_t* target, int capacity);
+
+// Counters of the stream pattern, written on the render side. Dropped
+// packets were stale, duplicate or for a frame already given up; lost ones
+// are gaps in a universe's sequence; incomplete frames were abandoned for a
+// newer one. Latency is from the first packet of a frame being read to the
+// frame being complete, and lastSequence is that frame's sequence number.
+struct StreamCounters {
+    unsigned long packets;
+    unsigned long dropped;
+    unsigned long lost;
+    unsigned long frames;
+    unsigned long incompleteFrames;
+    unsigned long latencyMicros;
+    unsigned long maxLatencyMicros;
+    uint8_t lastSequence;
+};
+
+StreamCounters& getStreamCounters();
+void resetStreamCounters();
+
+#endif
@@ -0,0 +1,308 @@
+#include "sync.h"
+#include <Arduino.h>
+#include <atomic>
+
+#ifdef ARDUINO_ARCH_ESP32
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <lwip/sockets.h>
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#endif
+
+#define SYNC_VERSION 1
+// How often the receiving task looks up from the socket to see if it should stop
+#define SYNC_RECEIVE_TIMEOUT_MS 100
+
+static const uint8_t beaconMagic[4] = { 'F', 'L', 'S', 'Y' };
+
+static int syncRole = SYNC_OFF;
+static int syncSocket = -1;
+static struct sockaddr_in leaderTarget;
+static uint16_t nextSequence = 0;
+static SyncCounters counters;
+
+// The newest beacon and the micros() it arrived at, handed from the
+// receiving task to the render side. The version is odd while it is being
+// written. The writer never waits, and a read that overlaps a write is
+// given up, to be tried again the next frame.
+static SyncBeacon mailboxBeacon;
+static unsigned long mailboxArrival;
+static std::atomic<uint32_t> mailboxVersion(0);
+static uint32_t takenVersion = 0;
+// Gaps in the sequence as the receiving task sees it
+static std::atomic<unsigned long> lostBeacons(0);
+static std::atomic<bool> receiving(false);
+static std::atomic<bool> receiverRunning(false);
+#ifndef ARDUINO_ARCH_ESP32
+static std::thread receiverThread;
+#endif
+
+// Follower state, on the render side
+static bool locked = false;
+static uint16_t lastSequence = 0;
+static int64_t windowError = 0;
+static int windowBeacons = 0;
+
+static void put16(uint8_t* at, uint16_t value)
+{
+    at[0] = value >> 8;
+    at[1] = value & 0xFF;
+}
+
+static void put32(uint8_t* at, uint32_t value)
+{
+    put16(at, value >> 16);
+    put16(at + 2, value & 0xFFFF);
+}
+
+static uint16_t read16(const uint8_t* bytes) { return bytes[0] << 8 | bytes[1]; }
+
+static uint32_t read32(const uint8_t* bytes) { return (uint32_t)read16(bytes) << 16 | read16(bytes + 2); }
+
+// Magic, version, segment, sequence, then the clock and the rest, big endian
+void encodeSyncBeacon(const SyncBeacon& beacon, uint8_t* bytes)
+{
+    memcpy(bytes, beaconMagic, sizeof(beaconMagic));
+    bytes[4] = SYNC_VERSION;
+    bytes[5] = beacon.segment;
+    put16(bytes + 6, beacon.sequence);
+    put32(bytes + 8, beacon.clockMicros >> 32);
+    put32(bytes + 12, beacon.clockMicros & 0xFFFFFFFF);
+    put32(bytes + 16, beacon.slotAgeMicros);
+    put32(bytes + 20, beacon.frame);
+    put32(bytes + 24, beacon.segmentStart);
+    put32(bytes + 28, beacon.segmentSeedIndex);
+}
+
+bool decodeSyncBeacon(const uint8_t* bytes, int length, SyncBeacon& beacon)
+{
+    if (length != SYNC_BEACON_BYTES || memcmp(bytes, beaconMagic, sizeof(beaconMagic)) != 0
+        || bytes[4] != SYNC_VERSION) {
+        return false;
+    }
+    beacon.segment = bytes[5];
+    beacon.sequence = read16(bytes + 6);
+    beacon.clockMicros = (uint64_t)read32(bytes + 8) << 32 | read32(bytes + 12);
+    beacon.slotAgeMicros = read32(bytes + 16);
+    beacon.frame = read32(bytes + 20);
+    beacon.segmentStart = read32(bytes + 24);
+    beacon.segmentSeedIndex = read32(bytes + 28);
+    return true;
+}
+
+static void postBeacon(const SyncBeacon& beacon, unsigned long arrival)
+{
+    uint32_t version = mailboxVersion.load(std::memory_order_relaxed);
+    mailboxVersion.store(version + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    mailboxBeacon = beacon;
+    mailboxArrival = arrival;
+    mailboxVersion.store(version + 2, std::memory_order_release);
+}
+
+static bool takeBeacon(SyncBeacon& beacon, unsigned long& arrival)
+{
+    uint32_t version = mailboxVersion.load(std::memory_order_acquire);
+    if ((version & 1) || version == takenVersion) {
+        return false;
+    }
+    beacon = mailboxBeacon;
+    arrival = mailboxArrival;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (mailboxVersion.load(std::memory_order_relaxed) != version) {
+        return false;
+    }
+    takenVersion = version;
+    return true;
+}
+
+static void receiveBeacons()
+{
+    uint8_t bytes[SYNC_BEACON_BYTES + 1];
+    bool heard = false;
+    uint16_t sequence = 0;
+    while (receiving.load(std::memory_order_relaxed)) {
+        int length = recv(syncSocket, bytes, sizeof(bytes), 0);
+        unsigned long arrival = micros();
+        SyncBeacon beacon;
+        if (length > 0 && decodeSyncBeacon(bytes, length, beacon)) {
+            int16_t gap = beacon.sequence - sequence;
+            if (heard && gap > 1) {
+                lostBeacons.fetch_add(gap - 1, std::memory_order_relaxed);
+            }
+            heard = true;
+            sequence = beacon.sequence;
+            postBeacon(beacon, arrival);
+        }
+    }
+    receiverRunning.store(false, std::memory_order_release);
+}
+
+#ifdef ARDUINO_ARCH_ESP32
+static void receiveTask(void* arg)
+{
+    receiveBeacons();
+    vTaskDelete(nullptr);
+}
+#endif
+
+static bool startReceiver()
+{
+    receiving.store(true, std::memory_order_relaxed);
+    receiverRunning.store(true, std::memory_order_relaxed);
+#ifdef ARDUINO_ARCH_ESP32
+    // Above loop() on its core, so beacons are timestamped as they land
+    if (xTaskCreatePinnedToCore(receiveTask, "sync", 3072, nullptr, 2, nullptr, 1) != pdPASS) {
+        receiverRunning.store(false, std::memory_order_relaxed);
+        return false;
+    }
+#else
+    receiverThread = std::thread(receiveBeacons);
+#endif
+    return true;
+}
+
+bool beginSync(int role, uint16_t port, const char* address)
+{
+    endSync();
+    if (role == SYNC_OFF) {
+        return true;
+    }
+    syncSocket = socket(AF_INET, SOCK_DGRAM, 0);
+    if (syncSocket < 0) {
+        return false;
+    }
+
+    int enable = 1;
+    struct sockaddr_in local;
+    memset(&local, 0, sizeof(local));
+    local.sin_family = AF_INET;
+    local.sin_port = htons(port);
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (role == SYNC_LEADER) {
+        leaderTarget = local;
+        leaderTarget.sin_addr.s_addr = inet_addr(address);
+        if (setsockopt(syncSocket, SOL_SOCKET, SO_BROADCAST, &enable, sizeof(enable)) < 0) {
+            endSync();
+            return false;
+        }
+    } else {
+        // Followers on one host share the port; each gets every broadcast
+        struct timeval timeout = { 0, SYNC_RECEIVE_TIMEOUT_MS * 1000 };
+        setsockopt(syncSocket, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+        setsockopt(syncSocket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        if (bind(syncSocket, reinterpret_cast<struct sockaddr*>(&local), sizeof(local)) < 0 || !startReceiver()) {
+            endSync();
+            return false;
+        }
+    }
+
+    syncRole = role;
+    locked = false;
+    windowBeacons = 0;
+    resetSyncCounters();
+    return true;
+}
+
+void endSync()
+{
+    receiving.store(false, std::memory_order_relaxed);
+#ifdef ARDUINO_ARCH_ESP32
+    while (receiverRunning.load(std::memory_order_acquire)) {
+        delay(10);
+    }
+#else
+    if (receiverThread.joinable()) {
+        receiverThread.join();
+    }
+#endif
+    if (syncSocket >= 0) {
+        close(syncSocket);
+        syncSocket = -1;
+    }
+    syncRole = SYNC_OFF;
+}
+
+void syncBeforeFrame(FrameScheduler& scheduler, Program& program)
+{
+    SyncBeacon beacon;
+    unsigned long arrival;
+    if (syncRole != SYNC_FOLLOWER || !takeBeacon(beacon, arrival)) {
+        return;
+    }
+    // Older than one already taken
+    int16_t gap = beacon.sequence - lastSequence;
+    if (locked && gap <= 0) {
+        return;
+    }
+    counters.beacons++;
+    counters.lost = lostBeacons.load(std::memory_order_relaxed);
+    lastSequence = beacon.sequence;
+
+    // This board's frame clock when the beacon landed
+    uint64_t now = scheduler.getClockMicros();
+    uint64_t landed = now - (unsigned long)(micros() - arrival);
+    int64_t error = (int64_t)(beacon.clockMicros - landed);
+    int64_t magnitude = error < 0 ? -error : error;
+    if (!locked || magnitude > SYNC_STEP_MICROS) {
+        scheduler.lockClock(now + error, beacon.clockMicros - beacon.slotAgeMicros, beacon.frame);
+        program.join(beacon.segment, beacon.segmentStart, beacon.segmentSeedIndex);
+        locked = true;
+        windowBeacons = 0;
+        counters.steps++;
+        counters.joins++;
+        return;
+    }
+
+    counters.lastErrorMicros = error;
+    counters.maxErrorMicros = max(counters.maxErrorMicros, (long)magnitude);
+    if (windowBeacons == 0 || error < windowError) {
+        windowError = error;
+    }
+    if (++windowBeacons == SYNC_FILTER_BEACONS) {
+        scheduler.slewClock(windowError);
+        windowBeacons = 0;
+    }
+
+    // The leader's segment as of the beacon's frame, once this board has
+    // rendered that frame too
+    if (scheduler.getFrameCount() == beacon.frame + 1
+        && (program.getCurrentSegment() != beacon.segment || program.getSegmentStart() != beacon.segmentStart
+            || program.getSegmentSeedIndex() != beacon.segmentSeedIndex)) {
+        program.join(beacon.segment, beacon.segmentStart, beacon.segmentSeedIndex);
+        counters.joins++;
+    }
+}
+
+void syncAfterFrame(FrameScheduler& scheduler, Program& program, const FrameTime& time)
+{
+    if (syncRole != SYNC_LEADER) {
+        return;
+    }
+    SyncBeacon beacon;
+    beacon.sequence = nextSequence++;
+    beacon.segment = program.getCurrentSegment();
+    beacon.clockMicros = scheduler.getClockMicros();
+    beacon.slotAgeMicros = beacon.clockMicros - scheduler.getSlotMicros();
+    beacon.frame = time.frame;
+    beacon.segmentStart = program.getSegmentStart();
+    beacon.segmentSeedIndex = program.getSegmentSeedIndex();
+
+    uint8_t bytes[SYNC_BEACON_BYTES];
+    encodeSyncBeacon(beacon, bytes);
+    sendto(syncSocket, bytes, sizeof(bytes), MSG_DONTWAIT, reinterpret_cast<struct sockaddr*>(&leaderTarget),
+        sizeof(leaderTarget));
+}
+
+SyncCounters& getSyncCounters() { return counters; }
+
+void resetSyncCounters()
+{
+    memset(&counters, 0, sizeof(counters));
+    lostBeacons.store(0, std::memory_order_relaxed);
+}
@@ -0,0 +1,75 @@
+#ifndef SYNC_H
+#define SYNC_H
+
+#include "program.h"
+#include "scheduler.h"
+#include <stdint.h>
+
+// Frame sync between boards playing the same show. The leader broadcasts a
+// beacon over UDP after every frame it renders: its frame clock, the slot
+// and number of that frame, and the segment it is in with the segment's
+// start and seed index. Followers steer their FrameScheduler onto the
+// leader's clock and slot grid, so both render the same frame numbers at
+// the same frame times, and join the leader's segment whenever theirs
+// differs, so both draw the same thing.
+//
+// A follower steps its clock the first time it hears the leader and
+// whenever it is more than SYNC_STEP_MICROS out. Otherwise it slews: the
+// smallest error of every SYNC_FILTER_BEACONS beacons is taken out over the
+// following frames, the smallest because network delay only ever makes the
+// leader look further ahead. Beacons are timestamped as they arrive by a
+// receiving task, so the error does not depend on when the render side gets
+// to them. Without beacons a follower plays on by its own clock.
+#define SYNC_OFF 0
+#define SYNC_LEADER 1
+#define SYNC_FOLLOWER 2
+
+#define SYNC_PORT 5570
+#define SYNC_BEACON_BYTES 32
+#define SYNC_STEP_MICROS 50000
+#define SYNC_FILTER_BEACONS 8
+
+struct SyncBeacon {
+    uint16_t sequence;
+    uint8_t segment;
+    // The leader's frame clock when the beacon was sent, and how long before
+    // that the slot of frame began
+    uint64_t clockMicros;
+    uint32_t slotAgeMicros;
+    uint32_t frame;
+    uint32_t segmentStart;
+    uint32_t segmentSeedIndex;
+};
+
+void encodeSyncBeacon(const SyncBeacon& beacon, uint8_t* bytes);
+bool decodeSyncBeacon(const uint8_t* bytes, int length, SyncBeacon& beacon);
+
+// A leader sends to address, a broadcast address of its network; a follower
+// listens on port and ignores address
+bool beginSync(int role, uint16_t port, const char* address);
+void endSync();
+
+// Around every frame the board renders, from the side that calls
+// beginFrame(). Both do nothing unless sync was begun.
+void syncBeforeFrame(FrameScheduler& scheduler, Program& program);
+void syncAfterFrame(FrameScheduler& scheduler, Program& program, const FrameTime& time);
+
+// Follower counters. Beacons are the ones the render side took; the
+// receiving task keeps only the newest, so one that lands while another is
+// waiting replaces it. Lost beacons are gaps in the sequence. Steps include
+// the first lock, joins are switches to the leader's segment, and the error
+// is the leader's clock minus this board's as a beacon lands, network delay
+// included, while locked.
+struct SyncCounters {
+    unsigned long beacons;
+    unsigned long lost;
+    unsigned long steps;
+    unsigned long joins;
+    long lastErrorMicros;
+    long maxErrorMicros;
+};
+
+SyncCounters& getSyncCounters();
+void resetSyncCounters();
+
+#endif
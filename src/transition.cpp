@@ -0,0 +1,89 @@
+#include "transition.h"
+
+static const char* const transitionNames[] = { "cut", "crossfade", "wipe", "stagger" };
+
+int findTransition(const char* name)
+{
+    for (int i = 0; i < (int)(sizeof(transitionNames) / sizeof(transitionNames[0])); i++) {
+        if (strcmp(transitionNames[i], name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+const char* transitionName(int type) { return transitionNames[type]; }
+
+// Plain byte loops, which the compiler turns into vector multiplies and
+// saturating adds. Scaling is FastLED's scale8, (x * (1 + scale)) >> 8.
+void crossfadeBytes(uint8_t* target, const uint8_t* a, const uint8_t* b, int count, uint8_t amount)
+{
+    uint16_t scaleA = 256 - amount;
+    uint16_t scaleB = 1 + amount;
+    for (int i = 0; i < count; i++) {
+        uint16_t sum = ((a[i] * scaleA) >> 8) + ((b[i] * scaleB) >> 8);
+        target[i] = sum > 255 ? 255 : sum;
+    }
+}
+
+// A pin read the other way round is copied out mirrored, so the byte loops
+// above can run straight through both of their inputs
+const CRGB* mirroredPin(const CRGB* pixels, int count, bool flip, CRGB* scratch)
+{
+    if (!flip) {
+        return pixels;
+    }
+    for (int i = 0; i < count; i++) {
+        scratch[i] = pixels[count - 1 - i];
+    }
+    return scratch;
+}
+
+static uint8_t amountFor(float progress)
+{
+    if (progress <= 0) {
+        return 0;
+    }
+    if (progress >= 1) {
+        return 255;
+    }
+    return (uint8_t)(progress * 255);
+}
+
+void composeTransition(TransitionType type, float progress, const CRGB* outgoing, const CRGB* incoming, CRGB* target,
+    const bool pins[NUM_PINS], const bool flipOutgoing[NUM_PINS])
+{
+    static CRGB scratch[MAX_LEDS_PER_PIN];
+    for (int pin = 0; pin < NUM_PINS; pin++) {
+        if (!pins[pin]) {
+            continue;
+        }
+        int start = pinOffset(pin);
+        int count = pinLeds(pin);
+        const CRGB* from = mirroredPin(outgoing + start, count, flipOutgoing[pin], scratch);
+        const CRGB* to = incoming + start;
+        CRGB* out = target + start;
+
+        if (type == TRANSITION_WIPE) {
+            int covered = (int)(min(max(progress, 0.0f), 1.0f) * count);
+            memcpy(out, to, covered * sizeof(CRGB));
+            memcpy(out + covered, from + covered, (count - covered) * sizeof(CRGB));
+            continue;
+        }
+
+        // Stagger spreads the pins' starts over the first half
+        float pinProgress = progress;
+        if (type == TRANSITION_STAGGER) {
+            float delay = NUM_PINS > 1 ? 0.5f * pin / (NUM_PINS - 1) : 0;
+            pinProgress = (progress - delay) * 2;
+        }
+        uint8_t amount = amountFor(pinProgress);
+        if (amount == 0) {
+            memcpy(out, from, count * sizeof(CRGB));
+        } else if (amount == 255) {
+            memcpy(out, to, count * sizeof(CRGB));
+        } else {
+            crossfadeBytes(out[0].raw, from[0].raw, to[0].raw, count * 3, amount);
+        }
+    }
+}
@@ -0,0 +1,33 @@
+#ifndef TRANSITION_H
+#define TRANSITION_H
+
+#include "patterns.h"
+
+// How a segment comes in over the one before it. Apart from a cut, both
+// segments render for the length of the transition, each into a frame of
+// its own, and the two frames are combined into leds[] on every frame.
+//
+//   CROSSFADE  every pin fades from the outgoing frame to the incoming one
+//   WIPE       the incoming frame covers each pin from its first pixel
+//   STAGGER    pins crossfade one after another, each over half the time
+enum TransitionType { TRANSITION_CUT, TRANSITION_CROSSFADE, TRANSITION_WIPE, TRANSITION_STAGGER };
+
+// By name, as in show files; -1 if there is none
+int findTransition(const char* name);
+const char* transitionName(int type);
+
+// Saturating 8-bit crossfade of count bytes: a scaled by 255 - amount plus b
+// scaled by amount, clamped at 255
+void crossfadeBytes(uint8_t* target, const uint8_t* a, const uint8_t* b, int count, uint8_t amount);
+
+// The count pixels as they are, or with flip mirrored into scratch, which
+// must hold count pixels
+const CRGB* mirroredPin(const CRGB* pixels, int count, bool flip, CRGB* scratch);
+
+// Combines the outgoing and incoming frames into target at progress 0 to 1,
+// for the pins set in pins. Outgoing pins set in flipOutgoing are read from
+// the last pixel back, for pins whose direction the incoming segment turned.
+void composeTransition(TransitionType type, float progress, const CRGB* outgoing, const CRGB* incoming, CRGB* target,
+    const bool pins[NUM_PINS], const bool flipOutgoing[NUM_PINS]);
+
+#endif